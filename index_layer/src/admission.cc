@@ -0,0 +1,87 @@
+#include "admission.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+constexpr uint64_t kRowSeeds[4] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL,
+};
+
+uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace
+
+FrequencySketch::FrequencySketch(size_t width, size_t sample_size) {
+    if (width == 0) {
+        throw std::invalid_argument("sketch width must be positive");
+    }
+    width_ = 1;
+    while (width_ < width) {
+        width_ <<= 1;
+    }
+    sample_size_ = sample_size > 0 ? sample_size : 10 * width_;
+    counters_.assign(kDepth * width_, 0);
+}
+
+size_t FrequencySketch::Index(uint64_t hash, int row) const {
+    return static_cast<size_t>(row) * width_ + (Mix(hash ^ kRowSeeds[row]) & (width_ - 1));
+}
+
+uint32_t FrequencySketch::Increment(uint64_t hash) {
+    size_t idx[kDepth];
+    uint8_t min = 255;
+    for (int r = 0; r < kDepth; ++r) {
+        idx[r] = Index(hash, r);
+        min = std::min(min, counters_[idx[r]]);
+    }
+    // Conservative update: only the rows at the minimum grow.
+    if (min < 255) {
+        for (int r = 0; r < kDepth; ++r) {
+            if (counters_[idx[r]] == min) {
+                counters_[idx[r]]++;
+            }
+        }
+        min++;
+    }
+    if (++additions_ >= sample_size_) {
+        Age();
+        return Estimate(hash);
+    }
+    return min;
+}
+
+uint32_t FrequencySketch::Estimate(uint64_t hash) const {
+    uint8_t min = 255;
+    for (int r = 0; r < kDepth; ++r) {
+        min = std::min(min, counters_[Index(hash, r)]);
+    }
+    return min;
+}
+
+void FrequencySketch::Reset() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+    additions_ = 0;
+}
+
+uint64_t FrequencySketch::Agings() const {
+    return agings_;
+}
+
+void FrequencySketch::Age() {
+    for (auto& c : counters_) {
+        c >>= 1;
+    }
+    additions_ /= 2;
+    agings_++;
+}
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Count-min sketch of 8-bit counters with conservative update and periodic
+// aging: after sample_size increments every counter is halved, so the
+// estimate tracks recent frequency (TinyLFU).
+class FrequencySketch {
+public:
+    // width is rounded up to a power of two; sample_size 0 = 10 * width.
+    explicit FrequencySketch(size_t width, size_t sample_size = 0);
+
+    // Records one occurrence and returns the updated estimate.
+    uint32_t Increment(uint64_t hash);
+    uint32_t Estimate(uint64_t hash) const;
+    void Reset();
+
+    uint64_t Agings() const;
+
+private:
+    static constexpr int kDepth = 4;
+
+    size_t Index(uint64_t hash, int row) const;
+    void Age();
+
+    std::vector<uint8_t> counters_; // kDepth rows of width_
+    size_t width_ = 0;
+    size_t sample_size_ = 0;
+    size_t additions_ = 0;
+    uint64_t agings_ = 0;
+};
+
+// Store admission: an object is uploaded and indexed only once its leading
+// prefix has been stored min_frequency times recently, or if its priority is
+// at least bypass_priority.
+struct AdmissionConfig {
+    bool enabled = false;
+    uint32_t min_frequency = 2;
+    int bypass_priority = std::numeric_limits<int>::max();
+    size_t sketch_width = 1u << 16;
+    size_t sample_size = 0; // 0 = 10 * sketch_width
+};
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,75 @@
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+uint64_t Fnv1a(const std::string& key) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(size_t expected_items, double false_positive_rate) {
+    if (expected_items == 0 || false_positive_rate <= 0.0 || false_positive_rate >= 1.0) {
+        throw std::invalid_argument("bloom filter needs expected_items > 0 and 0 < fp rate < 1");
+    }
+    const double ln2 = std::log(2.0);
+    const double bits = -static_cast<double>(expected_items) * std::log(false_positive_rate) / (ln2 * ln2);
+    num_bits_ = std::max<size_t>(64, static_cast<size_t>(std::ceil(bits)));
+    num_hashes_ = std::max(1, static_cast<int>(std::round(bits / static_cast<double>(expected_items) * ln2)));
+    bits_.assign((num_bits_ + 63) / 64, 0);
+}
+
+void BloomFilter::Add(const std::string& key) {
+    const uint64_t h1 = Fnv1a(key);
+    const uint64_t h2 = Mix(h1) | 1;
+    for (int i = 0; i < num_hashes_; ++i) {
+        const size_t bit = static_cast<size_t>((h1 + static_cast<uint64_t>(i) * h2) % num_bits_);
+        bits_[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool BloomFilter::MayContain(const std::string& key) const {
+    const uint64_t h1 = Fnv1a(key);
+    const uint64_t h2 = Mix(h1) | 1;
+    for (int i = 0; i < num_hashes_; ++i) {
+        const size_t bit = static_cast<size_t>((h1 + static_cast<uint64_t>(i) * h2) % num_bits_);
+        if (!(bits_[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BloomFilter::Clear() {
+    std::fill(bits_.begin(), bits_.end(), 0);
+}
+
+size_t BloomFilter::BitCount() const {
+    return num_bits_;
+}
+
+int BloomFilter::HashCount() const {
+    return num_hashes_;
+}
+
+} // namespace prompt_cache_poc
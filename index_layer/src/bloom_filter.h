@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Fixed-size Bloom filter over strings (k hashes by double hashing). No
+// false negatives; false positives at roughly the configured rate once
+// expected_items have been added.
+class BloomFilter {
+public:
+    BloomFilter(size_t expected_items, double false_positive_rate);
+
+    void Add(const std::string& key);
+    bool MayContain(const std::string& key) const;
+    void Clear();
+
+    size_t BitCount() const;
+    int HashCount() const;
+
+private:
+    std::vector<uint64_t> bits_;
+    size_t num_bits_ = 0;
+    int num_hashes_ = 0;
+};
+
+} // namespace prompt_cache_poc
@@ -1,12 +1,37 @@
 #include "cache.h"
 
 #include <algorithm>
-#include <iomanip>
-#include <sstream>
 #include <stdexcept>
 
 namespace prompt_cache_poc {
 
+bool Storage::GetRanges(const std::string& obj_id,
+                        const std::vector<ByteRange>& ranges,
+                        std::vector<std::vector<uint8_t>>& out) const {
+    int64_t end = 0;
+    for (const auto& r : ranges) {
+        if (r.offset < 0 || r.length <= 0) {
+            return false;
+        }
+        end = std::max(end, r.offset + r.length);
+    }
+    std::vector<uint8_t> covering;
+    if (!GetRange(obj_id, static_cast<int>(end), covering) ||
+        static_cast<int64_t>(covering.size()) < end) {
+        return false;
+    }
+    out.clear();
+    out.reserve(ranges.size());
+    for (const auto& r : ranges) {
+        out.emplace_back(covering.begin() + r.offset, covering.begin() + r.offset + r.length);
+    }
+    return true;
+}
+
+bool Storage::Exists(const std::string&) const {
+    return false;
+}
+
 PrefixMap::PrefixMap(int block_size, int bytes_per_token, std::shared_ptr<Storage> storage)
     : block_size_(block_size),
       bytes_per_token_(bytes_per_token),
@@ -16,44 +41,444 @@ PrefixMap::PrefixMap(int block_size, int bytes_per_token, std::shared_ptr<Storag
     }
 }
 
+PrefixMap::~PrefixMap() {
+    // Drain uploads while the tables they advertise into are still alive.
+    write_behind_.reset();
+}
+
 std::string PrefixMap::Store(
     const std::vector<std::string>& tokens,
     const std::vector<uint8_t>& data,
     const std::string& owner_id,
     int priority,
-    bool skip_put
+    bool skip_put,
+    StoreStatus* status
 ) {
-    const std::string obj_id = HashBytesHex(data);
-    if (!skip_put) {
-        if (!storage_->Put(obj_id, data)) {
+    return Store(tokens, data, ObjectLayout{}, owner_id, priority, skip_put, status);
+}
+
+std::string PrefixMap::Store(
+    const std::vector<std::string>& tokens,
+    const std::vector<uint8_t>& data,
+    const ObjectLayout& layout,
+    const std::string& owner_id,
+    int priority,
+    bool skip_put,
+    StoreStatus* status
+) {
+    PrefixHandle handle;
+    Extend(handle, tokens);
+    if (!Admit(handle.hasher.Value(), priority)) {
+        admission_rejects_++;
+        SetStatus(status, StoreStatus::kRejected);
+        return "";
+    }
+    std::string obj_id = StoreAdmitted(handle, data, layout, owner_id, priority, skip_put);
+    SetStatus(status, obj_id.empty() ? StoreStatus::kFailed : StoreStatus::kStored);
+    return obj_id;
+}
+
+std::string PrefixMap::StoreContinuation(
+    PrefixHandle& handle,
+    const std::vector<std::string>& new_tokens,
+    const std::vector<uint8_t>& data,
+    const ObjectLayout& layout,
+    const std::string& owner_id,
+    int priority,
+    bool skip_put,
+    StoreStatus* status
+) {
+    Extend(handle, new_tokens);
+    if (!Admit(handle.hasher.Value(), priority)) {
+        admission_rejects_++;
+        SetStatus(status, StoreStatus::kRejected);
+        return "";
+    }
+    std::string obj_id = StoreAdmitted(handle, data, layout, owner_id, priority, skip_put);
+    SetStatus(status, obj_id.empty() ? StoreStatus::kFailed : StoreStatus::kStored);
+    if (!obj_id.empty()) {
+        // The object covers every prefix so far; the next lookup re-checks
+        // the last one (write-behind may not have advertised it yet).
+        handle.matched = handle.prefixes.lengths.size();
+    }
+    return obj_id;
+}
+
+std::string PrefixMap::StoreAdmitted(const PrefixHandle& handle,
+                                     const std::vector<uint8_t>& data,
+                                     const ObjectLayout& layout,
+                                     const std::string& owner_id,
+                                     int priority,
+                                     bool skip_put) {
+    const int total_tokens = static_cast<int>(handle.hasher.Count());
+    ObjectLayout object_layout = layout;
+    if (!object_layout.Empty()) {
+        if (object_layout.num_tokens == 0) {
+            object_layout.num_tokens = total_tokens;
+        }
+        if (!object_layout.Valid(data.size())) {
             return "";
         }
     }
 
+    const std::string obj_id = ContentId(data);
+    if (!skip_put && HasObject(obj_id)) {
+        skipped_puts_++;
+        skip_put = true;
+    }
+    if (!skip_put && write_behind_) {
+        WriteBehindQueue::Job job;
+        job.obj_id = obj_id;
+        job.prefixes = handle.prefixes;
+        job.total_tokens = total_tokens;
+        job.data = data;
+        job.layout = object_layout;
+        job.owner_id = owner_id;
+        job.priority = priority;
+        return write_behind_->Enqueue(std::move(job)) ? obj_id : "";
+    }
+    if (!skip_put && !PutIfAbsent(obj_id, data)) {
+        return "";
+    }
+
+    Advertise(handle.prefixes, total_tokens, obj_id, static_cast<int>(data.size()), object_layout, owner_id,
+              priority);
+    return obj_id;
+}
+
+void PrefixMap::Extend(PrefixHandle& handle, const std::vector<std::string>& new_tokens) const {
+    for (const auto& token : new_tokens) {
+        const int before = static_cast<int>(handle.hasher.Count());
+        handle.hasher.Update(token);
+        if (SwaNextPrefixLength(swa_, block_size_, before) == before + 1) {
+            handle.prefixes.lengths.push_back(before + 1);
+            handle.prefixes.hashes.push_back(handle.hasher.Value());
+            handle.prefixes.fingerprints.push_back(handle.hasher.Fingerprint());
+        }
+    }
+}
+
+void PrefixMap::SetStatus(StoreStatus* status, StoreStatus value) {
+    if (status) {
+        *status = value;
+    }
+}
+
+bool PrefixMap::Admit(uint64_t prompt_hash, int priority) {
+    // Frequency is tracked per whole prompt: a shared system prompt alone does
+    // not get every one-off continuation of it admitted.
+    if (!admission_enabled_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(admission_mu_);
+    if (!admission_.enabled || priority >= admission_.bypass_priority) {
+        return true;
+    }
+    return sketch_->Increment(prompt_hash) >= admission_.min_frequency;
+}
+
+bool PrefixMap::HasObject(const std::string& obj_id) const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    return obj_table_.count(obj_id) > 0;
+}
+
+bool PrefixMap::PutIfAbsent(const std::string& obj_id, const std::vector<uint8_t>& data) {
+    bool maybe_remote = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(mu_);
+        maybe_remote = remote_objects_.MayContain(obj_id);
+    }
+    // Filter hits can be false positives or stale, so confirm before skipping.
+    if (maybe_remote && storage_->Exists(obj_id)) {
+        skipped_puts_++;
+        return true;
+    }
+    if (!storage_->Put(obj_id, data)) {
+        return false;
+    }
+    NoteRemoteObject(obj_id);
+    return true;
+}
+
+void PrefixMap::Advertise(const PrefixHashes& prefixes,
+                          int total_tokens,
+                          const std::string& obj_id,
+                          int total_bytes,
+                          const ObjectLayout& layout,
+                          const std::string& owner_id,
+                          int priority) {
+    MetadataEvent event;
+    event.type = MetadataEvent::Type::kAdvertise;
+    event.obj_id = obj_id;
+    event.total_bytes = total_bytes;
+    event.layout = layout;
+    event.owner_id = owner_id;
+    event.priority = priority;
+
+    // Build records outside the lock; only the table updates are serialized.
+    event.prefixes.reserve(prefixes.lengths.size());
+    for (size_t i = 0; i < prefixes.lengths.size(); ++i) {
+        PrefixRecord record;
+        record.hash = prefixes.hashes[i];
+        record.fingerprint = prefixes.fingerprints[i];
+        record.prefix_tokens = prefixes.lengths[i];
+        record.usable_len_bytes = layout.Empty()
+            ? UsableBytes(record.prefix_tokens, total_tokens, total_bytes)
+            : static_cast<int>(record.prefix_tokens * layout.BytesPerToken());
+        record.parent_hash = i > 0 ? prefixes.hashes[i - 1] : 0;
+        event.prefixes.push_back(record);
+    }
+
+    uint64_t seq = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        ApplyLocked(event);
+        seq = QueueNotifyLocked(std::move(event), MutationScope::kLocal);
+    }
+    DeliverNotifications(seq);
+    EvictIfNeeded(obj_id);
+}
+
+bool PrefixMap::Tombstone(const std::string& obj_id) {
+    return Drop(obj_id, MutationScope::kLocal);
+}
+
+bool PrefixMap::Drop(const std::string& obj_id, MutationScope scope) {
+    MetadataEvent event;
+    event.type = MetadataEvent::Type::kTombstone;
+    event.obj_id = obj_id;
+    uint64_t seq = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        if (!obj_table_.count(obj_id) && !obj_prefixes_.count(obj_id)) {
+            return false;
+        }
+        ApplyLocked(event);
+        seq = QueueNotifyLocked(std::move(event), scope);
+    }
+    DeliverNotifications(seq);
+    return true;
+}
+
+int PrefixMap::AddMutationListener(MutationListener listener) {
+    std::unique_lock<std::shared_mutex> lock(listeners_mu_);
+    const int id = ++next_listener_id_;
+    listeners_.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void PrefixMap::RemoveMutationListener(int id) {
+    std::unique_lock<std::shared_mutex> lock(listeners_mu_);
+    listeners_.erase(std::remove_if(listeners_.begin(), listeners_.end(),
+                                    [id](const auto& entry) { return entry.first == id; }),
+                     listeners_.end());
+}
+
+void PrefixMap::ApplyEvent(const MetadataEvent& event) {
+    uint64_t seq = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        ApplyLocked(event);
+        seq = QueueNotifyLocked(event, MutationScope::kRemote);
+    }
+    DeliverNotifications(seq);
+}
+
+std::vector<MetadataEvent> PrefixMap::SnapshotEvents() const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    std::vector<MetadataEvent> events;
+    events.reserve(obj_table_.size());
+    for (const auto& [obj_id, meta] : obj_table_) {
+        MetadataEvent event;
+        event.type = MetadataEvent::Type::kAdvertise;
+        event.obj_id = obj_id;
+        event.total_bytes = meta.total_bytes;
+        event.layout = meta.layout;
+        auto hashes = obj_prefixes_.find(obj_id);
+        if (hashes != obj_prefixes_.end()) {
+            for (uint64_t hash : hashes->second) {
+                auto it = prefix_map_.find(hash);
+                if (it == prefix_map_.end() || it->second.obj_id != obj_id) {
+                    continue;
+                }
+                event.owner_id = it->second.owner_id;
+                event.priority = it->second.priority;
+                event.prefixes.push_back({hash, it->second.fingerprint, it->second.prefix_tokens,
+                                          it->second.usable_len_bytes, it->second.parent_hash});
+            }
+        }
+        events.push_back(std::move(event));
+    }
+    return events;
+}
+
+void PrefixMap::ApplyLocked(const MetadataEvent& event) {
+    if (event.type == MetadataEvent::Type::kTombstone) {
+        auto it = obj_prefixes_.find(event.obj_id);
+        if (it != obj_prefixes_.end()) {
+            for (uint64_t hash : it->second) {
+                auto entry = prefix_map_.find(hash);
+                if (entry != prefix_map_.end() && entry->second.obj_id == event.obj_id) {
+                    prefix_map_.erase(entry);
+                }
+            }
+            obj_prefixes_.erase(it);
+        }
+        auto obj = obj_table_.find(event.obj_id);
+        if (obj != obj_table_.end()) {
+            stored_bytes_ -= static_cast<uint64_t>(obj->second.total_bytes);
+            obj_table_.erase(obj);
+        }
+        return;
+    }
+
     version_clock_++;
+    const auto now = std::chrono::steady_clock::now();
     ObjectMeta meta;
-    meta.total_bytes = static_cast<int>(data.size());
-    meta.last_access = std::chrono::steady_clock::now();
+    meta.total_bytes = event.total_bytes;
+    meta.last_access = now;
     meta.inflight_reads = 0;
-    obj_table_[obj_id] = meta;
-
-    if (tokens.size() < static_cast<size_t>(block_size_)) {
-        return obj_id;
+    meta.layout = event.layout;
+    meta.created = now;
+    for (const auto& record : event.prefixes) {
+        meta.prefix_tokens = std::max(meta.prefix_tokens, record.prefix_tokens);
     }
+    auto existing = obj_table_.find(event.obj_id);
+    if (existing != obj_table_.end()) {
+        // Re-advertising known content counts as a reuse.
+        meta.created = existing->second.created;
+        meta.reuse = existing->second.reuse;
+        meta.reuse->hits++;
+        meta.ttl_mode = existing->second.ttl_mode;
+        meta.ttl = existing->second.ttl;
+        meta.ttl_scheduled = existing->second.ttl_scheduled;
+        meta.prefix_tokens = std::max(meta.prefix_tokens, existing->second.prefix_tokens);
+        stored_bytes_ -= static_cast<uint64_t>(existing->second.total_bytes);
+    } else {
+        meta.reuse = std::make_shared<ReuseCounter>();
+        meta.ttl_mode = ttl_.mode;
+        meta.ttl = ttl_.ttl;
+    }
+    meta.reuse->last_access_ns.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    stored_bytes_ += static_cast<uint64_t>(meta.total_bytes);
+    ObjectMeta& stored = obj_table_[event.obj_id];
+    stored = meta;
+    ScheduleTtlLocked(event.obj_id, stored);
+    remote_objects_.Add(event.obj_id);
 
-    for (int prefix_len = block_size_; prefix_len <= static_cast<int>(tokens.size()); prefix_len += block_size_) {
-        const uint64_t hash = HashTokens(tokens, static_cast<size_t>(prefix_len));
-        const int usable = UsableBytes(prefix_len, static_cast<int>(tokens.size()), static_cast<int>(data.size()));
+    auto& hashes = obj_prefixes_[event.obj_id];
+    for (const auto& record : event.prefixes) {
         PrefixEntry entry;
-        entry.obj_id = obj_id;
-        entry.usable_len_bytes = usable;
+        entry.obj_id = event.obj_id;
+        entry.usable_len_bytes = record.usable_len_bytes;
         entry.version = version_clock_;
-        entry.owner_id = owner_id;
-        entry.priority = priority;
-        prefix_map_[hash] = entry;
+        entry.owner_id = event.owner_id;
+        entry.priority = event.priority;
+        entry.fingerprint = record.fingerprint;
+        entry.prefix_tokens = record.prefix_tokens;
+        entry.parent_hash = record.parent_hash;
+        prefix_map_[record.hash] = entry;
+        if (std::find(hashes.begin(), hashes.end(), record.hash) == hashes.end()) {
+            hashes.push_back(record.hash);
+        }
+    }
+}
+
+double PrefixMap::ScoreLocked(const ObjectMeta& meta, std::chrono::steady_clock::time_point now) const {
+    if (meta.total_bytes <= 0) {
+        return 0.0;
     }
+    const double window = std::max<double>(1.0, static_cast<double>(eviction_.reuse_window.count()));
+    const double age = std::chrono::duration<double>(now - meta.created).count();
+    const double hits = meta.reuse ? static_cast<double>(meta.reuse->hits.load(std::memory_order_relaxed)) : 0.0;
+    const double reuse_rate = (hits + 1.0) / std::max(1.0, age / window);
+    return static_cast<double>(meta.prefix_tokens) * eviction_.cost_factor * reuse_rate /
+           static_cast<double>(meta.total_bytes);
+}
 
-    return obj_id;
+void PrefixMap::EvictIfNeeded(const std::string& keep_obj_id) {
+    using Candidate = std::pair<double, const std::pair<const std::string, ObjectMeta>*>;
+    std::vector<std::string> victim_ids;
+    {
+        std::shared_lock<std::shared_mutex> lock(mu_);
+        if (eviction_.capacity_bytes == 0 || stored_bytes_ <= eviction_.capacity_bytes) {
+            return;
+        }
+        const uint64_t target = static_cast<uint64_t>(
+            static_cast<double>(eviction_.capacity_bytes) * eviction_.low_watermark);
+        const uint64_t need = stored_bytes_ - std::min(stored_bytes_, target);
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<Candidate> victims;
+        // Max-heap on score of the cheapest objects seen so far, trimmed to
+        // just cover need: O(n log k) for k victims instead of sorting every
+        // object.
+        auto higher = [](const Candidate& a, const Candidate& b) { return a.first < b.first; };
+        uint64_t heap_bytes = 0;
+        for (const auto& obj : obj_table_) {
+            if (obj.first == keep_obj_id) {
+                continue;
+            }
+            const double score = ScoreLocked(obj.second, now);
+            if (heap_bytes >= need && score >= victims.front().first) {
+                continue;
+            }
+            victims.emplace_back(score, &obj);
+            std::push_heap(victims.begin(), victims.end(), higher);
+            heap_bytes += static_cast<uint64_t>(obj.second.total_bytes);
+            while (heap_bytes - static_cast<uint64_t>(victims.front().second->second.total_bytes) >= need) {
+                heap_bytes -= static_cast<uint64_t>(victims.front().second->second.total_bytes);
+                std::pop_heap(victims.begin(), victims.end(), higher);
+                victims.pop_back();
+            }
+        }
+        std::sort_heap(victims.begin(), victims.end(), higher);
+        for (const auto& victim : victims) {
+            victim_ids.push_back(victim.second->first);
+        }
+    }
+    // Local decision: drop from this map only. Peers, the journal and shared
+    // storage keep the object.
+    for (const auto& obj_id : victim_ids) {
+        if (Drop(obj_id, MutationScope::kLocalOnly)) {
+            evicted_objects_++;
+        }
+    }
+}
+
+uint64_t PrefixMap::QueueNotifyLocked(MetadataEvent event, MutationScope scope) {
+    std::lock_guard<std::mutex> lock(notify_mu_);
+    notify_queue_.emplace_back(std::move(event), scope);
+    return ++notify_queued_;
+}
+
+void PrefixMap::DeliverNotifications(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(notify_mu_);
+    if (notify_thread_ == std::this_thread::get_id()) {
+        // A listener mutated the map; the loop below delivers that event next.
+        return;
+    }
+    // Whoever is delivering also delivers ours, in queue order.
+    notify_cv_.wait(lock, [&] { return notify_delivered_ >= seq || notify_thread_ == std::thread::id(); });
+    if (notify_delivered_ >= seq) {
+        return;
+    }
+    notify_thread_ = std::this_thread::get_id();
+    while (!notify_queue_.empty()) {
+        auto [event, scope] = std::move(notify_queue_.front());
+        notify_queue_.pop_front();
+        lock.unlock();
+        {
+            std::shared_lock<std::shared_mutex> listeners_lock(listeners_mu_);
+            for (const auto& [id, listener] : listeners_) {
+                listener(event, scope);
+            }
+        }
+        lock.lock();
+        notify_delivered_++;
+        notify_cv_.notify_all();
+    }
+    notify_thread_ = std::thread::id();
+    notify_cv_.notify_all();
 }
 
 LookupResult PrefixMap::Lookup(const std::vector<std::string>& tokens, int max_len_tokens) const {
@@ -65,31 +490,91 @@ LookupResult PrefixMap::Lookup(const std::vector<std::string>& tokens, int max_l
         max_len_tokens = static_cast<int>(tokens.size());
     }
 
-    PrefixEntry last_entry;
-    int last_prefix = 0;
+    return LookupHashed(HashPrefixes(tokens, PrefixLengths(max_len_tokens)), max_len_tokens);
+}
+
+LookupResult PrefixMap::LookupHashed(const PrefixHashes& prefixes, int max_len_tokens) const {
+    int last_idx = -1;
+    uint64_t parent_hash = 0;
+
+    std::shared_lock<std::shared_mutex> lock(mu_);
 
-    for (int prefix_len = block_size_; prefix_len <= max_len_tokens; prefix_len += block_size_) {
-        const uint64_t hash = HashTokens(tokens, static_cast<size_t>(prefix_len));
-        auto it = prefix_map_.find(hash);
-        if (it == prefix_map_.end()) {
+    for (int prefix_len : PrefixLengths(max_len_tokens)) {
+        const int idx = prefixes.IndexOf(prefix_len);
+        if (idx < 0 || !MatchesLocked(prefixes, static_cast<size_t>(idx), parent_hash)) {
             break;
         }
-        last_entry = it->second;
-        last_prefix = prefix_len;
+        last_idx = idx;
+        parent_hash = prefixes.hashes[idx];
     }
 
-    if (last_prefix == 0) {
+    if (last_idx < 0) {
         return {};
     }
+    return HitLocked(prefix_map_.at(prefixes.hashes[last_idx]), prefixes.lengths[last_idx]);
+}
+
+LookupResult PrefixMap::LookupContinuation(PrefixHandle& handle, const std::vector<std::string>& new_tokens) const {
+    Extend(handle, new_tokens);
+    const PrefixHashes& prefixes = handle.prefixes;
+    auto parent_of = [&prefixes](size_t i) { return i > 0 ? prefixes.hashes[i - 1] : 0; };
+
+    std::shared_lock<std::shared_mutex> lock(mu_);
+
+    // An entry maps the whole prefix [0, len) to its object and its parent
+    // hash chains it to the earlier prefixes, so if the previous match is
+    // still present only the new prefixes need probing. Otherwise rescan the
+    // hashes already in the handle (no token rehashing).
+    size_t matched = std::min(handle.matched, prefixes.lengths.size());
+    if (matched > 0 && !MatchesLocked(prefixes, matched - 1, parent_of(matched - 1))) {
+        matched = 0;
+    }
+    while (matched < prefixes.lengths.size() && MatchesLocked(prefixes, matched, parent_of(matched))) {
+        matched++;
+    }
+    handle.matched = matched;
+
+    if (matched == 0) {
+        return {};
+    }
+    return HitLocked(prefix_map_.at(prefixes.hashes[matched - 1]), prefixes.lengths[matched - 1]);
+}
+
+bool PrefixMap::MatchesLocked(const PrefixHashes& prefixes, size_t index, uint64_t parent_hash) const {
+    auto it = prefix_map_.find(prefixes.hashes[index]);
+    if (it == prefix_map_.end()) {
+        return false;
+    }
+    // The entry is already in cache; reject primary-hash collisions.
+    if (it->second.fingerprint != prefixes.fingerprints[index] ||
+        it->second.prefix_tokens != prefixes.lengths[index] ||
+        it->second.parent_hash != parent_hash) {
+        fingerprint_mismatches_++;
+        return false;
+    }
+    return true;
+}
+
+LookupResult PrefixMap::HitLocked(const PrefixEntry& entry, int prefix_len) const {
+    auto obj = obj_table_.find(entry.obj_id);
+    if (obj != obj_table_.end() && obj->second.reuse) {
+        obj->second.reuse->hits.fetch_add(1, std::memory_order_relaxed);
+        obj->second.reuse->last_access_ns.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                                std::memory_order_relaxed);
+    }
 
     LookupResult res;
     res.hit = true;
-    res.obj_id = last_entry.obj_id;
-    res.usable_len_bytes = last_entry.usable_len_bytes;
-    res.prefix_tokens = last_prefix;
+    res.obj_id = entry.obj_id;
+    res.usable_len_bytes = entry.usable_len_bytes;
+    res.prefix_tokens = prefix_len;
     return res;
 }
 
+std::vector<int> PrefixMap::PrefixLengths(int total_tokens) const {
+    return SwaPrefixLengths(swa_, block_size_, total_tokens);
+}
+
 bool PrefixMap::Load(const std::string& obj_id, int usable_len_bytes, std::vector<uint8_t>& out) const {
     if (!storage_ || !storage_->GetRange(obj_id, usable_len_bytes, out)) {
         return false;
@@ -97,11 +582,257 @@ bool PrefixMap::Load(const std::string& obj_id, int usable_len_bytes, std::vecto
     return true;
 }
 
+bool PrefixMap::LoadBuffers(const std::string& obj_id,
+                            int prefix_tokens,
+                            std::vector<std::vector<uint8_t>>& out) const {
+    ObjectLayout layout;
+    {
+        std::shared_lock<std::shared_mutex> lock(mu_);
+        auto it = obj_table_.find(obj_id);
+        if (it == obj_table_.end() || it->second.layout.Empty()) {
+            return false;
+        }
+        layout = it->second.layout;
+    }
+    if (prefix_tokens <= 0 || prefix_tokens > layout.num_tokens) {
+        prefix_tokens = layout.num_tokens;
+    }
+
+    std::vector<std::vector<uint8_t>> fetched;
+    if (!storage_->GetRanges(obj_id, layout.FetchRanges(0, prefix_tokens), fetched)) {
+        return false;
+    }
+    return layout.Demux(0, prefix_tokens, fetched, out);
+}
+
+void PrefixMap::SetSwaConfig(const SwaConfig& cfg) {
+    if (!cfg.Valid(block_size_)) {
+        throw std::invalid_argument("SWA window must be a multiple of block size and exceed sink tokens");
+    }
+    swa_ = cfg;
+}
+
+const SwaConfig& PrefixMap::GetSwaConfig() const {
+    return swa_;
+}
+
+bool PrefixMap::PlanRefill(const std::string& obj_id, int prefix_tokens, RefillPlan& plan) const {
+    ObjectLayout layout;
+    if (!EffectiveLayout(obj_id, layout) || prefix_tokens <= 0 || prefix_tokens > layout.num_tokens) {
+        return false;
+    }
+    plan.spans = PlanSwaRefill(swa_, prefix_tokens);
+    plan.ranges = layout.FetchRanges(plan.spans);
+    plan.glued_tokens = 0;
+    for (const auto& span : plan.spans) {
+        plan.glued_tokens += span.count;
+    }
+    plan.bytes = 0;
+    for (const auto& range : plan.ranges) {
+        plan.bytes += range.length;
+    }
+    return true;
+}
+
+bool PrefixMap::LoadRefill(const std::string& obj_id,
+                           const RefillPlan& plan,
+                           std::vector<std::vector<uint8_t>>& out) const {
+    ObjectLayout layout;
+    if (!EffectiveLayout(obj_id, layout) || plan.ranges.empty()) {
+        return false;
+    }
+    std::vector<std::vector<uint8_t>> fetched;
+    if (!storage_->GetRanges(obj_id, plan.ranges, fetched)) {
+        return false;
+    }
+    return layout.Demux(plan.spans, fetched, out);
+}
+
+void PrefixMap::SetEvictionConfig(const EvictionConfig& cfg) {
+    if (cfg.cost_factor <= 0.0 || cfg.low_watermark <= 0.0 || cfg.low_watermark > 1.0) {
+        throw std::invalid_argument("eviction cost_factor must be positive and low_watermark in (0, 1]");
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        eviction_ = cfg;
+    }
+    EvictIfNeeded("");
+}
+
+double PrefixMap::Score(const std::string& obj_id) const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    auto it = obj_table_.find(obj_id);
+    return it == obj_table_.end() ? 0.0 : ScoreLocked(it->second, std::chrono::steady_clock::now());
+}
+
+uint64_t PrefixMap::StoredBytes() const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    return stored_bytes_;
+}
+
+uint64_t PrefixMap::EvictedObjects() const {
+    return evicted_objects_;
+}
+
+void PrefixMap::SetTtlConfig(const TtlConfig& cfg) {
+    if (cfg.tick.count() <= 0 || (cfg.mode != TtlMode::kNone && cfg.ttl.count() <= 0)) {
+        throw std::invalid_argument("TTL tick and ttl must be positive");
+    }
+    std::unique_lock<std::shared_mutex> lock(mu_);
+    ttl_ = cfg;
+    ttl_wheel_ = std::make_unique<TimingWheel>(cfg.tick, std::chrono::steady_clock::now());
+    for (auto& [obj_id, meta] : obj_table_) {
+        if (meta.ttl_mode == TtlMode::kNone && cfg.mode != TtlMode::kNone) {
+            meta.ttl_mode = cfg.mode;
+            meta.ttl = cfg.ttl;
+        }
+        meta.ttl_scheduled = false;
+        ScheduleTtlLocked(obj_id, meta);
+    }
+}
+
+bool PrefixMap::SetObjectTtl(const std::string& obj_id, TtlMode mode, std::chrono::milliseconds ttl) {
+    if (mode != TtlMode::kNone && ttl.count() <= 0) {
+        throw std::invalid_argument("object ttl must be positive");
+    }
+    std::unique_lock<std::shared_mutex> lock(mu_);
+    auto it = obj_table_.find(obj_id);
+    if (it == obj_table_.end()) {
+        return false;
+    }
+    it->second.ttl_mode = mode;
+    it->second.ttl = ttl;
+    // An already scheduled entry is re-checked when it fires; schedule anew
+    // in case the deadline moved earlier.
+    it->second.ttl_scheduled = false;
+    ScheduleTtlLocked(obj_id, it->second);
+    return true;
+}
+
+size_t PrefixMap::ExpireDue(std::chrono::steady_clock::time_point now) {
+    size_t count = 0;
+    uint64_t seq = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        if (!ttl_wheel_) {
+            return 0;
+        }
+        std::vector<std::string> fired;
+        ttl_wheel_->Advance(now, fired);
+        for (auto& obj_id : fired) {
+            auto it = obj_table_.find(obj_id);
+            if (it == obj_table_.end() || !it->second.ttl_scheduled) {
+                continue;
+            }
+            ObjectMeta& meta = it->second;
+            meta.ttl_scheduled = false;
+            if (meta.ttl_mode == TtlMode::kNone) {
+                continue;
+            }
+            if (TtlDeadline(meta) > now) {
+                ScheduleTtlLocked(obj_id, meta);
+                continue;
+            }
+            // Removed under the same lock the deadline was checked under, so
+            // a concurrent hit cannot slide it in between. Sliding deadlines
+            // only see this map's lookups, so expiry is local only.
+            MetadataEvent event;
+            event.type = MetadataEvent::Type::kTombstone;
+            event.obj_id = std::move(obj_id);
+            ApplyLocked(event);
+            seq = QueueNotifyLocked(std::move(event), MutationScope::kLocalOnly);
+            expired_objects_++;
+            count++;
+        }
+    }
+    if (seq != 0) {
+        DeliverNotifications(seq);
+    }
+    return count;
+}
+
+uint64_t PrefixMap::ExpiredObjects() const {
+    return expired_objects_;
+}
+
+void PrefixMap::ScheduleTtlLocked(const std::string& obj_id, ObjectMeta& meta) {
+    if (!ttl_wheel_ || meta.ttl_mode == TtlMode::kNone || meta.ttl_scheduled) {
+        return;
+    }
+    ttl_wheel_->Schedule(obj_id, TtlDeadline(meta));
+    meta.ttl_scheduled = true;
+}
+
+std::chrono::steady_clock::time_point PrefixMap::TtlDeadline(const ObjectMeta& meta) {
+    if (meta.ttl_mode == TtlMode::kAbsolute || !meta.reuse) {
+        return meta.created + meta.ttl;
+    }
+    const std::chrono::steady_clock::time_point last_access{
+        std::chrono::steady_clock::duration(meta.reuse->last_access_ns.load(std::memory_order_relaxed))};
+    return last_access + meta.ttl;
+}
+
+void PrefixMap::SetAdmissionConfig(const AdmissionConfig& cfg) {
+    if (cfg.enabled && (cfg.min_frequency == 0 || cfg.sketch_width == 0)) {
+        throw std::invalid_argument("admission min_frequency and sketch_width must be positive");
+    }
+    std::lock_guard<std::mutex> lock(admission_mu_);
+    admission_ = cfg;
+    sketch_ = cfg.enabled ? std::make_unique<FrequencySketch>(cfg.sketch_width, cfg.sample_size) : nullptr;
+    admission_enabled_.store(cfg.enabled, std::memory_order_release);
+}
+
+uint64_t PrefixMap::AdmissionRejects() const {
+    return admission_rejects_;
+}
+
+void PrefixMap::EnableWriteBehind(const WriteBehindQueue::Config& cfg) {
+    write_behind_.reset();
+    write_behind_ = std::make_unique<WriteBehindQueue>(cfg, [this](const WriteBehindQueue::Job& job) {
+        if (!PutIfAbsent(job.obj_id, job.data)) {
+            return false;
+        }
+        Advertise(job.prefixes, job.total_tokens, job.obj_id, static_cast<int>(job.data.size()), job.layout,
+                  job.owner_id, job.priority);
+        return true;
+    });
+}
+
+void PrefixMap::NoteRemoteObject(const std::string& obj_id) {
+    std::unique_lock<std::shared_mutex> lock(mu_);
+    remote_objects_.Add(obj_id);
+}
+
+void PrefixMap::ConfigureRemoteFilter(size_t expected_objects, double false_positive_rate) {
+    BloomFilter filter(expected_objects, false_positive_rate);
+    std::unique_lock<std::shared_mutex> lock(mu_);
+    remote_objects_ = std::move(filter);
+    for (const auto& [obj_id, meta] : obj_table_) {
+        remote_objects_.Add(obj_id);
+    }
+}
+
+uint64_t PrefixMap::SkippedPuts() const {
+    return skipped_puts_;
+}
+
+void PrefixMap::FlushWriteBehind() {
+    if (write_behind_) {
+        write_behind_->Flush();
+    }
+}
+
+WriteBehindQueue::Stats PrefixMap::GetWriteBehindStats() const {
+    return write_behind_ ? write_behind_->GetStats() : WriteBehindQueue::Stats{};
+}
+
 size_t PrefixMap::PrefixCount() const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
     return prefix_map_.size();
 }
 
 size_t PrefixMap::ObjectCount() const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
     return obj_table_.size();
 }
 
@@ -109,6 +840,10 @@ int PrefixMap::BlockSize() const {
     return block_size_;
 }
 
+uint64_t PrefixMap::FingerprintMismatches() const {
+    return fingerprint_mismatches_;
+}
+
 int PrefixMap::UsableBytes(int prefix_len, int total_tokens, int total_bytes) const {
     if (bytes_per_token_ > 0) {
         int bytes = prefix_len * bytes_per_token_;
@@ -133,28 +868,24 @@ int PrefixMap::UsableBytes(int prefix_len, int total_tokens, int total_bytes) co
     return bytes;
 }
 
-uint64_t PrefixMap::HashTokens(const std::vector<std::string>& tokens, size_t count) {
-    std::ostringstream oss;
-    for (size_t i = 0; i < count; ++i) {
-        if (i) {
-            oss << "\x1f";
-        }
-        oss << tokens[i];
+bool PrefixMap::EffectiveLayout(const std::string& obj_id, ObjectLayout& out) const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    auto it = obj_table_.find(obj_id);
+    if (it == obj_table_.end()) {
+        return false;
     }
-
-    std::string input = oss.str();
-    std::hash<std::string> hasher;
-    return static_cast<uint64_t>(hasher(input));
-}
-
-std::string PrefixMap::HashBytesHex(const std::vector<uint8_t>& data) {
-    std::hash<std::string> hasher;
-    std::string as_string(data.begin(), data.end());
-    size_t h = hasher(as_string);
-
-    std::ostringstream oss;
-    oss << std::hex << std::setw(sizeof(size_t) * 2) << std::setfill('0') << h;
-    return oss.str();
+    if (!it->second.layout.Empty()) {
+        out = it->second.layout;
+        return true;
+    }
+    // Without a recorded layout fall back to one token-major buffer.
+    if (bytes_per_token_ <= 0 || it->second.total_bytes % bytes_per_token_ != 0) {
+        return false;
+    }
+    out = ObjectLayout{};
+    out.num_tokens = it->second.total_bytes / bytes_per_token_;
+    out.buffer_bytes_per_token.push_back(bytes_per_token_);
+    return true;
 }
 
 } // namespace prompt_cache_poc
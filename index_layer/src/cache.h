@@ -1,11 +1,28 @@
 #pragma once
 
+#include "admission.h"
+#include "bloom_filter.h"
+#include "content_hash.h"
+#include "kv_layout.h"
+#include "metadata_event.h"
+#include "prefix_hash.h"
+#include "swa_planner.h"
+#include "timing_wheel.h"
+#include "write_behind.h"
+
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 
 namespace prompt_cache_poc {
 
@@ -15,12 +32,72 @@ struct PrefixEntry {
     int64_t version = 0;
     std::string owner_id;
     int priority = 0;
+    // Verifies a hit on the primary hash: independent token hash and the
+    // prefix length the entry was recorded for.
+    uint64_t fingerprint = 0;
+    int prefix_tokens = 0;
+    // Hash of the previous recorded prefix of the same prompt (0 for the first).
+    uint64_t parent_hash = 0;
+};
+
+// Shared so lookups can count reuse under the read lock.
+struct ReuseCounter {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<int64_t> last_access_ns{0}; // steady_clock
+};
+
+// kSliding expires ttl after the last lookup hit (or advertise);
+// kAbsolute expires ttl after the object was first advertised.
+enum class TtlMode { kNone, kSliding, kAbsolute };
+
+struct TtlConfig {
+    TtlMode mode = TtlMode::kNone; // default for new objects
+    std::chrono::milliseconds ttl{0};
+    std::chrono::milliseconds tick{1000};
 };
 
 struct ObjectMeta {
     int total_bytes = 0;
     std::chrono::steady_clock::time_point last_access;
     int inflight_reads = 0;
+    ObjectLayout layout;
+    // Longest prefix the object serves and when it was first advertised, for
+    // eviction scoring.
+    int prefix_tokens = 0;
+    std::chrono::steady_clock::time_point created;
+    std::shared_ptr<ReuseCounter> reuse;
+    TtlMode ttl_mode = TtlMode::kNone;
+    std::chrono::milliseconds ttl{0};
+    bool ttl_scheduled = false;
+};
+
+// Byte budget for a PrefixMap. Objects are scored by estimated recompute
+// savings per stored byte:
+//   prefix_tokens * cost_factor * reuse_rate / total_bytes
+// where reuse_rate is (hits + 1) per reuse_window of age. When a local
+// advertise exceeds the budget the lowest-scoring objects are dropped from
+// this map down to low_watermark. The budget is this map's own: evictions are
+// not replicated and the objects stay in (shared) storage.
+struct EvictionConfig {
+    uint64_t capacity_bytes = 0; // 0 = unbounded
+    double cost_factor = 1.0;    // prefill cost per token for this map's model
+    double low_watermark = 0.95;
+    std::chrono::seconds reuse_window{60};
+};
+
+// Where a mutation delivered to listeners came from.
+enum class MutationScope {
+    kRemote,    // applied through ApplyEvent (a peer or a journal replay)
+    kLocal,     // local advertise/tombstone that peers should see
+    kLocalOnly, // eviction or expiry of this map only; never replicated
+};
+
+// Why Store returned what it did: an empty obj_id is either an admission
+// rejection or a failure (invalid layout, PUT error, write-behind drop).
+enum class StoreStatus {
+    kStored,
+    kRejected,
+    kFailed,
 };
 
 struct LookupResult {
@@ -30,13 +107,41 @@ struct LookupResult {
     int prefix_tokens = 0;
 };
 
+// Hash chain of a growing prompt (e.g. a chat conversation): the running token
+// hash, the hash of every recorded prefix so far, and how many leading
+// prefixes the last lookup matched. Continuation calls hash and probe only
+// the tokens added since, so a turn costs O(new tokens) rather than
+// O(conversation). A handle is tied to the map (block size, SWA config) that
+// extended it.
+struct PrefixHandle {
+    TokenHasher hasher;
+    PrefixHashes prefixes;
+    size_t matched = 0;
+};
+
+// Exact token spans (window order) and object byte ranges for one refill.
+struct RefillPlan {
+    std::vector<TokenSpan> spans;
+    std::vector<ByteRange> ranges;
+    int glued_tokens = 0;
+    int64_t bytes = 0;
+};
+
 class Storage {
 public:
     virtual ~Storage() = default;
     virtual bool Put(const std::string& obj_id, const std::vector<uint8_t>& data) = 0;
     virtual bool GetRange(const std::string& obj_id, int max_bytes, std::vector<uint8_t>& out) const = 0;
+    // Fetches several ranges of one object in a single request. The default
+    // reads the covering prefix and slices it.
+    virtual bool GetRanges(const std::string& obj_id,
+                           const std::vector<ByteRange>& ranges,
+                           std::vector<std::vector<uint8_t>>& out) const;
     virtual bool Delete(const std::string& obj_id) = 0;
     virtual size_t Size() const = 0;
+    // Cheap existence check (e.g. HEAD). The default cannot tell and returns
+    // false, so callers upload.
+    virtual bool Exists(const std::string& obj_id) const;
 };
 
 class PrefixMap {
@@ -44,35 +149,214 @@ public:
     explicit PrefixMap(int block_size,
                        int bytes_per_token,
                        std::shared_ptr<Storage> storage);
+    ~PrefixMap();
+
+    PrefixMap(const PrefixMap&) = delete;
+    PrefixMap& operator=(const PrefixMap&) = delete;
+
+    std::string Store(
+        const std::vector<std::string>& tokens,
+        const std::vector<uint8_t>& data,
+        const std::string& owner_id,
+        int priority,
+        bool skip_put = false,
+        StoreStatus* status = nullptr
+    );
 
+    // Same as above, recording how the object's wafer buffers are laid out so
+    // LoadBuffers can fetch per-buffer prefixes.
     std::string Store(
         const std::vector<std::string>& tokens,
         const std::vector<uint8_t>& data,
+        const ObjectLayout& layout,
         const std::string& owner_id,
         int priority,
-        bool skip_put = false
+        bool skip_put = false,
+        StoreStatus* status = nullptr
     );
 
     LookupResult Lookup(const std::vector<std::string>& tokens, int max_len_tokens = 0) const;
 
+    // Chat continuation. Extend appends new_tokens to the handle's hash chain.
+    // LookupContinuation extends and returns the longest match, re-checking
+    // only the previous match and probing only the new prefixes; each entry's
+    // parent_hash must continue the chain. StoreContinuation extends and stores
+    // data (the KV of the whole prompt so far) under every prefix.
+    void Extend(PrefixHandle& handle, const std::vector<std::string>& new_tokens) const;
+    LookupResult LookupContinuation(PrefixHandle& handle, const std::vector<std::string>& new_tokens) const;
+    std::string StoreContinuation(
+        PrefixHandle& handle,
+        const std::vector<std::string>& new_tokens,
+        const std::vector<uint8_t>& data,
+        const ObjectLayout& layout,
+        const std::string& owner_id,
+        int priority,
+        bool skip_put = false,
+        StoreStatus* status = nullptr
+    );
+
+    // Lookup against prefix hashes computed once by the caller, e.g. shared
+    // across several caches. max_len_tokens must be set.
+    LookupResult LookupHashed(const PrefixHashes& prefixes, int max_len_tokens) const;
+
+    // Prefix lengths this map records for a prompt of total_tokens tokens.
+    std::vector<int> PrefixLengths(int total_tokens) const;
+
     bool Load(const std::string& obj_id, int usable_len_bytes, std::vector<uint8_t>& out) const;
 
+    // Returns, per buffer, the bytes of tokens [0..prefix_tokens) using one
+    // multi-range fetch. Requires the object to have been stored with a layout.
+    bool LoadBuffers(const std::string& obj_id,
+                     int prefix_tokens,
+                     std::vector<std::vector<uint8_t>>& out) const;
+
+    // Removes the object and every prefix that resolves to it. Metadata only:
+    // the object is not deleted from storage. Returns false if unknown.
+    bool Tombstone(const std::string& obj_id);
+
+    // Called with every advertise/tombstone after it is applied, outside the
+    // map lock and in the order the events were applied.
+    using MutationListener = std::function<void(const MetadataEvent& event, MutationScope scope)>;
+    int AddMutationListener(MutationListener listener);
+    void RemoveMutationListener(int id);
+
+    // Applies a replicated event. Applying the same event again is a no-op.
+    // Does not evict: the budget is enforced on the next local advertise, so
+    // a journal replay or a peer's burst never turns into local tombstones.
+    void ApplyEvent(const MetadataEvent& event);
+
+    // One advertise event per object with the prefixes it still owns, for
+    // snapshots.
+    std::vector<MetadataEvent> SnapshotEvents() const;
+
+    // Objects known to exist in storage even if not in the ObjectTable (e.g.
+    // uploaded by a peer). Store confirms filter hits with Storage::Exists
+    // before skipping the PUT.
+    void NoteRemoteObject(const std::string& obj_id);
+    void ConfigureRemoteFilter(size_t expected_objects, double false_positive_rate);
+    // Stores whose PUT was skipped because the object already existed.
+    uint64_t SkippedPuts() const;
+
+    // Frequency-based admission, disabled by default. A Store that is not
+    // admitted returns "" (status kRejected) before hashing the payload or
+    // doing any I/O.
+    void SetAdmissionConfig(const AdmissionConfig& cfg);
+    uint64_t AdmissionRejects() const;
+
+    // Cost-aware eviction against a byte budget (unbounded by default).
+    // Evicted objects are dropped from this map only (MutationScope::kLocalOnly).
+    void SetEvictionConfig(const EvictionConfig& cfg);
+    double Score(const std::string& obj_id) const;
+    uint64_t StoredBytes() const;
+    uint64_t EvictedObjects() const;
+
+    // Time-based expiry. Deadlines live in a hierarchical timing wheel;
+    // ExpireDue advances it and drops objects whose deadline (re-checked on
+    // fire under the map lock, since sliding deadlines move) has passed. Like
+    // evictions, expiries are local only (MutationScope::kLocalOnly). Call it
+    // periodically.
+    void SetTtlConfig(const TtlConfig& cfg);
+    bool SetObjectTtl(const std::string& obj_id, TtlMode mode, std::chrono::milliseconds ttl);
+    size_t ExpireDue(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+    uint64_t ExpiredObjects() const;
+
+    // Write-behind mode: Store enqueues the payload and returns its obj_id at
+    // once; uploader threads advertise the prefixes only after the PUT
+    // succeeds. Store returns "" if the queue drops the payload.
+    void EnableWriteBehind(const WriteBehindQueue::Config& cfg);
+    void FlushWriteBehind();
+    WriteBehindQueue::Stats GetWriteBehindStats() const;
+
+    // SWA planning mode: prefixes are recorded at window column boundaries and
+    // refills fetch sink + window tokens instead of the whole prefix. Set it
+    // before the map is shared between threads.
+    void SetSwaConfig(const SwaConfig& cfg);
+    const SwaConfig& GetSwaConfig() const;
+
+    bool PlanRefill(const std::string& obj_id, int prefix_tokens, RefillPlan& plan) const;
+    bool LoadRefill(const std::string& obj_id,
+                    const RefillPlan& plan,
+                    std::vector<std::vector<uint8_t>>& out) const;
+
     size_t PrefixCount() const;
     size_t ObjectCount() const;
     int BlockSize() const;
+    // Lookups that found a primary-hash entry whose fingerprint, length or
+    // parent hash did not match.
+    uint64_t FingerprintMismatches() const;
 
 private:
+    static void SetStatus(StoreStatus* status, StoreStatus value);
+    bool Admit(uint64_t prompt_hash, int priority);
+    std::string StoreAdmitted(const PrefixHandle& handle,
+                              const std::vector<uint8_t>& data,
+                              const ObjectLayout& layout,
+                              const std::string& owner_id,
+                              int priority,
+                              bool skip_put);
+    bool HasObject(const std::string& obj_id) const;
+    bool PutIfAbsent(const std::string& obj_id, const std::vector<uint8_t>& data);
+    void Advertise(const PrefixHashes& prefixes,
+                   int total_tokens,
+                   const std::string& obj_id,
+                   int total_bytes,
+                   const ObjectLayout& layout,
+                   const std::string& owner_id,
+                   int priority);
+    void ApplyLocked(const MetadataEvent& event);
+    bool MatchesLocked(const PrefixHashes& prefixes, size_t index, uint64_t parent_hash) const;
+    LookupResult HitLocked(const PrefixEntry& entry, int prefix_len) const;
+    double ScoreLocked(const ObjectMeta& meta, std::chrono::steady_clock::time_point now) const;
+    bool Drop(const std::string& obj_id, MutationScope scope);
+    void EvictIfNeeded(const std::string& keep_obj_id);
+    void ScheduleTtlLocked(const std::string& obj_id, ObjectMeta& meta);
+    static std::chrono::steady_clock::time_point TtlDeadline(const ObjectMeta& meta);
+    // Listeners see events in the order they were applied: the event is
+    // queued under mu_, then delivered after it is released.
+    uint64_t QueueNotifyLocked(MetadataEvent event, MutationScope scope);
+    void DeliverNotifications(uint64_t seq);
     int UsableBytes(int prefix_len, int total_tokens, int total_bytes) const;
-    static uint64_t HashTokens(const std::vector<std::string>& tokens, size_t count);
-    static std::string HashBytesHex(const std::vector<uint8_t>& data);
+    bool EffectiveLayout(const std::string& obj_id, ObjectLayout& out) const;
 
     int block_size_ = 0;
     int bytes_per_token_ = 0;
     int64_t version_clock_ = 0;
+    SwaConfig swa_;
+    mutable std::atomic<uint64_t> fingerprint_mismatches_{0};
+    std::atomic<uint64_t> skipped_puts_{0};
+    std::atomic<uint64_t> admission_rejects_{0};
+    std::atomic<uint64_t> evicted_objects_{0};
+    std::atomic<uint64_t> expired_objects_{0};
+    EvictionConfig eviction_;
+    TtlConfig ttl_;
+    std::unique_ptr<TimingWheel> ttl_wheel_;
+
+    std::atomic<bool> admission_enabled_{false}; // read without admission_mu_
+    std::mutex admission_mu_;
+    AdmissionConfig admission_;
+    std::unique_ptr<FrequencySketch> sketch_;
 
     std::shared_ptr<Storage> storage_;
+    mutable std::shared_mutex listeners_mu_;
+    std::vector<std::pair<int, MutationListener>> listeners_;
+    int next_listener_id_ = 0;
+    std::mutex notify_mu_;
+    std::condition_variable notify_cv_;
+    std::deque<std::pair<MetadataEvent, MutationScope>> notify_queue_;
+    uint64_t notify_queued_ = 0;
+    uint64_t notify_delivered_ = 0;
+    std::thread::id notify_thread_; // thread running listeners, if any
+    // Guards prefix_map_, obj_table_, stored_bytes_, obj_prefixes_,
+    // remote_objects_, eviction_, ttl_, ttl_wheel_ and version_clock_.
+    mutable std::shared_mutex mu_;
     std::unordered_map<uint64_t, PrefixEntry> prefix_map_;
     std::unordered_map<std::string, ObjectMeta> obj_table_;
+    uint64_t stored_bytes_ = 0;
+    // Reverse index for tombstones; may list hashes since taken over by
+    // another object.
+    std::unordered_map<std::string, std::vector<uint64_t>> obj_prefixes_;
+    BloomFilter remote_objects_{1u << 20, 0.01};
+    std::unique_ptr<WriteBehindQueue> write_behind_;
 };
 
 } // namespace prompt_cache_poc
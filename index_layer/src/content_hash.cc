@@ -0,0 +1,489 @@
+#include "content_hash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+constexpr uint64_t kPrime32_1 = 0x9e3779b1ULL;
+constexpr uint64_t kPrime32_2 = 0x85ebca77ULL;
+constexpr uint64_t kPrime32_3 = 0xc2b2ae3dULL;
+constexpr uint64_t kPrime64_1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t kPrime64_2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr uint64_t kPrime64_3 = 0x165667b19e3779f9ULL;
+constexpr uint64_t kPrime64_4 = 0x85ebca77c2b2ae63ULL;
+constexpr uint64_t kPrime64_5 = 0x27d4eb2f165667c5ULL;
+constexpr uint64_t kPrimeMx1 = 0x165667919e3779f9ULL;
+constexpr uint64_t kPrimeMx2 = 0x9fb21c651e98df25ULL;
+
+// XXH3 layout constants.
+constexpr size_t kStripe = 64;
+constexpr size_t kSecretSize = 192;
+constexpr size_t kStripesPerBlock = (kSecretSize - kStripe) / 8;
+constexpr size_t kLastAccStart = 7;
+constexpr size_t kMergeAccsStart = 11;
+constexpr size_t kMidsizeStartOffset = 3;
+constexpr size_t kMidsizeLastOffset = 17;
+constexpr size_t kSecretSizeMin = 136;
+
+constexpr size_t kChunkBytes = 1u << 20;
+constexpr size_t kParallelMinBytes = 4u << 20;
+constexpr size_t kMaxHashThreads = 8;
+constexpr uint64_t kTreeSeed = 0x7472656568617368ULL;
+
+// XXH3 kSecret.
+constexpr uint8_t kDefaultSecret[kSecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint64_t ReadLe64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big) {
+        v = __builtin_bswap64(v);
+    }
+    return v;
+}
+
+inline uint32_t ReadLe32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big) {
+        v = __builtin_bswap32(v);
+    }
+    return v;
+}
+
+inline void WriteLe64(uint8_t* out, uint64_t v) {
+    if constexpr (std::endian::native == std::endian::big) {
+        v = __builtin_bswap64(v);
+    }
+    std::memcpy(out, &v, sizeof(v));
+}
+
+inline uint32_t Rotl32(uint32_t v, int r) {
+    return (v << r) | (v >> (32 - r));
+}
+
+inline uint64_t Xxh64Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= kPrime64_2;
+    h ^= h >> 29;
+    h *= kPrime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t Avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= kPrimeMx1;
+    h ^= h >> 32;
+    return h;
+}
+
+inline Hash128 Mul128(uint64_t a, uint64_t b) {
+    const uint128_t product = static_cast<uint128_t>(a) * b;
+    Hash128 out;
+    out.lo = static_cast<uint64_t>(product);
+    out.hi = static_cast<uint64_t>(product >> 64);
+    return out;
+}
+
+inline uint64_t MulFold64(uint64_t a, uint64_t b) {
+    const Hash128 product = Mul128(a, b);
+    return product.lo ^ product.hi;
+}
+
+inline uint64_t Mix16(const uint8_t* in, const uint8_t* secret, uint64_t seed) {
+    return MulFold64(ReadLe64(in) ^ (ReadLe64(secret) + seed), ReadLe64(in + 8) ^ (ReadLe64(secret + 8) - seed));
+}
+
+inline void Mix32(Hash128& acc, const uint8_t* in1, const uint8_t* in2, const uint8_t* secret, uint64_t seed) {
+    acc.lo += Mix16(in1, secret, seed);
+    acc.lo ^= ReadLe64(in2) + ReadLe64(in2 + 8);
+    acc.hi += Mix16(in2, secret + 16, seed);
+    acc.hi ^= ReadLe64(in1) + ReadLe64(in1 + 8);
+}
+
+Hash128 Len1To3(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    const uint32_t c1 = in[0];
+    const uint32_t c2 = in[len >> 1];
+    const uint32_t c3 = in[len - 1];
+    const uint32_t combined_lo = (c1 << 16) | (c2 << 24) | c3 | (static_cast<uint32_t>(len) << 8);
+    const uint32_t combined_hi = Rotl32(__builtin_bswap32(combined_lo), 13);
+    const uint64_t bitflip_lo = (ReadLe32(secret) ^ ReadLe32(secret + 4)) + seed;
+    const uint64_t bitflip_hi = (ReadLe32(secret + 8) ^ ReadLe32(secret + 12)) - seed;
+    Hash128 out;
+    out.lo = Xxh64Avalanche(combined_lo ^ bitflip_lo);
+    out.hi = Xxh64Avalanche(combined_hi ^ bitflip_hi);
+    return out;
+}
+
+Hash128 Len4To8(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    seed ^= static_cast<uint64_t>(__builtin_bswap32(static_cast<uint32_t>(seed))) << 32;
+    const uint64_t input = ReadLe32(in) + (static_cast<uint64_t>(ReadLe32(in + len - 4)) << 32);
+    const uint64_t bitflip = (ReadLe64(secret + 16) ^ ReadLe64(secret + 24)) + seed;
+    Hash128 m = Mul128(input ^ bitflip, kPrime64_1 + (static_cast<uint64_t>(len) << 2));
+    m.hi += m.lo << 1;
+    m.lo ^= m.hi >> 3;
+    m.lo ^= m.lo >> 35;
+    m.lo *= kPrimeMx2;
+    m.lo ^= m.lo >> 28;
+    m.hi = Avalanche(m.hi);
+    return m;
+}
+
+Hash128 Len9To16(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    const uint64_t bitflip_lo = (ReadLe64(secret + 32) ^ ReadLe64(secret + 40)) - seed;
+    const uint64_t bitflip_hi = (ReadLe64(secret + 48) ^ ReadLe64(secret + 56)) + seed;
+    const uint64_t input_lo = ReadLe64(in);
+    uint64_t input_hi = ReadLe64(in + len - 8);
+    Hash128 m = Mul128(input_lo ^ input_hi ^ bitflip_lo, kPrime64_1);
+    m.lo += static_cast<uint64_t>(len - 1) << 54;
+    input_hi ^= bitflip_hi;
+    m.hi += input_hi + (input_hi & 0xffffffffULL) * (kPrime32_2 - 1);
+    m.lo ^= __builtin_bswap64(m.hi);
+    Hash128 h = Mul128(m.lo, kPrime64_2);
+    h.hi += m.hi * kPrime64_2;
+    h.lo = Avalanche(h.lo);
+    h.hi = Avalanche(h.hi);
+    return h;
+}
+
+Hash128 Len0To16(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    if (len > 8) {
+        return Len9To16(in, len, secret, seed);
+    }
+    if (len >= 4) {
+        return Len4To8(in, len, secret, seed);
+    }
+    if (len > 0) {
+        return Len1To3(in, len, secret, seed);
+    }
+    Hash128 out;
+    out.lo = Xxh64Avalanche(seed ^ ReadLe64(secret + 64) ^ ReadLe64(secret + 72));
+    out.hi = Xxh64Avalanche(seed ^ ReadLe64(secret + 80) ^ ReadLe64(secret + 88));
+    return out;
+}
+
+Hash128 FinishMid(Hash128 acc, size_t len, uint64_t seed) {
+    Hash128 out;
+    out.lo = Avalanche(acc.lo + acc.hi);
+    out.hi = 0 - Avalanche(acc.lo * kPrime64_1 + acc.hi * kPrime64_4 + (static_cast<uint64_t>(len) - seed) * kPrime64_2);
+    return out;
+}
+
+Hash128 Len17To128(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    Hash128 acc;
+    acc.lo = static_cast<uint64_t>(len) * kPrime64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                Mix32(acc, in + 48, in + len - 64, secret + 96, seed);
+            }
+            Mix32(acc, in + 32, in + len - 48, secret + 64, seed);
+        }
+        Mix32(acc, in + 16, in + len - 32, secret + 32, seed);
+    }
+    Mix32(acc, in, in + len - 16, secret, seed);
+    return FinishMid(acc, len, seed);
+}
+
+Hash128 Len129To240(const uint8_t* in, size_t len, const uint8_t* secret, uint64_t seed) {
+    Hash128 acc;
+    acc.lo = static_cast<uint64_t>(len) * kPrime64_1;
+    for (size_t i = 32; i < 160; i += 32) {
+        Mix32(acc, in + i - 32, in + i - 16, secret + i - 32, seed);
+    }
+    acc.lo = Avalanche(acc.lo);
+    acc.hi = Avalanche(acc.hi);
+    for (size_t i = 160; i <= len; i += 32) {
+        Mix32(acc, in + i - 32, in + i - 16, secret + kMidsizeStartOffset + i - 160, seed);
+    }
+    Mix32(acc, in + len - 16, in + len - 32, secret + kSecretSizeMin - kMidsizeLastOffset - 16, 0 - seed);
+    return FinishMid(acc, len, seed);
+}
+
+inline void Accumulate512(uint64_t* acc, const uint8_t* stripe, const uint8_t* secret) {
+    for (int i = 0; i < 8; ++i) {
+        const uint64_t v = ReadLe64(stripe + 8 * i);
+        const uint64_t k = v ^ ReadLe64(secret + 8 * i);
+        acc[i ^ 1] += v;
+        acc[i] += (k & 0xffffffffULL) * (k >> 32);
+    }
+}
+
+inline void Scramble(uint64_t* acc, const uint8_t* secret) {
+    for (int i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= ReadLe64(secret + 8 * i);
+        acc[i] = a * kPrime32_1;
+    }
+}
+
+uint64_t MergeAccs(const uint64_t* acc, const uint8_t* secret, uint64_t start) {
+    uint64_t result = start;
+    for (int i = 0; i < 4; ++i) {
+        result += MulFold64(acc[2 * i] ^ ReadLe64(secret + 16 * i), acc[2 * i + 1] ^ ReadLe64(secret + 16 * i + 8));
+    }
+    return Avalanche(result);
+}
+
+// Process-wide helpers for tree hashing, started on first use. The caller
+// works through its own chunks as well, so concurrent HashContent calls
+// share a fixed set of threads rather than each starting its own.
+class HashPool {
+public:
+    static HashPool& Instance() {
+        static HashPool pool;
+        return pool;
+    }
+
+    ~HashPool() {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& t : threads_) {
+            t.join();
+        }
+    }
+
+    // Calls fn(i) for every i in [0, tasks) and returns when all are done.
+    void Run(size_t tasks, const std::function<void(size_t)>& fn) {
+        auto job = std::make_shared<Job>();
+        job->fn = &fn;
+        job->tasks = tasks;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            jobs_.push_back(job);
+        }
+        work_cv_.notify_all();
+        Work(*job);
+        std::unique_lock<std::mutex> lock(mu_);
+        // Every task is claimed by now; helpers need not look at it again.
+        jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+        done_cv_.wait(lock, [&] { return job->done == job->tasks; });
+    }
+
+private:
+    struct Job {
+        const std::function<void(size_t)>* fn = nullptr;
+        size_t tasks = 0;
+        std::atomic<size_t> next{0};
+        size_t done = 0; // guarded by mu_
+    };
+
+    HashPool() {
+        const size_t helpers =
+            std::min<size_t>(kMaxHashThreads, std::max(1u, std::thread::hardware_concurrency())) - 1;
+        for (size_t i = 0; i < helpers; ++i) {
+            threads_.emplace_back([this] { Loop(); });
+        }
+    }
+
+    void Work(Job& job) {
+        size_t finished = 0;
+        for (size_t i = job.next.fetch_add(1); i < job.tasks; i = job.next.fetch_add(1)) {
+            (*job.fn)(i);
+            finished++;
+        }
+        if (finished == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        job.done += finished;
+        if (job.done == job.tasks) {
+            done_cv_.notify_all();
+        }
+    }
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (true) {
+            work_cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_) {
+                return;
+            }
+            std::shared_ptr<Job> job = jobs_.front();
+            if (job->next.load() >= job->tasks) {
+                // Every task is claimed; whoever claimed them reports done.
+                jobs_.pop_front();
+                continue;
+            }
+            lock.unlock();
+            Work(*job);
+            lock.lock();
+        }
+    }
+
+    std::mutex mu_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> threads_;
+    bool stop_ = false;
+};
+
+} // namespace
+
+void Hash128::WriteHex(char* out) const {
+    static const char kDigits[] = "0123456789abcdef";
+    for (int i = 0; i < 16; ++i) {
+        out[i] = kDigits[(hi >> (60 - 4 * i)) & 0xf];
+        out[16 + i] = kDigits[(lo >> (60 - 4 * i)) & 0xf];
+    }
+}
+
+std::string Hash128::Hex() const {
+    std::string out(32, '0');
+    WriteHex(out.data());
+    return out;
+}
+
+ContentHasher::ContentHasher(uint64_t seed) : seed_(seed) {
+    const uint64_t init[kLanes] = {
+        kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1,
+    };
+    std::copy(init, init + kLanes, acc_);
+    // Long inputs use the secret derived from the seed (XXH3_initCustomSecret).
+    for (size_t i = 0; i < kSecretBytes; i += 16) {
+        WriteLe64(secret_ + i, ReadLe64(kDefaultSecret + i) + seed);
+        WriteLe64(secret_ + i + 8, ReadLe64(kDefaultSecret + i + 8) - seed);
+    }
+}
+
+void ContentHasher::ConsumeStripe(const uint8_t* stripe) {
+    Accumulate512(acc_, stripe, secret_ + stripes_ * 8);
+    if (++stripes_ == kStripesPerBlock) {
+        Scramble(acc_, secret_ + kSecretBytes - kStripe);
+        stripes_ = 0;
+    }
+}
+
+void ContentHasher::Update(const uint8_t* data, size_t len) {
+    total_len_ += len;
+    if (head_len_ < kMidsizeMax) {
+        const size_t take = std::min(len, kMidsizeMax - head_len_);
+        std::memcpy(head_ + head_len_, data, take);
+        head_len_ += take;
+    }
+
+    // A stripe is consumed only once a later byte has arrived: the final
+    // 1..64 bytes always stay pending for Finish, as in the one-shot hash.
+    if (buf_len_ + len <= kStripeBytes) {
+        std::memcpy(buf_ + buf_len_, data, len);
+        buf_len_ += len;
+        return;
+    }
+    if (buf_len_ > 0) {
+        const size_t take = kStripeBytes - buf_len_;
+        std::memcpy(buf_ + buf_len_, data, take);
+        data += take;
+        len -= take;
+        ConsumeStripe(buf_);
+        std::memcpy(prev_, buf_, kStripeBytes);
+    }
+    if (len > kStripeBytes) {
+        while (len > kStripeBytes) {
+            ConsumeStripe(data);
+            data += kStripeBytes;
+            len -= kStripeBytes;
+        }
+        std::memcpy(prev_, data - kStripeBytes, kStripeBytes);
+    }
+    std::memcpy(buf_, data, len);
+    buf_len_ = len;
+}
+
+Hash128 ContentHasher::Finish() const {
+    const size_t len = static_cast<size_t>(total_len_);
+    if (total_len_ <= 16) {
+        return Len0To16(head_, len, kDefaultSecret, seed_);
+    }
+    if (total_len_ <= 128) {
+        return Len17To128(head_, len, kDefaultSecret, seed_);
+    }
+    if (total_len_ <= kMidsizeMax) {
+        return Len129To240(head_, len, kDefaultSecret, seed_);
+    }
+
+    uint64_t acc[kLanes];
+    std::copy(acc_, acc_ + kLanes, acc);
+    uint8_t last[kStripeBytes];
+    std::memcpy(last, prev_ + buf_len_, kStripeBytes - buf_len_);
+    std::memcpy(last + kStripeBytes - buf_len_, buf_, buf_len_);
+    Accumulate512(acc, last, secret_ + kSecretBytes - kStripe - kLastAccStart);
+
+    Hash128 out;
+    out.lo = MergeAccs(acc, secret_ + kMergeAccsStart, total_len_ * kPrime64_1);
+    out.hi = MergeAccs(acc, secret_ + kSecretBytes - kStripe - kMergeAccsStart, ~(total_len_ * kPrime64_2));
+    return out;
+}
+
+Hash128 HashContent(const uint8_t* data, size_t len) {
+    if (len <= kChunkBytes) {
+        ContentHasher hasher;
+        hasher.Update(data, len);
+        return hasher.Finish();
+    }
+
+    const size_t chunks = (len + kChunkBytes - 1) / kChunkBytes;
+    std::vector<Hash128> digests(chunks);
+    const std::function<void(size_t)> hash_chunk = [&](size_t c) {
+        const size_t offset = c * kChunkBytes;
+        ContentHasher hasher(c + 1);
+        hasher.Update(data + offset, std::min(kChunkBytes, len - offset));
+        digests[c] = hasher.Finish();
+    };
+    if (len < kParallelMinBytes) {
+        for (size_t c = 0; c < chunks; ++c) {
+            hash_chunk(c);
+        }
+    } else {
+        HashPool::Instance().Run(chunks, hash_chunk);
+    }
+
+    ContentHasher root(kTreeSeed);
+    uint8_t word[8];
+    for (const auto& d : digests) {
+        WriteLe64(word, d.lo);
+        root.Update(word, sizeof(word));
+        WriteLe64(word, d.hi);
+        root.Update(word, sizeof(word));
+    }
+    WriteLe64(word, static_cast<uint64_t>(len));
+    root.Update(word, sizeof(word));
+    return root.Finish();
+}
+
+std::string ContentId(const std::vector<uint8_t>& data) {
+    return HashContent(data.data(), data.size()).Hex();
+}
+
+} // namespace prompt_cache_poc
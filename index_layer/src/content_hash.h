@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+struct Hash128 {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    // Writes 32 lowercase hex digits (hi then lo) to out.
+    void WriteHex(char* out) const;
+    std::string Hex() const;
+
+    bool operator==(const Hash128& other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const Hash128& other) const { return !(*this == other); }
+};
+
+// Streaming XXH3-128 (xxHash 0.8, default secret). Output matches the
+// reference XXH3_128bits_withSeed for every input length and any split of
+// the input across Update calls. Input words are decoded little-endian, so
+// values are the same on every platform.
+class ContentHasher {
+public:
+    explicit ContentHasher(uint64_t seed = 0);
+
+    void Update(const uint8_t* data, size_t len);
+    Hash128 Finish() const;
+
+private:
+    static constexpr size_t kStripeBytes = 64;
+    static constexpr size_t kSecretBytes = 192;
+    static constexpr size_t kMidsizeMax = 240;
+    static constexpr int kLanes = 8;
+
+    void ConsumeStripe(const uint8_t* stripe);
+
+    uint64_t acc_[kLanes];
+    uint8_t secret_[kSecretBytes];
+    // Inputs up to kMidsizeMax bytes are hashed by the short paths at Finish.
+    uint8_t head_[kMidsizeMax];
+    size_t head_len_ = 0;
+    // Pending bytes (1..64 once anything was written) and the last stripe
+    // consumed, which Finish needs when the pending tail is shorter than one.
+    uint8_t buf_[kStripeBytes];
+    size_t buf_len_ = 0;
+    uint8_t prev_[kStripeBytes];
+    size_t stripes_ = 0; // in the current block
+    uint64_t total_len_ = 0;
+    uint64_t seed_ = 0;
+};
+
+// Content hash used for object ids. Payloads larger than one chunk (1 MiB)
+// are hashed as a two-level tree: each chunk is hashed independently (in
+// parallel on a shared worker pool for large payloads) and the chunk digests
+// are hashed together.
+// The tree shape depends only on the length, so the id does not depend on
+// the thread count.
+Hash128 HashContent(const uint8_t* data, size_t len);
+
+// 32 hex digits of HashContent, hashed in place.
+std::string ContentId(const std::vector<uint8_t>& data);
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,603 @@
+#include "kv_arena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+constexpr size_t kHugePageBytes = 2u * 1024u * 1024u;
+
+size_t RoundUp(size_t value, size_t align) {
+    return (value + align - 1) / align * align;
+}
+
+} // namespace
+
+KvArena::KvArena(Config cfg) : cfg_(cfg) {
+    if (cfg_.tokens_per_column <= 0 || cfg_.bytes_per_token <= 0) {
+        throw std::invalid_argument("tokens_per_column and bytes_per_token must be positive");
+    }
+    column_bytes_ = static_cast<size_t>(cfg_.tokens_per_column) * static_cast<size_t>(cfg_.bytes_per_token);
+    if (cfg_.region_bytes < column_bytes_) {
+        cfg_.region_bytes = column_bytes_;
+    }
+    if (cfg_.compact_interval.count() > 0) {
+        compactor_ = std::thread([this] { CompactorLoop(); });
+    }
+}
+
+KvArena::~KvArena() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (compactor_.joinable()) {
+        compactor_.join();
+    }
+    for (auto& region : regions_) {
+        munmap(region.base, region.bytes);
+    }
+}
+
+bool KvArena::ReserveSpace(uint64_t prompt_id, int num_tokens) {
+    if (num_tokens <= 0) {
+        return false;
+    }
+    const uint32_t columns = static_cast<uint32_t>(
+        (num_tokens + cfg_.tokens_per_column - 1) / cfg_.tokens_per_column);
+
+    std::lock_guard<std::mutex> lock(mu_);
+    Extent extent;
+    if (!AllocExtentLocked(columns, extent)) {
+        return false;
+    }
+    auto [it, inserted] = prompts_.try_emplace(prompt_id);
+    Prompt& prompt = it->second;
+    if (inserted) {
+        prompt.created = std::chrono::steady_clock::now();
+    }
+    ReleaseReservationTailLocked(prompt);
+    prompt.reservation = extent;
+    prompt.reservation_used = 0;
+    prompt.generation++;
+    return true;
+}
+
+bool KvArena::AppendColumn(uint64_t prompt_id, const uint8_t* data, size_t len) {
+    if (len != column_bytes_) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mu_);
+    auto [it, inserted] = prompts_.try_emplace(prompt_id);
+    Prompt& prompt = it->second;
+    if (inserted) {
+        prompt.created = std::chrono::steady_clock::now();
+    }
+
+    Slot slot;
+    if (!AllocSlotLocked(prompt, slot)) {
+        if (prompt.columns.empty()) {
+            ReleaseReservationTailLocked(prompt);
+            prompts_.erase(it);
+        }
+        return false;
+    }
+    std::memcpy(SlotPtr(slot), data, column_bytes_);
+    prompt.columns.push_back(slot);
+    prompt.generation++;
+    return true;
+}
+
+bool KvArena::Read(uint64_t prompt_id, int num_columns, std::vector<uint8_t>& out) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = prompts_.find(prompt_id);
+    if (it == prompts_.end()) {
+        return false;
+    }
+    const Prompt& prompt = it->second;
+    size_t count = prompt.columns.size();
+    if (num_columns > 0) {
+        if (static_cast<size_t>(num_columns) > count) {
+            return false;
+        }
+        count = static_cast<size_t>(num_columns);
+    }
+
+    out.resize(count * column_bytes_);
+    if (count == 0) {
+        return true;
+    }
+    if (ContiguousLocked(prompt)) {
+        std::memcpy(out.data(), SlotPtr(prompt.columns.front()), out.size());
+        return true;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(out.data() + i * column_bytes_, SlotPtr(prompt.columns[i]), column_bytes_);
+    }
+    return true;
+}
+
+void KvArena::Truncate(uint64_t prompt_id, int num_columns) {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = prompts_.find(prompt_id);
+    if (it == prompts_.end()) {
+        return;
+    }
+    Prompt& prompt = it->second;
+    ReleaseReservationTailLocked(prompt);
+    prompt.generation++;
+    const size_t keep = num_columns > 0 ? static_cast<size_t>(num_columns) : 0;
+    while (prompt.columns.size() > keep) {
+        const Slot slot = prompt.columns.back();
+        prompt.columns.pop_back();
+        FreeColumnLocked(prompt_id, slot);
+    }
+    if (prompt.columns.empty()) {
+        prompts_.erase(it);
+    }
+}
+
+void KvArena::Release(uint64_t prompt_id) {
+    Truncate(prompt_id, 0);
+}
+
+bool KvArena::IsContiguous(uint64_t prompt_id) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = prompts_.find(prompt_id);
+    return it != prompts_.end() && ContiguousLocked(it->second);
+}
+
+int KvArena::ColumnCount(uint64_t prompt_id) const {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = prompts_.find(prompt_id);
+    return it == prompts_.end() ? 0 : static_cast<int>(it->second.columns.size());
+}
+
+size_t KvArena::ColumnBytes() const {
+    return column_bytes_;
+}
+
+size_t KvArena::CompactOnce(std::chrono::milliseconds min_age) {
+    std::vector<uint64_t> candidates;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        const auto cutoff = std::chrono::steady_clock::now() - min_age;
+        for (const auto& [id, prompt] : prompts_) {
+            if (prompt.created <= cutoff && !ContiguousLocked(prompt)) {
+                candidates.push_back(id);
+            }
+        }
+    }
+
+    // One prompt at a time: take a destination extent under the lock, copy
+    // without it so readers and appenders are not stalled behind the memcpy,
+    // then switch the prompt over only if it was not touched meanwhile. The
+    // source slots stay pinned during the copy: a Truncate or Release of the
+    // prompt defers freeing them until the copy is done.
+    size_t moved = 0;
+    std::vector<const uint8_t*> sources;
+    for (uint64_t id : candidates) {
+        Extent extent;
+        uint8_t* dst = nullptr;
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            auto it = prompts_.find(id);
+            if (it == prompts_.end() || ContiguousLocked(it->second)) {
+                continue;
+            }
+            Prompt& prompt = it->second;
+            ReleaseReservationTailLocked(prompt);
+            if (!AllocExtentLocked(static_cast<uint32_t>(prompt.columns.size()), extent)) {
+                continue;
+            }
+            // Region bases never move, but regions_ itself may grow, so
+            // resolve the pointers while it is stable.
+            sources.clear();
+            for (const Slot& slot : prompt.columns) {
+                sources.push_back(SlotPtr(slot));
+            }
+            dst = SlotPtr(Slot{extent.region, extent.start});
+            generation = prompt.generation;
+            compacting_ = true;
+            compacting_id_ = id;
+        }
+
+        for (size_t i = 0; i < sources.size(); ++i) {
+            std::memcpy(dst + i * column_bytes_, sources[i], column_bytes_);
+        }
+
+        std::lock_guard<std::mutex> lock(mu_);
+        compacting_ = false;
+        for (const Slot& slot : deferred_free_) {
+            FreeExtentLocked(slot.region, slot.index, 1);
+        }
+        deferred_free_.clear();
+        auto it = prompts_.find(id);
+        if (it == prompts_.end() || it->second.generation != generation) {
+            FreeExtentLocked(extent.region, extent.start, extent.length);
+            continue;
+        }
+        Prompt& prompt = it->second;
+        ReleaseReservationTailLocked(prompt);
+        for (uint32_t i = 0; i < extent.length; ++i) {
+            FreeExtentLocked(prompt.columns[i].region, prompt.columns[i].index, 1);
+            prompt.columns[i] = Slot{extent.region, extent.start + i};
+        }
+        prompt.reservation = extent;
+        prompt.reservation_used = extent.length;
+        prompt.generation++;
+        compactions_++;
+        moved++;
+    }
+    return moved;
+}
+
+KvArena::Stats KvArena::GetStats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    Stats stats;
+    stats.regions = regions_.size();
+    for (const auto& region : regions_) {
+        if (region.huge) {
+            stats.huge_page_regions++;
+        }
+        stats.total_columns += region.slots;
+    }
+    for (const auto& [id, prompt] : prompts_) {
+        stats.used_columns += prompt.columns.size();
+        stats.reserved_columns += prompt.reservation.length - prompt.reservation_used;
+        if (!ContiguousLocked(prompt)) {
+            stats.fragmented_prompts++;
+        }
+    }
+    stats.prompts = prompts_.size();
+    stats.compactions = compactions_;
+    return stats;
+}
+
+bool KvArena::AllocExtentLocked(uint32_t length, Extent& out) {
+    if (length == 0 || length > cfg_.region_bytes / column_bytes_) {
+        return false;
+    }
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        for (size_t r = 0; r < regions_.size(); ++r) {
+            auto& extents = regions_[r].free_extents;
+            for (auto it = extents.begin(); it != extents.end(); ++it) {
+                if (it->second < length) {
+                    continue;
+                }
+                out.region = static_cast<uint32_t>(r);
+                out.start = it->first;
+                out.length = length;
+                const uint32_t remaining = it->second - length;
+                const uint32_t next_start = it->first + length;
+                extents.erase(it);
+                if (remaining > 0) {
+                    extents.emplace(next_start, remaining);
+                }
+                return true;
+            }
+        }
+        if (attempt == 0 && !AddRegionLocked()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool KvArena::AllocSlotLocked(Prompt& prompt, Slot& out) {
+    if (prompt.reservation_used < prompt.reservation.length) {
+        out.region = prompt.reservation.region;
+        out.index = prompt.reservation.start + prompt.reservation_used;
+        prompt.reservation_used++;
+        return true;
+    }
+
+    // Grow in place when the slot right after the last column is free.
+    if (!prompt.columns.empty()) {
+        const Slot& last = prompt.columns.back();
+        auto& extents = regions_[last.region].free_extents;
+        auto it = extents.find(last.index + 1);
+        if (it != extents.end()) {
+            out.region = last.region;
+            out.index = it->first;
+            const uint32_t remaining = it->second - 1;
+            extents.erase(it);
+            if (remaining > 0) {
+                extents.emplace(out.index + 1, remaining);
+            }
+            return true;
+        }
+    }
+
+    Extent extent;
+    if (!AllocExtentLocked(1, extent)) {
+        return false;
+    }
+    out.region = extent.region;
+    out.index = extent.start;
+    return true;
+}
+
+void KvArena::FreeExtentLocked(uint32_t region, uint32_t start, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    auto& extents = regions_[region].free_extents;
+    auto next = extents.lower_bound(start);
+    if (next != extents.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            length += prev->second;
+            extents.erase(prev);
+        }
+    }
+    if (next != extents.end() && start + length == next->first) {
+        length += next->second;
+        extents.erase(next);
+    }
+    extents.emplace(start, length);
+}
+
+void KvArena::FreeColumnLocked(uint64_t prompt_id, const Slot& slot) {
+    if (compacting_ && prompt_id == compacting_id_) {
+        deferred_free_.push_back(slot);
+        return;
+    }
+    FreeExtentLocked(slot.region, slot.index, 1);
+}
+
+void KvArena::ReleaseReservationTailLocked(Prompt& prompt) {
+    const uint32_t unused = prompt.reservation.length - prompt.reservation_used;
+    if (unused > 0) {
+        FreeExtentLocked(prompt.reservation.region,
+                         prompt.reservation.start + prompt.reservation_used,
+                         unused);
+    }
+    prompt.reservation = Extent{};
+    prompt.reservation_used = 0;
+}
+
+bool KvArena::AddRegionLocked() {
+    if (cfg_.max_regions > 0 && regions_.size() >= cfg_.max_regions) {
+        return false;
+    }
+
+    Region region;
+    void* base = MAP_FAILED;
+    if (cfg_.huge_pages) {
+        region.bytes = RoundUp(cfg_.region_bytes, kHugePageBytes);
+#ifdef MAP_HUGETLB
+        base = mmap(nullptr, region.bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        region.huge = base != MAP_FAILED;
+#endif
+    } else {
+        region.bytes = cfg_.region_bytes;
+    }
+    if (base == MAP_FAILED) {
+        base = mmap(nullptr, region.bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (cfg_.huge_pages) {
+            madvise(base, region.bytes, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    region.base = static_cast<uint8_t*>(base);
+    region.slots = static_cast<uint32_t>(region.bytes / column_bytes_);
+    region.free_extents.emplace(0, region.slots);
+    regions_.push_back(std::move(region));
+    return true;
+}
+
+uint8_t* KvArena::SlotPtr(const Slot& slot) const {
+    return regions_[slot.region].base + static_cast<size_t>(slot.index) * column_bytes_;
+}
+
+bool KvArena::ContiguousLocked(const Prompt& prompt) {
+    for (size_t i = 1; i < prompt.columns.size(); ++i) {
+        if (prompt.columns[i].region != prompt.columns[0].region ||
+            prompt.columns[i].index != prompt.columns[i - 1].index + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void KvArena::CompactorLoop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!stop_) {
+        stop_cv_.wait_for(lock, cfg_.compact_interval, [this] { return stop_; });
+        if (stop_) {
+            break;
+        }
+        lock.unlock();
+        CompactOnce(cfg_.compact_min_age);
+        lock.lock();
+    }
+}
+
+ArenaStorage::ArenaStorage(std::shared_ptr<Storage> backing, KvArena::Config cfg)
+    : backing_(std::move(backing)), arena_(cfg), tokens_per_column_(cfg.tokens_per_column) {
+    if (!backing_) {
+        throw std::invalid_argument("backing storage must not be null");
+    }
+}
+
+bool ArenaStorage::Put(const std::string& obj_id, const std::vector<uint8_t>& data) {
+    if (!backing_->Put(obj_id, data)) {
+        return false;
+    }
+    if (Cache(obj_id, data)) {
+        cache_fills_++;
+    } else {
+        cache_full_++;
+    }
+    return true;
+}
+
+bool ArenaStorage::Cache(const std::string& obj_id, const std::vector<uint8_t>& data) {
+    uint64_t prompt_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        prompt_id = ++next_prompt_id_;
+    }
+
+    // Fill the new copy before publishing it, so readers only ever see a
+    // complete object.
+    const size_t column_bytes = arena_.ColumnBytes();
+    const size_t columns = (data.size() + column_bytes - 1) / column_bytes;
+    bool ok = columns > 0;
+    if (ok) {
+        // Best effort: without a run the columns land wherever they fit.
+        arena_.ReserveSpace(prompt_id, static_cast<int>(columns) * tokens_per_column_);
+    }
+    std::vector<uint8_t> tail;
+    for (size_t c = 0; ok && c < columns; ++c) {
+        const size_t offset = c * column_bytes;
+        if (offset + column_bytes <= data.size()) {
+            ok = arena_.AppendColumn(prompt_id, data.data() + offset, column_bytes);
+        } else {
+            tail.assign(column_bytes, 0);
+            std::memcpy(tail.data(), data.data() + offset, data.size() - offset);
+            ok = arena_.AppendColumn(prompt_id, tail.data(), tail.size());
+        }
+    }
+
+    uint64_t previous = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = index_.find(obj_id);
+        if (it != index_.end()) {
+            previous = it->second.prompt_id;
+            index_.erase(it);
+        }
+        if (ok) {
+            index_.emplace(obj_id, Cached{prompt_id, data.size()});
+        }
+    }
+    if (previous != 0) {
+        arena_.Release(previous);
+    }
+    if (!ok) {
+        arena_.Release(prompt_id);
+    }
+    return ok;
+}
+
+bool ArenaStorage::ReadCached(const std::string& obj_id, size_t max_bytes, std::vector<uint8_t>& out) const {
+    Cached cached;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = index_.find(obj_id);
+        if (it == index_.end()) {
+            return false;
+        }
+        cached = it->second;
+    }
+    const size_t bytes = std::min(cached.bytes, max_bytes);
+    const size_t column_bytes = arena_.ColumnBytes();
+    const int columns = static_cast<int>((bytes + column_bytes - 1) / column_bytes);
+    if (columns == 0) {
+        out.clear();
+        return true;
+    }
+    if (!arena_.Read(cached.prompt_id, columns, out)) {
+        return false;
+    }
+    out.resize(bytes);
+    return true;
+}
+
+bool ArenaStorage::GetRange(const std::string& obj_id, int max_bytes, std::vector<uint8_t>& out) const {
+    const size_t limit = max_bytes > 0 ? static_cast<size_t>(max_bytes) : SIZE_MAX;
+    if (ReadCached(obj_id, limit, out)) {
+        hits_++;
+        return true;
+    }
+    misses_++;
+    return backing_->GetRange(obj_id, max_bytes, out);
+}
+
+bool ArenaStorage::GetRanges(const std::string& obj_id,
+                             const std::vector<ByteRange>& ranges,
+                             std::vector<std::vector<uint8_t>>& out) const {
+    int64_t end = 0;
+    for (const auto& r : ranges) {
+        if (r.offset < 0 || r.length <= 0) {
+            return false;
+        }
+        end = std::max(end, r.offset + r.length);
+    }
+    std::vector<uint8_t> covering;
+    if (!ReadCached(obj_id, static_cast<size_t>(end), covering) ||
+        static_cast<int64_t>(covering.size()) < end) {
+        misses_++;
+        return backing_->GetRanges(obj_id, ranges, out);
+    }
+    hits_++;
+    out.clear();
+    out.reserve(ranges.size());
+    for (const auto& r : ranges) {
+        out.emplace_back(covering.begin() + r.offset, covering.begin() + r.offset + r.length);
+    }
+    return true;
+}
+
+bool ArenaStorage::Delete(const std::string& obj_id) {
+    uint64_t prompt_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = index_.find(obj_id);
+        if (it != index_.end()) {
+            prompt_id = it->second.prompt_id;
+            index_.erase(it);
+        }
+    }
+    if (prompt_id != 0) {
+        arena_.Release(prompt_id);
+    }
+    return backing_->Delete(obj_id);
+}
+
+size_t ArenaStorage::Size() const {
+    return backing_->Size();
+}
+
+bool ArenaStorage::Exists(const std::string& obj_id) const {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (index_.count(obj_id) > 0) {
+            return true;
+        }
+    }
+    return backing_->Exists(obj_id);
+}
+
+ArenaStorage::Stats ArenaStorage::GetStats() const {
+    Stats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.cache_fills = cache_fills_.load();
+    stats.cache_full = cache_full_.load();
+    return stats;
+}
+
+KvArena::Stats ArenaStorage::GetArenaStats() const {
+    return arena_.GetStats();
+}
+
+} // namespace prompt_cache_poc
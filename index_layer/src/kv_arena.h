@@ -0,0 +1,191 @@
+#pragma once
+
+#include "cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Arena for KV column payloads.
+//
+// Memory is carved out of large mmap'd regions (huge-page backed when the
+// kernel allows it) into fixed-size column slots. Each prompt owns an ordered
+// list of slots; kvss_reserve_space hints pre-allocate a contiguous run so the
+// common case is one extent per prompt and a refill is a single memcpy. A
+// background compactor moves fragmented, long-lived prompts into contiguous
+// runs.
+class KvArena {
+public:
+    struct Config {
+        int tokens_per_column = 64;
+        int bytes_per_token = 0;
+        size_t region_bytes = 64u * 1024u * 1024u;
+        size_t max_regions = 0; // 0 = unbounded
+        bool huge_pages = true;
+        std::chrono::milliseconds compact_interval{0}; // 0 = no background compactor
+        std::chrono::milliseconds compact_min_age{30000};
+    };
+
+    struct Stats {
+        size_t regions = 0;
+        size_t huge_page_regions = 0;
+        size_t total_columns = 0;
+        size_t used_columns = 0;
+        size_t reserved_columns = 0;
+        size_t prompts = 0;
+        size_t fragmented_prompts = 0;
+        uint64_t compactions = 0;
+    };
+
+    explicit KvArena(Config cfg);
+    ~KvArena();
+
+    KvArena(const KvArena&) = delete;
+    KvArena& operator=(const KvArena&) = delete;
+
+    // kvss_reserve_space: hint only, never blocks. Returns false if no
+    // contiguous run of the requested size is available.
+    bool ReserveSpace(uint64_t prompt_id, int num_tokens);
+
+    // Appends one column (column_bytes) to the prompt.
+    bool AppendColumn(uint64_t prompt_id, const uint8_t* data, size_t len);
+
+    // Copies the first num_columns columns (0 = all) into out.
+    bool Read(uint64_t prompt_id, int num_columns, std::vector<uint8_t>& out) const;
+
+    // Drops columns on the right so that num_columns remain (0 = release all).
+    void Truncate(uint64_t prompt_id, int num_columns);
+    void Release(uint64_t prompt_id);
+
+    bool IsContiguous(uint64_t prompt_id) const;
+    int ColumnCount(uint64_t prompt_id) const;
+    size_t ColumnBytes() const;
+
+    // Relocates fragmented prompts older than min_age into contiguous runs.
+    // Returns the number of prompts moved.
+    size_t CompactOnce(std::chrono::milliseconds min_age);
+
+    Stats GetStats() const;
+
+private:
+    struct Region {
+        uint8_t* base = nullptr;
+        size_t bytes = 0;
+        uint32_t slots = 0;
+        bool huge = false;
+        std::map<uint32_t, uint32_t> free_extents; // start -> length
+    };
+
+    struct Slot {
+        uint32_t region = 0;
+        uint32_t index = 0;
+    };
+
+    struct Extent {
+        uint32_t region = 0;
+        uint32_t start = 0;
+        uint32_t length = 0;
+    };
+
+    struct Prompt {
+        std::vector<Slot> columns;
+        Extent reservation;
+        uint32_t reservation_used = 0;
+        std::chrono::steady_clock::time_point created;
+        // Bumped by every change to columns or reservation; CompactOnce
+        // drops a copy made while the prompt changed.
+        uint64_t generation = 0;
+    };
+
+    bool AllocExtentLocked(uint32_t length, Extent& out);
+    bool AllocSlotLocked(Prompt& prompt, Slot& out);
+    void FreeExtentLocked(uint32_t region, uint32_t start, uint32_t length);
+    void ReleaseReservationTailLocked(Prompt& prompt);
+    void FreeColumnLocked(uint64_t prompt_id, const Slot& slot);
+    bool AddRegionLocked();
+    uint8_t* SlotPtr(const Slot& slot) const;
+    static bool ContiguousLocked(const Prompt& prompt);
+    void CompactorLoop();
+
+    Config cfg_;
+    size_t column_bytes_ = 0;
+
+    mutable std::mutex mu_;
+    std::vector<Region> regions_;
+    std::unordered_map<uint64_t, Prompt> prompts_;
+    uint64_t compactions_ = 0;
+    // While CompactOnce copies a prompt's columns without the lock, slots
+    // that prompt gives up are parked here instead of freed, so they cannot
+    // be reallocated and rewritten under the copy.
+    bool compacting_ = false;
+    uint64_t compacting_id_ = 0;
+    std::vector<Slot> deferred_free_;
+
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+    std::thread compactor_;
+};
+
+// Host-memory tier in front of another Storage. Put writes through and keeps
+// a copy in a KvArena (one reserved run of columns per object, the last one
+// zero-padded); GetRange/GetRanges serve cached objects from the arena and
+// fall back to the backing store on a miss or when the arena is full.
+class ArenaStorage final : public Storage {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t cache_fills = 0;
+        uint64_t cache_full = 0;
+    };
+
+    ArenaStorage(std::shared_ptr<Storage> backing, KvArena::Config cfg);
+
+    bool Put(const std::string& obj_id, const std::vector<uint8_t>& data) override;
+    bool GetRange(const std::string& obj_id, int max_bytes, std::vector<uint8_t>& out) const override;
+    bool GetRanges(const std::string& obj_id,
+                   const std::vector<ByteRange>& ranges,
+                   std::vector<std::vector<uint8_t>>& out) const override;
+    bool Delete(const std::string& obj_id) override;
+    size_t Size() const override;
+    bool Exists(const std::string& obj_id) const override;
+
+    Stats GetStats() const;
+    KvArena::Stats GetArenaStats() const;
+
+private:
+    struct Cached {
+        uint64_t prompt_id = 0;
+        size_t bytes = 0;
+    };
+
+    bool Cache(const std::string& obj_id, const std::vector<uint8_t>& data);
+    bool ReadCached(const std::string& obj_id, size_t max_bytes, std::vector<uint8_t>& out) const;
+
+    std::shared_ptr<Storage> backing_;
+    KvArena arena_;
+    int tokens_per_column_ = 0;
+
+    mutable std::mutex mu_;
+    std::unordered_map<std::string, Cached> index_;
+    // Arena ids are never reused, so a reader holding a stale id just misses.
+    uint64_t next_prompt_id_ = 0;
+
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> cache_fills_{0};
+    std::atomic<uint64_t> cache_full_{0};
+};
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,143 @@
+#include "kv_layout.h"
+
+#include <cstring>
+
+namespace prompt_cache_poc {
+
+bool ObjectLayout::Empty() const {
+    return buffer_bytes_per_token.empty();
+}
+
+bool ObjectLayout::Valid(size_t total_bytes) const {
+    if (Empty() || num_tokens <= 0) {
+        return false;
+    }
+    for (int bpt : buffer_bytes_per_token) {
+        if (bpt <= 0) {
+            return false;
+        }
+    }
+    return BytesPerToken() * num_tokens == static_cast<int64_t>(total_bytes);
+}
+
+int64_t ObjectLayout::BytesPerToken() const {
+    int64_t total = 0;
+    for (int bpt : buffer_bytes_per_token) {
+        total += bpt;
+    }
+    return total;
+}
+
+int64_t ObjectLayout::BufferOffset(size_t buffer) const {
+    int64_t offset = 0;
+    for (size_t i = 0; i < buffer; ++i) {
+        if (order == Order::kTokenMajor) {
+            offset += buffer_bytes_per_token[i];
+        } else {
+            offset += static_cast<int64_t>(buffer_bytes_per_token[i]) * num_tokens;
+        }
+    }
+    return offset;
+}
+
+std::vector<ByteRange> ObjectLayout::FetchRanges(const std::vector<TokenSpan>& spans) const {
+    std::vector<ByteRange> ranges;
+    if (Empty()) {
+        return ranges;
+    }
+
+    auto append = [&ranges](ByteRange r) {
+        if (r.length <= 0) {
+            return;
+        }
+        if (!ranges.empty() && ranges.back().offset + ranges.back().length == r.offset) {
+            ranges.back().length += r.length;
+        } else {
+            ranges.push_back(r);
+        }
+    };
+
+    if (order == Order::kTokenMajor) {
+        const int64_t bpt = BytesPerToken();
+        for (const auto& span : spans) {
+            append({span.first * bpt, span.count * bpt});
+        }
+        return ranges;
+    }
+
+    for (size_t b = 0; b < buffer_bytes_per_token.size(); ++b) {
+        const int64_t bpt = buffer_bytes_per_token[b];
+        for (const auto& span : spans) {
+            append({BufferOffset(b) + span.first * bpt, span.count * bpt});
+        }
+    }
+    return ranges;
+}
+
+std::vector<ByteRange> ObjectLayout::FetchRanges(int first_token, int count) const {
+    return FetchRanges(std::vector<TokenSpan>{{first_token, count}});
+}
+
+bool ObjectLayout::Demux(const std::vector<TokenSpan>& spans,
+                         const std::vector<std::vector<uint8_t>>& fetched,
+                         std::vector<std::vector<uint8_t>>& out) const {
+    const std::vector<ByteRange> ranges = FetchRanges(spans);
+    if (fetched.size() != ranges.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (static_cast<int64_t>(fetched[i].size()) != ranges[i].length) {
+            return false;
+        }
+    }
+
+    // Finds the fetched bytes for object range [begin, begin + length).
+    auto locate = [&](int64_t begin, int64_t length) -> const uint8_t* {
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            if (ranges[i].offset <= begin && begin + length <= ranges[i].offset + ranges[i].length) {
+                return fetched[i].data() + (begin - ranges[i].offset);
+            }
+        }
+        return nullptr;
+    };
+
+    out.assign(buffer_bytes_per_token.size(), {});
+    const int64_t stride = BytesPerToken();
+    for (size_t b = 0; b < buffer_bytes_per_token.size(); ++b) {
+        const size_t bpt = static_cast<size_t>(buffer_bytes_per_token[b]);
+        const int64_t offset = BufferOffset(b);
+        for (const auto& span : spans) {
+            if (span.count <= 0) {
+                continue;
+            }
+            if (order == Order::kTokenMajor) {
+                // Buffers are strided inside the span's token range.
+                const uint8_t* src = locate(span.first * stride, span.count * stride);
+                if (!src) {
+                    return false;
+                }
+                for (int t = 0; t < span.count; ++t) {
+                    const uint8_t* token = src + t * stride + offset;
+                    out[b].insert(out[b].end(), token, token + bpt);
+                }
+            } else {
+                const int64_t length = static_cast<int64_t>(span.count) * static_cast<int64_t>(bpt);
+                const uint8_t* src = locate(offset + span.first * static_cast<int64_t>(bpt), length);
+                if (!src) {
+                    return false;
+                }
+                out[b].insert(out[b].end(), src, src + length);
+            }
+        }
+    }
+    return true;
+}
+
+bool ObjectLayout::Demux(int first_token,
+                         int count,
+                         const std::vector<std::vector<uint8_t>>& fetched,
+                         std::vector<std::vector<uint8_t>>& out) const {
+    return Demux(std::vector<TokenSpan>{{first_token, count}}, fetched, out);
+}
+
+} // namespace prompt_cache_poc
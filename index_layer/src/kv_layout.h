@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+struct ByteRange {
+    int64_t offset = 0;
+    int64_t length = 0;
+};
+
+struct TokenSpan {
+    int first = 0;
+    int count = 0;
+};
+
+// Describes how the wafer buffers of one KV object (d=0 K, d=0 V, d=1 K, ...)
+// are laid out in the flat byte blob.
+//
+// kTokenMajor: token t holds every buffer's bytes back to back, so a token
+//              prefix is one contiguous range and buffers are strided in it.
+// kBufferMajor: each buffer is a contiguous region of num_tokens tokens, so a
+//              token prefix is one range per buffer.
+struct ObjectLayout {
+    enum class Order { kTokenMajor, kBufferMajor };
+
+    Order order = Order::kTokenMajor;
+    int num_tokens = 0;
+    std::vector<int> buffer_bytes_per_token;
+
+    bool Empty() const;
+    bool Valid(size_t total_bytes) const;
+    int64_t BytesPerToken() const;
+
+    // Object ranges covering the given token spans of every buffer, coalesced
+    // where adjacent.
+    std::vector<ByteRange> FetchRanges(const std::vector<TokenSpan>& spans) const;
+    std::vector<ByteRange> FetchRanges(int first_token, int count) const;
+
+    // Splits the bytes returned for FetchRanges(spans) into one vector per
+    // buffer, with the spans glued in the order given.
+    bool Demux(const std::vector<TokenSpan>& spans,
+               const std::vector<std::vector<uint8_t>>& fetched,
+               std::vector<std::vector<uint8_t>>& out) const;
+    bool Demux(int first_token,
+               int count,
+               const std::vector<std::vector<uint8_t>>& fetched,
+               std::vector<std::vector<uint8_t>>& out) const;
+
+private:
+    int64_t BufferOffset(size_t buffer) const;
+};
+
+} // namespace prompt_cache_poc
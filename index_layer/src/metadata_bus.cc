@@ -0,0 +1,315 @@
+#include "metadata_bus.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+constexpr uint32_t kLogMagic = 0x424d4350; // "PCMB"
+// Header: magic, version, then the commit record (last_seq, end offset of
+// the last committed record), rewritten as one 16-byte pwrite per batch.
+constexpr uint32_t kLogVersion = 3;
+constexpr off_t kHeaderBytes = 24;
+constexpr off_t kCommitOffset = 8;
+
+// Holds an flock for the lifetime of the object.
+class FileLock {
+public:
+    FileLock(int fd, int op) : fd_(fd), ok_(flock(fd, op) == 0) {}
+    ~FileLock() {
+        if (ok_) {
+            flock(fd_, LOCK_UN);
+        }
+    }
+    bool ok() const { return ok_; }
+
+private:
+    int fd_;
+    bool ok_;
+};
+
+bool PreadAll(int fd, void* buf, size_t len, off_t offset) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        const ssize_t n = pread(fd, p, len, offset);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+bool PwriteAll(int fd, const void* buf, size_t len, off_t offset) {
+    const auto* p = static_cast<const uint8_t*>(buf);
+    while (len > 0) {
+        const ssize_t n = pwrite(fd, p, len, offset);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+uint64_t InitialOriginSeq() {
+    // Start from wall-clock microseconds so a restarted replica keeps
+    // producing origin_seqs above the ones peers have already applied.
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+FileBroker::FileBroker(const std::string& path) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("cannot open metadata log: " + path);
+    }
+    FileLock lock(fd_, LOCK_EX);
+    struct stat st;
+    if (!lock.ok() || fstat(fd_, &st) != 0) {
+        close(fd_);
+        throw std::runtime_error("cannot lock metadata log: " + path);
+    }
+    uint8_t header[kHeaderBytes] = {};
+    if (st.st_size == 0) {
+        const uint64_t end = kHeaderBytes;
+        std::memcpy(header, &kLogMagic, 4);
+        std::memcpy(header + 4, &kLogVersion, 4);
+        std::memcpy(header + 16, &end, 8);
+        if (!PwriteAll(fd_, header, sizeof(header), 0)) {
+            close(fd_);
+            throw std::runtime_error("cannot initialize metadata log: " + path);
+        }
+    } else {
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        if (!PreadAll(fd_, header, sizeof(header), 0) || (std::memcpy(&magic, header, 4), magic != kLogMagic) ||
+            (std::memcpy(&version, header + 4, 4), version != kLogVersion)) {
+            close(fd_);
+            throw std::runtime_error("not a metadata log: " + path);
+        }
+    }
+    cursor_offset_ = kHeaderBytes;
+}
+
+FileBroker::~FileBroker() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool FileBroker::ReadLastSeq(uint64_t& last_seq) const {
+    return PreadAll(fd_, &last_seq, sizeof(last_seq), kCommitOffset);
+}
+
+bool FileBroker::Publish(std::vector<MetadataEvent>& batch) {
+    if (batch.empty()) {
+        return true;
+    }
+    FileLock lock(fd_, LOCK_EX);
+    uint64_t commit[2] = {}; // last_seq, end offset
+    struct stat st;
+    if (!lock.ok() || !PreadAll(fd_, commit, sizeof(commit), kCommitOffset) || fstat(fd_, &st) != 0) {
+        return false;
+    }
+    // Bytes past the committed end are from a publisher that died before
+    // committing; they are dropped and overwritten.
+    if (static_cast<uint64_t>(st.st_size) > commit[1] && ftruncate(fd_, static_cast<off_t>(commit[1])) != 0) {
+        return false;
+    }
+
+    std::string records;
+    for (auto& event : batch) {
+        event.seq = ++commit[0];
+        const size_t start = records.size();
+        records.append(4, '\0');
+        EncodeEvent(event, records);
+        const uint32_t len = static_cast<uint32_t>(records.size() - start - 4);
+        std::memcpy(&records[start], &len, 4);
+    }
+    // Records are durable before the commit record points at them, so after
+    // a crash readers see the whole batch or none of it.
+    const off_t offset = static_cast<off_t>(commit[1]);
+    commit[1] += records.size();
+    return PwriteAll(fd_, records.data(), records.size(), offset) && fdatasync(fd_) == 0 &&
+           PwriteAll(fd_, commit, sizeof(commit), kCommitOffset) && fdatasync(fd_) == 0;
+}
+
+bool FileBroker::Fetch(uint64_t after_seq, size_t max_events, std::vector<MetadataEvent>& out) {
+    out.clear();
+    std::lock_guard<std::mutex> guard(mu_);
+    FileLock lock(fd_, LOCK_SH);
+    uint64_t last_seq = 0;
+    if (!lock.ok() || !ReadLastSeq(last_seq)) {
+        return false;
+    }
+    if (after_seq < cursor_seq_) {
+        cursor_seq_ = 0;
+        cursor_offset_ = kHeaderBytes;
+    }
+
+    std::vector<uint8_t> payload;
+    while (cursor_seq_ < last_seq && out.size() < max_events) {
+        uint32_t len = 0;
+        if (!PreadAll(fd_, &len, sizeof(len), static_cast<off_t>(cursor_offset_))) {
+            return false;
+        }
+        payload.resize(len);
+        MetadataEvent event;
+        if (!PreadAll(fd_, payload.data(), len, static_cast<off_t>(cursor_offset_ + 4)) ||
+            !DecodeEvent(payload.data(), len, event)) {
+            return false;
+        }
+        cursor_seq_ = event.seq;
+        cursor_offset_ += 4 + len;
+        if (event.seq > after_seq) {
+            out.push_back(std::move(event));
+        }
+    }
+    return true;
+}
+
+MetadataBus::MetadataBus(std::shared_ptr<PrefixMap> map, std::shared_ptr<MetadataBroker> broker, Config cfg)
+    : map_(std::move(map)), broker_(std::move(broker)), cfg_(std::move(cfg)) {
+    if (!map_ || !broker_) {
+        throw std::invalid_argument("metadata bus needs a map and a broker");
+    }
+    if (cfg_.replica_id.empty() || cfg_.max_batch_events == 0) {
+        throw std::invalid_argument("metadata bus needs a replica_id and a positive batch size");
+    }
+    next_origin_seq_ = InitialOriginSeq();
+    listener_id_ = map_->AddMutationListener([this](const MetadataEvent& event, MutationScope scope) {
+        // Events applied from peers are already in the log, and local-only
+        // evictions/expiries are not for peers.
+        if (scope == MutationScope::kLocal) {
+            OnLocalMutation(event);
+        }
+    });
+    if (cfg_.interval.count() > 0) {
+        worker_ = std::thread([this] { Loop(); });
+    }
+}
+
+MetadataBus::~MetadataBus() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    map_->RemoveMutationListener(listener_id_);
+    Flush();
+}
+
+void MetadataBus::OnLocalMutation(const MetadataEvent& event) {
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        MetadataEvent copy = event;
+        copy.origin = cfg_.replica_id;
+        copy.origin_seq = ++next_origin_seq_;
+        applied_origin_seq_[cfg_.replica_id] = copy.origin_seq;
+        pending_.push_back(std::move(copy));
+        full = pending_.size() >= cfg_.max_batch_events;
+    }
+    if (full) {
+        Flush();
+    }
+}
+
+bool MetadataBus::Flush() {
+    std::lock_guard<std::mutex> flush_lock(flush_mu_);
+    std::vector<MetadataEvent> batch;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        batch.swap(pending_);
+    }
+    if (batch.empty()) {
+        return true;
+    }
+    if (!broker_->Publish(batch)) {
+        // Keep the order: the failed batch goes back in front.
+        std::lock_guard<std::mutex> lock(mu_);
+        batch.insert(batch.end(), std::make_move_iterator(pending_.begin()), std::make_move_iterator(pending_.end()));
+        pending_.swap(batch);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    stats_.published += batch.size();
+    stats_.batches++;
+    return true;
+}
+
+size_t MetadataBus::Poll() {
+    std::lock_guard<std::mutex> poll_lock(poll_mu_);
+    size_t applied = 0;
+    std::vector<MetadataEvent> events;
+    while (true) {
+        uint64_t after_seq = 0;
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            after_seq = stats_.applied_seq;
+        }
+        if (!broker_->Fetch(after_seq, cfg_.max_batch_events, events) || events.empty()) {
+            break;
+        }
+        for (const auto& event : events) {
+            bool apply = false;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                uint64_t& seen = applied_origin_seq_[event.origin];
+                apply = event.origin_seq > seen;
+                if (apply) {
+                    seen = event.origin_seq;
+                    stats_.applied++;
+                } else {
+                    stats_.duplicates++;
+                }
+                stats_.applied_seq = event.seq;
+            }
+            if (apply) {
+                map_->ApplyEvent(event);
+                applied++;
+            }
+        }
+    }
+    return applied;
+}
+
+MetadataBus::Stats MetadataBus::GetStats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    Stats stats = stats_;
+    stats.pending = pending_.size();
+    return stats;
+}
+
+void MetadataBus::Loop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (!stop_) {
+        stop_cv_.wait_for(lock, cfg_.interval, [this] { return stop_; });
+        if (stop_) {
+            break;
+        }
+        lock.unlock();
+        Flush();
+        Poll();
+        lock.lock();
+    }
+}
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "cache.h"
+#include "metadata_event.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Transport for replicated PrefixMap events: an ordered log in which the
+// broker assigns each published event the next sequence number.
+class MetadataBroker {
+public:
+    virtual ~MetadataBroker() = default;
+    // Appends the batch atomically and sets each event's seq.
+    virtual bool Publish(std::vector<MetadataEvent>& batch) = 0;
+    // Up to max_events events with seq > after_seq, in seq order.
+    virtual bool Fetch(uint64_t after_seq, size_t max_events, std::vector<MetadataEvent>& out) = 0;
+};
+
+// Local stand-in for etcd: a shared append-only log file. Replicas on one
+// machine open the same path; publishers serialize with flock. A batch is
+// fsynced before the header's commit record (last seq, end offset) covers it.
+class FileBroker final : public MetadataBroker {
+public:
+    explicit FileBroker(const std::string& path);
+    ~FileBroker() override;
+
+    FileBroker(const FileBroker&) = delete;
+    FileBroker& operator=(const FileBroker&) = delete;
+
+    bool Publish(std::vector<MetadataEvent>& batch) override;
+    bool Fetch(uint64_t after_seq, size_t max_events, std::vector<MetadataEvent>& out) override;
+
+private:
+    bool ReadLastSeq(uint64_t& last_seq) const;
+
+    int fd_ = -1;
+    std::mutex mu_;
+    // Read cursor: offset of the record after cursor_seq_.
+    uint64_t cursor_seq_ = 0;
+    uint64_t cursor_offset_ = 0;
+};
+
+// Replicates a PrefixMap through a broker. Local advertise/tombstone events
+// are batched and published; Poll applies peers' events in log order,
+// skipping any (origin, origin_seq) already applied.
+class MetadataBus {
+public:
+    struct Config {
+        std::string replica_id;
+        size_t max_batch_events = 256;
+        std::chrono::milliseconds interval{0}; // 0 = caller drives Flush/Poll
+    };
+
+    struct Stats {
+        uint64_t published = 0;
+        uint64_t batches = 0;
+        uint64_t applied = 0;
+        uint64_t duplicates = 0;
+        uint64_t applied_seq = 0;
+        size_t pending = 0;
+    };
+
+    // Registers itself as a mutation listener on the map.
+    MetadataBus(std::shared_ptr<PrefixMap> map, std::shared_ptr<MetadataBroker> broker, Config cfg);
+    ~MetadataBus();
+
+    MetadataBus(const MetadataBus&) = delete;
+    MetadataBus& operator=(const MetadataBus&) = delete;
+
+    // Publishes pending local events as one batch.
+    bool Flush();
+    // Fetches and applies every peer event past the applied sequence.
+    size_t Poll();
+
+    Stats GetStats() const;
+
+private:
+    void OnLocalMutation(const MetadataEvent& event);
+    void Loop();
+
+    std::shared_ptr<PrefixMap> map_;
+    std::shared_ptr<MetadataBroker> broker_;
+    Config cfg_;
+    int listener_id_ = 0;
+
+    mutable std::mutex mu_;
+    std::vector<MetadataEvent> pending_;
+    uint64_t next_origin_seq_ = 0;
+    // Highest origin_seq applied per origin, including our own.
+    std::unordered_map<std::string, uint64_t> applied_origin_seq_;
+    Stats stats_;
+
+    std::mutex flush_mu_;
+    std::mutex poll_mu_;
+
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+    std::thread worker_;
+};
+
+} // namespace prompt_cache_poc
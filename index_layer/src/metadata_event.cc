@@ -0,0 +1,130 @@
+#include "metadata_event.h"
+
+#include <cstring>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+template <typename T>
+void Put(std::string& out, T v) {
+    char buf[sizeof(T)];
+    std::memcpy(buf, &v, sizeof(T));
+    out.append(buf, sizeof(T));
+}
+
+void PutString(std::string& out, const std::string& s) {
+    Put<uint32_t>(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t len) : p_(data), end_(data + len) {}
+
+    template <typename T>
+    bool Get(T& v) {
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+
+    bool GetString(std::string& s) {
+        uint32_t n = 0;
+        if (!Get(n) || static_cast<size_t>(end_ - p_) < n) {
+            return false;
+        }
+        s.assign(reinterpret_cast<const char*>(p_), n);
+        p_ += n;
+        return true;
+    }
+
+    bool Done() const { return p_ == end_; }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+};
+
+} // namespace
+
+void EncodeEvent(const MetadataEvent& event, std::string& out) {
+    Put<uint8_t>(out, static_cast<uint8_t>(event.type));
+    Put<uint64_t>(out, event.seq);
+    PutString(out, event.origin);
+    Put<uint64_t>(out, event.origin_seq);
+    PutString(out, event.obj_id);
+    if (event.type != MetadataEvent::Type::kAdvertise) {
+        return;
+    }
+    Put<int32_t>(out, event.total_bytes);
+    Put<uint8_t>(out, static_cast<uint8_t>(event.layout.order));
+    Put<int32_t>(out, event.layout.num_tokens);
+    Put<uint32_t>(out, static_cast<uint32_t>(event.layout.buffer_bytes_per_token.size()));
+    for (int bpt : event.layout.buffer_bytes_per_token) {
+        Put<int32_t>(out, bpt);
+    }
+    PutString(out, event.owner_id);
+    Put<int32_t>(out, event.priority);
+    Put<uint32_t>(out, static_cast<uint32_t>(event.prefixes.size()));
+    for (const auto& p : event.prefixes) {
+        Put<uint64_t>(out, p.hash);
+        Put<uint64_t>(out, p.fingerprint);
+        Put<int32_t>(out, p.prefix_tokens);
+        Put<int32_t>(out, p.usable_len_bytes);
+        Put<uint64_t>(out, p.parent_hash);
+    }
+}
+
+bool DecodeEvent(const uint8_t* data, size_t len, MetadataEvent& event) {
+    Reader r(data, len);
+    uint8_t type = 0;
+    if (!r.Get(type) || !r.Get(event.seq) || !r.GetString(event.origin) ||
+        !r.Get(event.origin_seq) || !r.GetString(event.obj_id)) {
+        return false;
+    }
+    event.layout = ObjectLayout{};
+    event.owner_id.clear();
+    event.prefixes.clear();
+    event.total_bytes = 0;
+    event.priority = 0;
+    if (type == static_cast<uint8_t>(MetadataEvent::Type::kTombstone)) {
+        event.type = MetadataEvent::Type::kTombstone;
+        return r.Done();
+    }
+    if (type != static_cast<uint8_t>(MetadataEvent::Type::kAdvertise)) {
+        return false;
+    }
+    event.type = MetadataEvent::Type::kAdvertise;
+
+    uint8_t order = 0;
+    uint32_t buffers = 0;
+    if (!r.Get(event.total_bytes) || !r.Get(order) || !r.Get(event.layout.num_tokens) || !r.Get(buffers) ||
+        order > static_cast<uint8_t>(ObjectLayout::Order::kBufferMajor) || buffers > len) {
+        return false;
+    }
+    event.layout.order = static_cast<ObjectLayout::Order>(order);
+    event.layout.buffer_bytes_per_token.resize(buffers);
+    for (auto& bpt : event.layout.buffer_bytes_per_token) {
+        if (!r.Get(bpt)) {
+            return false;
+        }
+    }
+    uint32_t prefixes = 0;
+    if (!r.GetString(event.owner_id) || !r.Get(event.priority) || !r.Get(prefixes) || prefixes > len) {
+        return false;
+    }
+    event.prefixes.resize(prefixes);
+    for (auto& p : event.prefixes) {
+        if (!r.Get(p.hash) || !r.Get(p.fingerprint) || !r.Get(p.prefix_tokens) || !r.Get(p.usable_len_bytes) ||
+            !r.Get(p.parent_hash)) {
+            return false;
+        }
+    }
+    return r.Done();
+}
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "kv_layout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// One prefix of an advertised object, already hashed so peers do not need
+// the prompt tokens.
+struct PrefixRecord {
+    uint64_t hash = 0;
+    uint64_t fingerprint = 0;
+    int prefix_tokens = 0;
+    int usable_len_bytes = 0;
+    // Hash of the object's previous recorded prefix (0 for the first), so a
+    // continuation can check it extends the chain it already matched.
+    uint64_t parent_hash = 0;
+};
+
+// PrefixMap mutation shipped between replicas (and to the journal).
+struct MetadataEvent {
+    enum class Type : uint8_t { kAdvertise = 1, kTombstone = 2 };
+
+    Type type = Type::kAdvertise;
+    uint64_t seq = 0;        // position in the shared log, set by the broker
+    std::string origin;      // replica that produced the event
+    uint64_t origin_seq = 0; // per-origin counter, used to apply idempotently
+    std::string obj_id;
+
+    // kAdvertise only.
+    int total_bytes = 0;
+    ObjectLayout layout;
+    std::string owner_id;
+    int priority = 0;
+    std::vector<PrefixRecord> prefixes;
+};
+
+// Compact little-endian binary encoding. EncodeEvent appends to out;
+// DecodeEvent returns false on truncated or malformed input.
+void EncodeEvent(const MetadataEvent& event, std::string& out);
+bool DecodeEvent(const uint8_t* data, size_t len, MetadataEvent& event);
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,485 @@
+#include "metadata_journal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+constexpr uint32_t kSnapshotMagic = 0x534d4350; // "PCMS"
+constexpr uint32_t kSnapshotVersion = 2;
+constexpr size_t kRecordHeaderBytes = 8;
+constexpr size_t kSnapshotHeaderBytes = 24;
+constexpr uint64_t kIndexStrideBytes = 64u << 10;
+constexpr size_t kReadBlockBytes = 64u << 10;
+constexpr char kSegmentPrefix[] = "journal.";
+
+uint32_t Checksum(const char* data, size_t len) {
+    uint32_t h = 0x811c9dc5u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 0x01000193u;
+    }
+    return h;
+}
+
+void AppendRecord(const MetadataEvent& event, std::string& out) {
+    const size_t start = out.size();
+    out.append(kRecordHeaderBytes, '\0');
+    EncodeEvent(event, out);
+    const uint32_t len = static_cast<uint32_t>(out.size() - start - kRecordHeaderBytes);
+    const uint32_t sum = Checksum(out.data() + start + kRecordHeaderBytes, len);
+    std::memcpy(&out[start], &len, 4);
+    std::memcpy(&out[start + 4], &sum, 4);
+}
+
+// Parses records from buf[offset..); stops at the first torn or corrupt
+// record and returns the offset just past the last good one. offsets, if
+// given, gets the start of each parsed record.
+size_t ParseRecords(const std::string& buf,
+                    size_t offset,
+                    std::vector<MetadataEvent>& out,
+                    std::vector<size_t>* offsets = nullptr) {
+    while (buf.size() - offset >= kRecordHeaderBytes) {
+        uint32_t len = 0;
+        uint32_t sum = 0;
+        std::memcpy(&len, buf.data() + offset, 4);
+        std::memcpy(&sum, buf.data() + offset + 4, 4);
+        if (buf.size() - offset - kRecordHeaderBytes < len) {
+            break;
+        }
+        const char* payload = buf.data() + offset + kRecordHeaderBytes;
+        MetadataEvent event;
+        if (Checksum(payload, len) != sum ||
+            !DecodeEvent(reinterpret_cast<const uint8_t*>(payload), len, event)) {
+            break;
+        }
+        out.push_back(std::move(event));
+        if (offsets) {
+            offsets->push_back(offset);
+        }
+        offset += kRecordHeaderBytes + len;
+    }
+    return offset;
+}
+
+bool ReadFile(const std::string& path, std::string& out) {
+    out.clear();
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[1 << 16];
+    while (true) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close(fd);
+            return n == 0;
+        }
+        out.append(buf, static_cast<size_t>(n));
+    }
+}
+
+bool WriteAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool PreadAll(int fd, char* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        const ssize_t n = pread(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// Ids of the journal.<id> files in dir, ascending.
+std::vector<uint64_t> ListSegments(const std::string& dir) {
+    std::vector<uint64_t> ids;
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return ids;
+    }
+    const size_t prefix_len = sizeof(kSegmentPrefix) - 1;
+    while (const dirent* entry = readdir(d)) {
+        const std::string name = entry->d_name;
+        if (name.size() <= prefix_len || name.compare(0, prefix_len, kSegmentPrefix) != 0 ||
+            name.find_first_not_of("0123456789", prefix_len) != std::string::npos) {
+            continue;
+        }
+        ids.push_back(std::stoull(name.substr(prefix_len)));
+    }
+    closedir(d);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool SyncDir(const std::string& dir) {
+    const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+} // namespace
+
+MetadataJournal::MetadataJournal(std::shared_ptr<PrefixMap> map, Config cfg)
+    : map_(std::move(map)), cfg_(std::move(cfg)) {
+    if (!map_ || cfg_.dir.empty()) {
+        throw std::invalid_argument("metadata journal needs a map and a directory");
+    }
+    if (mkdir(cfg_.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("cannot create journal directory: " + cfg_.dir);
+    }
+    snapshot_path_ = cfg_.dir + "/snapshot";
+
+    Replay();
+
+    const std::string path = SegmentPath(segments_.back().id);
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0 || !SyncDir(cfg_.dir)) {
+        throw std::runtime_error("cannot open journal: " + path);
+    }
+    listener_id_ = map_->AddMutationListener([this](const MetadataEvent& event, MutationScope scope) {
+        // Local evictions/expiries are this process's own budget, not shared
+        // history; after a restart the budget is enforced again.
+        if (scope != MutationScope::kLocalOnly) {
+            Append(event);
+        }
+    });
+}
+
+MetadataJournal::~MetadataJournal() {
+    map_->RemoveMutationListener(listener_id_);
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void MetadataJournal::Replay() {
+    std::string buf;
+    std::vector<MetadataEvent> events;
+    if (ReadFile(snapshot_path_, buf) && buf.size() >= kSnapshotHeaderBytes) {
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint64_t count = 0;
+        std::memcpy(&magic, buf.data(), 4);
+        std::memcpy(&version, buf.data() + 4, 4);
+        std::memcpy(&stats_.base_seq, buf.data() + 8, 8);
+        std::memcpy(&count, buf.data() + 16, 8);
+        if (magic != kSnapshotMagic || version != kSnapshotVersion) {
+            throw std::runtime_error("not a metadata snapshot: " + snapshot_path_);
+        }
+        ParseRecords(buf, kSnapshotHeaderBytes, events);
+        if (events.size() != count) {
+            throw std::runtime_error("truncated metadata snapshot: " + snapshot_path_);
+        }
+    }
+    stats_.last_seq = stats_.base_seq;
+    for (const auto& event : events) {
+        map_->ApplyEvent(event);
+        stats_.replayed++;
+    }
+
+    // Only the newest segment takes appends, so only it can have a torn tail;
+    // records already folded into the snapshot (crash before the old segments
+    // were deleted) are skipped.
+    for (uint64_t id : ListSegments(cfg_.dir)) {
+        const std::string path = SegmentPath(id);
+        events.clear();
+        std::vector<size_t> offsets;
+        size_t good_bytes = 0;
+        if (ReadFile(path, buf)) {
+            good_bytes = ParseRecords(buf, 0, events, &offsets);
+            if (good_bytes < buf.size() && truncate(path.c_str(), static_cast<off_t>(good_bytes)) != 0) {
+                throw std::runtime_error("cannot truncate torn journal: " + path);
+            }
+        }
+        segments_.push_back({id, good_bytes});
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (events[i].seq <= stats_.last_seq) {
+                continue;
+            }
+            stats_.last_seq = events[i].seq;
+            IndexLocked(events[i].seq, offsets[i]);
+            map_->ApplyEvent(events[i]);
+            stats_.replayed++;
+        }
+    }
+    if (segments_.empty()) {
+        segments_.push_back({1, 0});
+    }
+    stats_.segment = segments_.back().id;
+    stats_.journal_bytes = segments_.back().bytes;
+    durable_seq_ = stats_.last_seq;
+}
+
+std::string MetadataJournal::SegmentPath(uint64_t id) const {
+    return cfg_.dir + "/" + kSegmentPrefix + std::to_string(id);
+}
+
+void MetadataJournal::IndexLocked(uint64_t seq, uint64_t offset) {
+    const uint64_t segment = segments_.back().id;
+    if (!index_.empty() && index_.back().segment == segment && offset - index_.back().offset < kIndexStrideBytes) {
+        return;
+    }
+    index_.push_back({seq, segment, offset});
+}
+
+bool MetadataJournal::Append(const MetadataEvent& event) {
+    std::unique_lock<std::mutex> lock(mu_);
+    if (failed_) {
+        return false;
+    }
+    MetadataEvent record = event;
+    record.seq = ++stats_.last_seq;
+    AppendRecord(record, pending_);
+    stats_.appended++;
+
+    while (durable_seq_ < record.seq) {
+        if (failed_) {
+            return false;
+        }
+        if (committing_) {
+            commit_cv_.wait(lock);
+            continue;
+        }
+        if (!CommitLocked(lock)) {
+            return false;
+        }
+    }
+
+    const bool compact = cfg_.compact_bytes > 0 && stats_.journal_bytes >= cfg_.compact_bytes && !compacting_;
+    lock.unlock();
+    if (compact) {
+        Compact();
+    }
+    return true;
+}
+
+bool MetadataJournal::CommitLocked(std::unique_lock<std::mutex>& lock) {
+    // Leader: take everything queued so far and write it with one syscall
+    // (plus one fdatasync); appenders that arrive meanwhile form the next group.
+    committing_ = true;
+    std::string batch;
+    batch.swap(pending_);
+    const uint64_t first_seq = durable_seq_ + 1;
+    const uint64_t batch_seq = stats_.last_seq;
+    const int fd = fd_;
+    lock.unlock();
+    const bool ok = WriteAll(fd, batch.data(), batch.size()) && (!cfg_.sync || fdatasync(fd) == 0);
+    lock.lock();
+    committing_ = false;
+    if (!ok) {
+        failed_ = true;
+    } else {
+        IndexLocked(first_seq, segments_.back().bytes);
+        segments_.back().bytes += batch.size();
+        durable_seq_ = batch_seq;
+        stats_.journal_bytes += batch.size();
+        stats_.commits++;
+    }
+    commit_cv_.notify_all();
+    return ok;
+}
+
+bool MetadataJournal::Compact() {
+    uint64_t next_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (compacting_ || failed_) {
+            return false;
+        }
+        compacting_ = true;
+        next_id = segments_.back().id + 1;
+    }
+    auto abort = [this](int fd) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        compacting_ = false;
+        return false;
+    };
+
+    // The next segment is durable before anything is committed to it.
+    const int next_fd = open(SegmentPath(next_id).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (next_fd < 0 || !SyncDir(cfg_.dir)) {
+        return abort(next_fd);
+    }
+
+    // Under the lock only long enough to drain queued records into the old
+    // segment and switch appends to the new one.
+    uint64_t base_seq = 0;
+    int old_fd = -1;
+    {
+        std::unique_lock<std::mutex> lock(mu_);
+        while (committing_ || !pending_.empty()) {
+            if (committing_) {
+                commit_cv_.wait(lock);
+            } else if (!CommitLocked(lock)) {
+                lock.unlock();
+                return abort(next_fd);
+            }
+        }
+        base_seq = stats_.last_seq;
+        old_fd = fd_;
+        fd_ = next_fd;
+        segments_.push_back({next_id, 0});
+        stats_.segment = next_id;
+        stats_.journal_bytes = 0;
+    }
+    close(old_fd);
+
+    // Events are applied to the map before they are appended, so the
+    // snapshot covers everything up to base_seq. Later events may land in
+    // both the snapshot and the new segment; replaying them twice is harmless.
+    const std::vector<MetadataEvent> events = map_->SnapshotEvents();
+    std::string buf(kSnapshotHeaderBytes, '\0');
+    const uint64_t count = events.size();
+    std::memcpy(&buf[0], &kSnapshotMagic, 4);
+    std::memcpy(&buf[4], &kSnapshotVersion, 4);
+    std::memcpy(&buf[8], &base_seq, 8);
+    std::memcpy(&buf[16], &count, 8);
+    for (const auto& event : events) {
+        AppendRecord(event, buf);
+    }
+
+    const std::string tmp_path = snapshot_path_ + ".tmp";
+    const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 && WriteAll(fd, buf.data(), buf.size()) && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    ok = ok && rename(tmp_path.c_str(), snapshot_path_.c_str()) == 0 && SyncDir(cfg_.dir);
+
+    // On failure the old segments stay and replay still covers everything.
+    std::vector<uint64_t> obsolete;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (ok) {
+            stats_.base_seq = base_seq;
+            stats_.compactions++;
+            while (segments_.front().id < next_id) {
+                obsolete.push_back(segments_.front().id);
+                segments_.erase(segments_.begin());
+            }
+            index_.erase(std::remove_if(index_.begin(), index_.end(),
+                                        [next_id](const IndexEntry& e) { return e.segment < next_id; }),
+                         index_.end());
+        }
+        compacting_ = false;
+    }
+    for (uint64_t id : obsolete) {
+        unlink(SegmentPath(id).c_str());
+    }
+    return ok;
+}
+
+bool MetadataJournal::ReadSince(uint64_t after_seq, size_t max_events, std::vector<MetadataEvent>& out) const {
+    out.clear();
+    uint64_t durable = 0;
+    IndexEntry start;
+    std::vector<Segment> segments;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (after_seq < stats_.base_seq) {
+            return false;
+        }
+        durable = durable_seq_;
+        if (after_seq >= durable || index_.empty() || max_events == 0) {
+            return true;
+        }
+        // Last indexed group that starts at or before after_seq + 1.
+        auto it = std::upper_bound(index_.begin(), index_.end(), after_seq + 1,
+                                   [](uint64_t seq, const IndexEntry& e) { return seq < e.seq; });
+        start = it == index_.begin() ? *it : *std::prev(it);
+        segments = segments_;
+    }
+
+    std::string buf;
+    std::vector<MetadataEvent> events;
+    for (const auto& segment : segments) {
+        if (segment.id < start.segment) {
+            continue;
+        }
+        // A segment deleted by a compaction since means the events are in the
+        // snapshot now.
+        const int fd = open(SegmentPath(segment.id).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        uint64_t offset = segment.id == start.segment ? start.offset : 0;
+        size_t block = kReadBlockBytes;
+        bool ok = true;
+        while (ok && offset < segment.bytes && out.size() < max_events) {
+            const size_t want = static_cast<size_t>(std::min<uint64_t>(segment.bytes - offset, block));
+            buf.resize(want);
+            events.clear();
+            ok = PreadAll(fd, buf.data(), want, offset);
+            const size_t used = ok ? ParseRecords(buf, 0, events) : 0;
+            if (ok && used == 0) {
+                // A record larger than the block, or a corrupt one.
+                ok = want < segment.bytes - offset;
+                block *= 2;
+                continue;
+            }
+            for (auto& event : events) {
+                if (event.seq > durable || out.size() >= max_events) {
+                    break;
+                }
+                if (event.seq > after_seq) {
+                    out.push_back(std::move(event));
+                }
+            }
+            offset += used;
+        }
+        close(fd);
+        if (!ok) {
+            return false;
+        }
+        if (out.size() >= max_events) {
+            break;
+        }
+    }
+    return true;
+}
+
+MetadataJournal::Stats MetadataJournal::GetStats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return stats_;
+}
+
+} // namespace prompt_cache_poc
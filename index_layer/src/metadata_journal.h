@@ -0,0 +1,101 @@
+#pragma once
+
+#include "cache.h"
+#include "metadata_event.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Append-only binary journal of PrefixMap mutations with snapshot compaction.
+//
+// On construction the snapshot and the journal segments in cfg.dir are
+// replayed into the map; afterwards every advertise/tombstone (local or
+// replicated) is appended. Appends use O_APPEND and group commit: concurrent
+// appenders share one write + fdatasync, and each returns once its record is
+// durable. When the journal grows past compact_bytes, appends switch to a new
+// segment and the map is written to a new snapshot without holding the
+// journal lock; the older segments are then deleted.
+//
+// Files: <dir>/snapshot and <dir>/journal.<segment>, each a sequence of
+// [u32 len][u32 checksum][event] records (the snapshot after a header).
+class MetadataJournal {
+public:
+    struct Config {
+        std::string dir;
+        bool sync = true;                       // fdatasync each group commit
+        uint64_t compact_bytes = 64ull << 20;   // 0 = only on Compact()
+    };
+
+    struct Stats {
+        uint64_t replayed = 0;
+        uint64_t appended = 0;
+        uint64_t commits = 0;
+        uint64_t compactions = 0;
+        uint64_t journal_bytes = 0;
+        uint64_t base_seq = 0; // last seq folded into the snapshot
+        uint64_t last_seq = 0;
+        uint64_t segment = 0;  // journal.<segment> takes appends
+    };
+
+    MetadataJournal(std::shared_ptr<PrefixMap> map, Config cfg);
+    ~MetadataJournal();
+
+    MetadataJournal(const MetadataJournal&) = delete;
+    MetadataJournal& operator=(const MetadataJournal&) = delete;
+
+    // Blocks until the event is durable. Called by the map listener.
+    bool Append(const MetadataEvent& event);
+
+    // Starts a new segment, snapshots the map and deletes older segments.
+    bool Compact();
+
+    // Replication feed: journaled events with seq > after_seq. Returns false
+    // if those events were already compacted into the snapshot. Reads start
+    // from an in-memory offset index rather than the top of the journal.
+    bool ReadSince(uint64_t after_seq, size_t max_events, std::vector<MetadataEvent>& out) const;
+
+    Stats GetStats() const;
+
+private:
+    // First seq of a commit group and where its records start. Groups are
+    // indexed at most every kIndexStrideBytes, so a read scans little.
+    struct IndexEntry {
+        uint64_t seq = 0;
+        uint64_t segment = 0;
+        uint64_t offset = 0;
+    };
+    struct Segment {
+        uint64_t id = 0;
+        uint64_t bytes = 0; // durable length
+    };
+
+    void Replay();
+    bool CommitLocked(std::unique_lock<std::mutex>& lock);
+    void IndexLocked(uint64_t seq, uint64_t offset);
+    std::string SegmentPath(uint64_t id) const;
+
+    std::shared_ptr<PrefixMap> map_;
+    Config cfg_;
+    std::string snapshot_path_;
+    int fd_ = -1;
+    int listener_id_ = 0;
+
+    mutable std::mutex mu_;
+    std::condition_variable commit_cv_;
+    std::vector<Segment> segments_; // live segments, oldest first
+    std::vector<IndexEntry> index_;
+    std::string pending_;
+    uint64_t durable_seq_ = 0;
+    bool committing_ = false;
+    bool compacting_ = false;
+    bool failed_ = false;
+    Stats stats_;
+};
+
+} // namespace prompt_cache_poc
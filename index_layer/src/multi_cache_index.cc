@@ -0,0 +1,64 @@
+#include "multi_cache_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace prompt_cache_poc {
+
+void MultiCacheIndex::AddCache(int cache_id, std::shared_ptr<PrefixMap> cache) {
+    if (!cache) {
+        throw std::invalid_argument("cache must not be null");
+    }
+    caches_[cache_id] = std::move(cache);
+}
+
+std::shared_ptr<PrefixMap> MultiCacheIndex::GetCache(int cache_id) const {
+    auto it = caches_.find(cache_id);
+    return it == caches_.end() ? nullptr : it->second;
+}
+
+size_t MultiCacheIndex::CacheCount() const {
+    return caches_.size();
+}
+
+MultiLookupResult MultiCacheIndex::Lookup(const std::vector<std::string>& tokens, int max_len_tokens) const {
+    MultiLookupResult res;
+    if (caches_.empty() || tokens.empty()) {
+        return res;
+    }
+    if (max_len_tokens <= 0 || max_len_tokens > static_cast<int>(tokens.size())) {
+        max_len_tokens = static_cast<int>(tokens.size());
+    }
+
+    std::map<int, std::vector<int>> lengths_by_cache;
+    std::vector<int> all_lengths;
+    for (const auto& [id, cache] : caches_) {
+        auto lengths = cache->PrefixLengths(max_len_tokens);
+        all_lengths.insert(all_lengths.end(), lengths.begin(), lengths.end());
+        lengths_by_cache[id] = std::move(lengths);
+    }
+    std::sort(all_lengths.begin(), all_lengths.end());
+    all_lengths.erase(std::unique(all_lengths.begin(), all_lengths.end()), all_lengths.end());
+
+    const PrefixHashes prefixes = HashPrefixes(tokens, all_lengths);
+
+    // Each cache's hits are prefix-closed, so a length is jointly usable iff
+    // every cache records it and it is within every cache's hit.
+    std::vector<int> joint = all_lengths;
+    for (const auto& [id, cache] : caches_) {
+        LookupResult hit = cache->LookupHashed(prefixes, max_len_tokens);
+        const auto& lengths = lengths_by_cache[id];
+        std::vector<int> usable;
+        for (int len : joint) {
+            if (len <= hit.prefix_tokens && std::binary_search(lengths.begin(), lengths.end(), len)) {
+                usable.push_back(len);
+            }
+        }
+        joint.swap(usable);
+        res.per_cache[id] = std::move(hit);
+    }
+    res.joint_prefix_tokens = joint.empty() ? 0 : joint.back();
+    return res;
+}
+
+} // namespace prompt_cache_poc
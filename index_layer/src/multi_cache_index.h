@@ -0,0 +1,33 @@
+#pragma once
+
+#include "cache.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+struct MultiLookupResult {
+    std::map<int, LookupResult> per_cache;
+    // Longest prefix recorded and hit in every cache (0 if any cache misses).
+    int joint_prefix_tokens = 0;
+};
+
+// Per-model PrefixMaps (e.g. target and draft) looked up with one token hash
+// pass: prefix hashes are computed once over the union of the caches' prefix
+// lengths and fed to every table.
+class MultiCacheIndex {
+public:
+    void AddCache(int cache_id, std::shared_ptr<PrefixMap> cache);
+    std::shared_ptr<PrefixMap> GetCache(int cache_id) const;
+    size_t CacheCount() const;
+
+    MultiLookupResult Lookup(const std::vector<std::string>& tokens, int max_len_tokens = 0) const;
+
+private:
+    std::map<int, std::shared_ptr<PrefixMap>> caches_;
+};
+
+} // namespace prompt_cache_poc
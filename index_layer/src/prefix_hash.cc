@@ -0,0 +1,91 @@
+#include "prefix_hash.h"
+
+#include <algorithm>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+constexpr uint64_t kFpMultiplier = 0x9e3779b97f4a7c15ULL;
+constexpr uint8_t kTokenSeparator = 0x1f;
+
+inline uint64_t FpStep(uint64_t h, uint8_t c) {
+    h = (h ^ c) * kFpMultiplier;
+    return h ^ (h >> 29);
+}
+
+} // namespace
+
+void TokenHasher::Update(const std::string& token) {
+    uint64_t h = state_;
+    uint64_t fp = fp_state_;
+    if (count_ > 0) {
+        h ^= kTokenSeparator;
+        h *= kFnvPrime;
+    }
+    // The fingerprint stream length-prefixes each token instead of using the
+    // separator, so token sequences that join to the same bytes still differ.
+    const uint32_t len = static_cast<uint32_t>(token.size());
+    for (int shift = 0; shift < 32; shift += 8) {
+        fp = FpStep(fp, static_cast<uint8_t>(len >> shift));
+    }
+    for (unsigned char c : token) {
+        h ^= c;
+        h *= kFnvPrime;
+        fp = FpStep(fp, c);
+    }
+    state_ = h;
+    fp_state_ = fp;
+    count_++;
+}
+
+uint64_t TokenHasher::Value() const {
+    return state_;
+}
+
+uint64_t TokenHasher::Fingerprint() const {
+    uint64_t h = fp_state_ ^ (static_cast<uint64_t>(count_) * kFpMultiplier);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+size_t TokenHasher::Count() const {
+    return count_;
+}
+
+int PrefixHashes::IndexOf(int length) const {
+    auto it = std::lower_bound(lengths.begin(), lengths.end(), length);
+    if (it == lengths.end() || *it != length) {
+        return -1;
+    }
+    return static_cast<int>(it - lengths.begin());
+}
+
+PrefixHashes HashPrefixes(const std::vector<std::string>& tokens, const std::vector<int>& lengths) {
+    PrefixHashes out;
+    out.lengths.reserve(lengths.size());
+    out.hashes.reserve(lengths.size());
+    out.fingerprints.reserve(lengths.size());
+
+    TokenHasher hasher;
+    for (int len : lengths) {
+        if (len <= 0 || len > static_cast<int>(tokens.size())) {
+            continue;
+        }
+        if (!out.lengths.empty() && len <= out.lengths.back()) {
+            continue;
+        }
+        while (hasher.Count() < static_cast<size_t>(len)) {
+            hasher.Update(tokens[hasher.Count()]);
+        }
+        out.lengths.push_back(len);
+        out.hashes.push_back(hasher.Value());
+        out.fingerprints.push_back(hasher.Fingerprint());
+    }
+    return out;
+}
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Streaming FNV-1a over the token sequence (tokens joined by 0x1f). Feeding
+// tokens one at a time yields the hash of every prefix in a single pass, and
+// the value does not depend on the standard library implementation.
+//
+// The same byte loop also runs an independent multiply-xorshift hash that is
+// used as a fingerprint to verify entries found by Value(). Its stream
+// length-prefixes every token rather than joining them, so two token
+// sequences whose joined bytes collide in Value() do not collide here.
+class TokenHasher {
+public:
+    void Update(const std::string& token);
+    uint64_t Value() const;
+    uint64_t Fingerprint() const;
+    size_t Count() const;
+
+private:
+    uint64_t state_ = 0xcbf29ce484222325ULL;
+    uint64_t fp_state_ = 0x6a09e667f3bcc908ULL;
+    size_t count_ = 0;
+};
+
+// Hashes of a prompt at a set of prefix lengths (ascending).
+struct PrefixHashes {
+    std::vector<int> lengths;
+    std::vector<uint64_t> hashes;
+    std::vector<uint64_t> fingerprints;
+
+    // Index of length in lengths, or -1.
+    int IndexOf(int length) const;
+};
+
+// One pass over tokens, snapshotting the hash at each requested length.
+PrefixHashes HashPrefixes(const std::vector<std::string>& tokens, const std::vector<int>& lengths);
+
+} // namespace prompt_cache_poc
@@ -1,8 +1,10 @@
 #include "s3_storage.h"
 
 #include <algorithm>
+#include <cctype>
 #include <cstring>
 #include <mutex>
+#include <string_view>
 
 #include <curl/curl.h>
 
@@ -28,6 +30,97 @@ std::string TrimTrailingSlash(const std::string& s) {
     return s;
 }
 
+bool StartsWithNoCase(std::string_view s, std::string_view prefix) {
+    if (s.size() < prefix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(s[i])) != std::tolower(static_cast<unsigned char>(prefix[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string_view TrimWs(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// Parses "bytes <start>-<end>/<size>".
+bool ParseContentRange(std::string_view value, int64_t* start, int64_t* end) {
+    value = TrimWs(value);
+    if (!StartsWithNoCase(value, "bytes ")) {
+        return false;
+    }
+    value.remove_prefix(6);
+    size_t dash = value.find('-');
+    size_t slash = value.find('/');
+    if (dash == std::string_view::npos || dash == 0 || slash == std::string_view::npos || slash < dash) {
+        return false;
+    }
+    try {
+        *start = std::stoll(std::string(value.substr(0, dash)));
+        *end = std::stoll(std::string(value.substr(dash + 1, slash - dash - 1)));
+    } catch (...) {
+        return false;
+    }
+    return *end >= *start;
+}
+
+struct Part {
+    int64_t start = 0;
+    std::string_view bytes;
+};
+
+// Splits a multipart/byteranges body into its parts.
+bool ParseByteRanges(std::string_view body, std::string_view boundary, std::vector<Part>& parts) {
+    const std::string delim = "--" + std::string(boundary);
+    size_t pos = body.find(delim);
+    while (pos != std::string_view::npos) {
+        pos += delim.size();
+        if (body.substr(pos, 2) == "--") {
+            return true;
+        }
+        size_t headers_end = body.find("\r\n\r\n", pos);
+        if (headers_end == std::string_view::npos) {
+            return false;
+        }
+        Part part;
+        int64_t end = -1;
+        bool have_range = false;
+        std::string_view headers = body.substr(pos, headers_end - pos);
+        while (!headers.empty()) {
+            size_t eol = headers.find("\r\n");
+            std::string_view line = headers.substr(0, eol);
+            if (StartsWithNoCase(line, "content-range:")) {
+                have_range = ParseContentRange(line.substr(14), &part.start, &end);
+            }
+            if (eol == std::string_view::npos) {
+                break;
+            }
+            headers.remove_prefix(eol + 2);
+        }
+        if (!have_range) {
+            return false;
+        }
+        const size_t data_begin = headers_end + 4;
+        const size_t data_len = static_cast<size_t>(end - part.start + 1);
+        if (data_begin + data_len > body.size()) {
+            return false;
+        }
+        part.bytes = body.substr(data_begin, data_len);
+        parts.push_back(part);
+        pos = body.find(delim, data_begin + data_len);
+    }
+    return !parts.empty();
+}
+
 CURL* ThreadCurlHandle() {
     static thread_local CURL* curl = [] {
         return curl_easy_init();
@@ -69,6 +162,76 @@ bool S3Storage::GetRange(const std::string& obj_id, int max_bytes, std::vector<u
     return IsSuccessStatus(code, {200, 206});
 }
 
+bool S3Storage::GetRanges(const std::string& obj_id,
+                          const std::vector<ByteRange>& ranges,
+                          std::vector<std::vector<uint8_t>>& out) const {
+    if (ranges.empty()) {
+        return false;
+    }
+    std::string range = "bytes=";
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (ranges[i].offset < 0 || ranges[i].length <= 0) {
+            return false;
+        }
+        if (i) {
+            range += ",";
+        }
+        range += std::to_string(ranges[i].offset) + "-" + std::to_string(ranges[i].offset + ranges[i].length - 1);
+    }
+
+    long code = 0;
+    std::vector<uint8_t> body;
+    ResponseHeaders headers;
+    if (!PerformRequest(BuildObjectUrl(obj_id), "GET", nullptr, &body, range, &code, &headers)) {
+        return false;
+    }
+
+    std::vector<Part> parts;
+    std::string_view body_view(reinterpret_cast<const char*>(body.data()), body.size());
+    if (code == 200) {
+        parts.push_back({0, body_view});
+    } else if (code == 206) {
+        const std::string_view ct = headers.content_type;
+        const size_t b = ct.find("boundary=");
+        if (StartsWithNoCase(ct, "multipart/byteranges") && b != std::string_view::npos) {
+            std::string_view boundary = TrimWs(ct.substr(b + 9));
+            if (boundary.size() >= 2 && boundary.front() == '"' && boundary.back() == '"') {
+                boundary = boundary.substr(1, boundary.size() - 2);
+            }
+            if (!ParseByteRanges(body_view, boundary, parts)) {
+                return false;
+            }
+        } else {
+            Part part;
+            int64_t end = 0;
+            if (!ParseContentRange(headers.content_range, &part.start, &end)) {
+                return false;
+            }
+            part.bytes = body_view;
+            parts.push_back(part);
+        }
+    } else {
+        return false;
+    }
+
+    // Servers may coalesce or reorder ranges; match each request to a part.
+    out.clear();
+    out.reserve(ranges.size());
+    for (const auto& r : ranges) {
+        auto it = std::find_if(parts.begin(), parts.end(), [&](const Part& p) {
+            return p.start <= r.offset &&
+                   p.start + static_cast<int64_t>(p.bytes.size()) >= r.offset + r.length;
+        });
+        if (it == parts.end()) {
+            return false;
+        }
+        const char* src = it->bytes.data() + (r.offset - it->start);
+        out.emplace_back(reinterpret_cast<const uint8_t*>(src),
+                         reinterpret_cast<const uint8_t*>(src) + r.length);
+    }
+    return true;
+}
+
 bool S3Storage::Delete(const std::string& obj_id) {
     long code = 0;
     std::string url = BuildObjectUrl(obj_id);
@@ -79,6 +242,23 @@ size_t S3Storage::Size() const {
     return 0;
 }
 
+bool S3Storage::Exists(const std::string& obj_id) const {
+    long code = 0;
+    return PerformRequest(BuildObjectUrl(obj_id), "HEAD", nullptr, nullptr, "", &code) && code == 200;
+}
+
+size_t S3Storage::HeaderCallback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* headers = static_cast<ResponseHeaders*>(userdata);
+    const size_t total = size * nitems;
+    std::string_view line(buffer, total);
+    if (StartsWithNoCase(line, "content-type:")) {
+        headers->content_type = std::string(TrimWs(line.substr(13)));
+    } else if (StartsWithNoCase(line, "content-range:")) {
+        headers->content_range = std::string(TrimWs(line.substr(14)));
+    }
+    return total;
+}
+
 std::string S3Storage::BuildBucketUrl() const {
     return TrimTrailingSlash(cfg_.endpoint) + "/" + cfg_.bucket;
 }
@@ -92,7 +272,8 @@ bool S3Storage::PerformRequest(const std::string& url,
                                const std::vector<uint8_t>* body,
                                std::vector<uint8_t>* out,
                                const std::string& range_header,
-                               long* http_code) const {
+                               long* http_code,
+                               ResponseHeaders* response_headers) const {
     CURL* curl = ThreadCurlHandle();
     if (!curl) {
         return false;
@@ -124,6 +305,10 @@ bool S3Storage::PerformRequest(const std::string& url,
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
     }
 
+    if (method == "HEAD") {
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    }
+
     if (body && (method == "PUT" || method == "POST")) {
         curl_easy_setopt(curl, CURLOPT_POSTFIELDS, reinterpret_cast<const char*>(body->data()));
         curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body->size()));
@@ -135,6 +320,11 @@ bool S3Storage::PerformRequest(const std::string& url,
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, out);
     }
 
+    if (response_headers) {
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, response_headers);
+    }
+
     CURLcode res = curl_easy_perform(curl);
     if (res != CURLE_OK) {
         curl_slist_free_all(headers);
@@ -23,19 +23,31 @@ public:
 
     bool Put(const std::string& obj_id, const std::vector<uint8_t>& data) override;
     bool GetRange(const std::string& obj_id, int max_bytes, std::vector<uint8_t>& out) const override;
+    bool GetRanges(const std::string& obj_id,
+                   const std::vector<ByteRange>& ranges,
+                   std::vector<std::vector<uint8_t>>& out) const override;
     bool Delete(const std::string& obj_id) override;
     size_t Size() const override;
+    bool Exists(const std::string& obj_id) const override;
 
 private:
     std::string BuildBucketUrl() const;
     std::string BuildObjectUrl(const std::string& obj_id) const;
 
+    struct ResponseHeaders {
+        std::string content_type;
+        std::string content_range;
+    };
+
     bool PerformRequest(const std::string& url,
                         const std::string& method,
                         const std::vector<uint8_t>* body,
                         std::vector<uint8_t>* out,
                         const std::string& range_header,
-                        long* http_code) const;
+                        long* http_code,
+                        ResponseHeaders* headers = nullptr) const;
+
+    static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userdata);
 
     Config cfg_;
 };
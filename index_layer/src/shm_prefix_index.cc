@@ -0,0 +1,470 @@
+#include "shm_prefix_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prompt_cache_poc {
+
+namespace {
+
+constexpr uint32_t kShmMagic = 0x49534350; // "PCSI"
+constexpr uint32_t kShmVersion = 2;
+constexpr size_t kMaxObjId = 63;
+// A writer that died mid-update leaves a slot odd forever; readers give up
+// (a miss) instead of spinning.
+constexpr int kMaxReadRetries = 1 << 16;
+// Lookups restarted because a rebuild was published under them.
+constexpr int kMaxLookupAttempts = 8;
+
+enum SlotState : uint32_t { kEmpty = 0, kLive = 1, kDeleted = 2 };
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock-free");
+
+} // namespace
+
+struct ShmPrefixIndex::Header {
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t slots = 0;
+    uint64_t table_offsets[2] = {0, 0}; // from the segment base
+    std::atomic<uint64_t> generation{0}; // table_offsets[generation & 1] is live
+    int32_t block_size = 0;
+    int32_t window_tokens = 0;
+    int32_t sink_tokens = 0;
+    std::atomic<uint32_t> retired{0};
+    std::atomic<uint64_t> live{0};
+    std::atomic<uint64_t> deleted{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+struct ShmPrefixIndex::SlotData {
+    uint32_t state = kEmpty;
+    int32_t prefix_tokens = 0;
+    int32_t usable_len_bytes = 0;
+    uint32_t obj_len = 0;
+    uint64_t hash = 0;
+    uint64_t fingerprint = 0;
+    uint64_t parent_hash = 0;
+    char obj_id[kMaxObjId + 1] = {};
+};
+
+struct ShmPrefixIndex::Slot {
+    std::atomic<uint64_t> seq{0}; // odd while the writer updates data
+    SlotData data;
+};
+
+ShmPrefixIndex::ShmPrefixIndex(const std::string& name, std::shared_ptr<PrefixMap> map, Config cfg)
+    : name_(name), map_(std::move(map)) {
+    if (!map_) {
+        throw std::invalid_argument("shared prefix index needs a map");
+    }
+    if (cfg.slots == 0 || cfg.max_load <= 0.0 || cfg.max_load > 1.0) {
+        throw std::invalid_argument("shared prefix index needs slots and a max_load in (0, 1]");
+    }
+    size_t slots = 1;
+    while (slots < cfg.slots) {
+        slots <<= 1;
+    }
+
+    // Retire the previous segment unless its writer is still alive. Its fd
+    // (and lock) is held until the new segment is locked.
+    int old_fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (old_fd >= 0) {
+        struct stat st;
+        if (flock(old_fd, LOCK_EX | LOCK_NB) != 0) {
+            close(old_fd);
+            throw std::runtime_error("shared prefix index has a live writer: " + name);
+        }
+        if (fstat(old_fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+            void* p = mmap(nullptr, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, old_fd, 0);
+            if (p != MAP_FAILED) {
+                auto* old = static_cast<Header*>(p);
+                if (old->magic == kShmMagic && old->version == kShmVersion) {
+                    old->retired.store(1, std::memory_order_release);
+                }
+                munmap(p, sizeof(Header));
+            }
+        }
+        shm_unlink(name.c_str());
+    }
+
+    fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd_ < 0 || flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+        if (old_fd >= 0) {
+            close(old_fd);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw std::runtime_error("cannot create shared prefix index: " + name);
+    }
+    if (old_fd >= 0) {
+        close(old_fd);
+    }
+
+    const size_t table_offset = (sizeof(Header) + 63) & ~static_cast<size_t>(63);
+    const size_t bytes = table_offset + 2 * slots * sizeof(Slot);
+    if (ftruncate(fd_, static_cast<off_t>(bytes)) != 0) {
+        close(fd_);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("cannot size shared prefix index: " + name);
+    }
+    bytes_ = bytes;
+    base_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        close(fd_);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("cannot map shared prefix index: " + name);
+    }
+
+    // The segment is zero-filled; construct the shared objects in place and
+    // publish the magic last so readers never see a half-written header.
+    auto* header = new (base_) Header();
+    header->version = kShmVersion;
+    header->slots = slots;
+    header->table_offsets[0] = table_offset;
+    header->table_offsets[1] = table_offset + slots * sizeof(Slot);
+    header->block_size = map_->BlockSize();
+    header->window_tokens = map_->GetSwaConfig().window_tokens;
+    header->sink_tokens = map_->GetSwaConfig().sink_tokens;
+    auto* table = reinterpret_cast<Slot*>(static_cast<uint8_t*>(base_) + table_offset);
+    for (size_t i = 0; i < 2 * slots; ++i) {
+        new (&table[i]) Slot();
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kShmMagic;
+    Map();
+    max_live_ = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(slots) * cfg.max_load));
+
+    // Register first, then load the snapshot under mu_: mutations racing with
+    // the snapshot wait and are applied after it.
+    std::lock_guard<std::mutex> lock(mu_);
+    listener_id_ = map_->AddMutationListener([this](const MetadataEvent& event, MutationScope) { Apply(event); });
+    for (const auto& event : map_->SnapshotEvents()) {
+        ApplyLocked(event);
+    }
+}
+
+ShmPrefixIndex::ShmPrefixIndex(const std::string& name) : name_(name) {
+    fd_ = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error("cannot open shared prefix index: " + name);
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        close(fd_);
+        throw std::runtime_error("not a shared prefix index: " + name);
+    }
+    bytes_ = static_cast<size_t>(st.st_size);
+    base_ = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        close(fd_);
+        throw std::runtime_error("cannot map shared prefix index: " + name);
+    }
+    const auto* header = static_cast<const Header*>(base_);
+    const uint32_t magic = header->magic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const bool valid = magic == kShmMagic && header->version == kShmVersion && header->slots > 0 &&
+                       (header->slots & (header->slots - 1)) == 0 &&
+                       header->table_offsets[0] + header->slots * sizeof(Slot) <= bytes_ &&
+                       header->table_offsets[1] + header->slots * sizeof(Slot) <= bytes_;
+    if (!valid) {
+        munmap(base_, bytes_);
+        close(fd_);
+        throw std::runtime_error("not a shared prefix index: " + name);
+    }
+    Map();
+}
+
+ShmPrefixIndex::~ShmPrefixIndex() {
+    if (map_) {
+        map_->RemoveMutationListener(listener_id_);
+    }
+    // The segment outlives the writer so readers keep working; the next
+    // writer retires it (or call Unlink).
+    if (base_) {
+        munmap(base_, bytes_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void ShmPrefixIndex::Unlink(const std::string& name) {
+    shm_unlink(name.c_str());
+}
+
+void ShmPrefixIndex::Map() {
+    header_ = static_cast<Header*>(base_);
+    for (int i = 0; i < 2; ++i) {
+        tables_[i] = reinterpret_cast<Slot*>(static_cast<uint8_t*>(base_) + header_->table_offsets[i]);
+    }
+    slots_ = tables_[header_->generation.load(std::memory_order_acquire) & 1];
+    mask_ = static_cast<size_t>(header_->slots) - 1;
+    block_size_ = header_->block_size;
+    swa_.window_tokens = header_->window_tokens;
+    swa_.sink_tokens = header_->sink_tokens;
+}
+
+bool ShmPrefixIndex::ReadSlot(const Slot* table, size_t index, SlotData& out, uint64_t& retries) {
+    const Slot& slot = table[index];
+    for (int attempt = 0; attempt < kMaxReadRetries; ++attempt) {
+        const uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            std::memcpy(&out, &slot.data, sizeof(SlotData));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        retries++;
+    }
+    return false;
+}
+
+bool ShmPrefixIndex::Find(const Slot* table, uint64_t hash, SlotData& out, uint64_t& retries) const {
+    size_t index = static_cast<size_t>(hash) & mask_;
+    for (size_t probe = 0; probe <= mask_; ++probe, index = (index + 1) & mask_) {
+        if (!ReadSlot(table, index, out, retries) || out.state == kEmpty) {
+            return false;
+        }
+        if (out.state == kLive && out.hash == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShmPrefixIndex::WriteSlot(Slot* table, size_t index, const SlotData& data) {
+    Slot& slot = table[index];
+    const uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.data, &data, sizeof(SlotData));
+    slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+LookupResult ShmPrefixIndex::Lookup(const std::vector<std::string>& tokens, int max_len_tokens) const {
+    if (tokens.size() < static_cast<size_t>(block_size_)) {
+        return {};
+    }
+    if (max_len_tokens <= 0 || max_len_tokens > static_cast<int>(tokens.size())) {
+        max_len_tokens = static_cast<int>(tokens.size());
+    }
+    return LookupHashed(HashPrefixes(tokens, PrefixLengths(max_len_tokens)), max_len_tokens);
+}
+
+LookupResult ShmPrefixIndex::LookupHashed(const PrefixHashes& prefixes, int max_len_tokens) const {
+    // A rebuild published while we probed may have recycled the table we were
+    // reading; retry on the new one.
+    uint64_t retries = 0;
+    LookupResult res;
+    for (int attempt = 0; attempt < kMaxLookupAttempts; ++attempt) {
+        const uint64_t generation = header_->generation.load(std::memory_order_acquire);
+        res = LookupIn(tables_[generation & 1], prefixes, max_len_tokens, retries);
+        if (header_->generation.load(std::memory_order_acquire) == generation) {
+            break;
+        }
+        res = {};
+        retries++;
+    }
+    if (retries > 0) {
+        read_retries_.fetch_add(retries, std::memory_order_relaxed);
+    }
+    return res;
+}
+
+LookupResult ShmPrefixIndex::LookupIn(const Slot* table,
+                                      const PrefixHashes& prefixes,
+                                      int max_len_tokens,
+                                      uint64_t& retries) const {
+    SlotData last;
+    int last_prefix = 0;
+    uint64_t parent_hash = 0;
+    SlotData data;
+    for (int prefix_len : PrefixLengths(max_len_tokens)) {
+        const int idx = prefixes.IndexOf(prefix_len);
+        if (idx < 0 || !Find(table, prefixes.hashes[idx], data, retries)) {
+            break;
+        }
+        if (data.fingerprint != prefixes.fingerprints[idx] || data.prefix_tokens != prefix_len ||
+            data.parent_hash != parent_hash) {
+            break;
+        }
+        last = data;
+        last_prefix = prefix_len;
+        parent_hash = prefixes.hashes[idx];
+    }
+    if (last_prefix == 0) {
+        return {};
+    }
+    LookupResult res;
+    res.hit = true;
+    res.obj_id.assign(last.obj_id, std::min<size_t>(last.obj_len, kMaxObjId));
+    res.usable_len_bytes = last.usable_len_bytes;
+    res.prefix_tokens = last_prefix;
+    return res;
+}
+
+std::vector<int> ShmPrefixIndex::PrefixLengths(int total_tokens) const {
+    return SwaPrefixLengths(swa_, block_size_, total_tokens);
+}
+
+void ShmPrefixIndex::Apply(const MetadataEvent& event) {
+    std::lock_guard<std::mutex> lock(mu_);
+    ApplyLocked(event);
+}
+
+void ShmPrefixIndex::ApplyLocked(const MetadataEvent& event) {
+    if (event.type == MetadataEvent::Type::kTombstone) {
+        EraseLocked(event.obj_id);
+        return;
+    }
+    for (const auto& record : event.prefixes) {
+        UpsertLocked(event.obj_id, record);
+    }
+}
+
+void ShmPrefixIndex::UpsertLocked(const std::string& obj_id, const PrefixRecord& record) {
+    if (obj_id.size() > kMaxObjId) {
+        header_->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // The writer is the only mutator, so it reads slots without the seqlock.
+    size_t target = mask_ + 1;
+    bool existing = false;
+    size_t index = static_cast<size_t>(record.hash) & mask_;
+    for (size_t probe = 0; probe <= mask_; ++probe, index = (index + 1) & mask_) {
+        const SlotData& cur = slots_[index].data;
+        if (cur.state == kEmpty) {
+            if (target > mask_) {
+                target = index;
+            }
+            break;
+        }
+        if (cur.state == kDeleted) {
+            if (target > mask_) {
+                target = index;
+            }
+            continue;
+        }
+        if (cur.hash == record.hash) {
+            target = index;
+            existing = true;
+            break;
+        }
+    }
+    if (!existing && (target > mask_ || header_->live.load(std::memory_order_relaxed) >= max_live_)) {
+        header_->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    SlotData data;
+    data.state = kLive;
+    data.prefix_tokens = record.prefix_tokens;
+    data.usable_len_bytes = record.usable_len_bytes;
+    data.obj_len = static_cast<uint32_t>(obj_id.size());
+    data.hash = record.hash;
+    data.fingerprint = record.fingerprint;
+    data.parent_hash = record.parent_hash;
+    std::memcpy(data.obj_id, obj_id.data(), obj_id.size());
+    const uint32_t prev_state = slots_[target].data.state;
+    WriteSlot(slots_, target, data);
+    if (!existing) {
+        header_->live.fetch_add(1, std::memory_order_relaxed);
+        if (prev_state == kDeleted) {
+            header_->deleted.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+    auto& owned = obj_slots_[obj_id];
+    if (std::find(owned.begin(), owned.end(), target) == owned.end()) {
+        owned.push_back(target);
+    }
+}
+
+void ShmPrefixIndex::EraseLocked(const std::string& obj_id) {
+    auto it = obj_slots_.find(obj_id);
+    if (it == obj_slots_.end()) {
+        return;
+    }
+    for (size_t index : it->second) {
+        const SlotData& cur = slots_[index].data;
+        // Slots taken over by another object since are left alone.
+        if (cur.state != kLive || cur.obj_len != obj_id.size() ||
+            std::memcmp(cur.obj_id, obj_id.data(), obj_id.size()) != 0) {
+            continue;
+        }
+        SlotData data = cur;
+        data.state = kDeleted;
+        WriteSlot(slots_, index, data);
+        header_->live.fetch_sub(1, std::memory_order_relaxed);
+        header_->deleted.fetch_add(1, std::memory_order_relaxed);
+    }
+    obj_slots_.erase(it);
+
+    // Deleted slots lengthen probes for misses; rebuild once they are a
+    // quarter of the table.
+    if (header_->deleted.load(std::memory_order_relaxed) > (mask_ + 1) / 4) {
+        RebuildLocked();
+    }
+}
+
+void ShmPrefixIndex::RebuildLocked() {
+    // Fill the idle table with the live slots, then publish it. Readers keep
+    // probing the old table until the generation bump; the idle table is only
+    // recycled a rebuild later, and readers still on it then retry.
+    const uint64_t generation = header_->generation.load(std::memory_order_relaxed);
+    Slot* const old_table = slots_;
+    Slot* const new_table = tables_[(generation + 1) & 1];
+    for (size_t index = 0; index <= mask_; ++index) {
+        if (new_table[index].data.state != kEmpty) {
+            WriteSlot(new_table, index, SlotData{});
+        }
+    }
+    obj_slots_.clear();
+    slots_ = new_table;
+    header_->live.store(0, std::memory_order_relaxed);
+    for (size_t index = 0; index <= mask_; ++index) {
+        const SlotData& cur = old_table[index].data;
+        if (cur.state != kLive) {
+            continue;
+        }
+        PrefixRecord record;
+        record.hash = cur.hash;
+        record.fingerprint = cur.fingerprint;
+        record.prefix_tokens = cur.prefix_tokens;
+        record.usable_len_bytes = cur.usable_len_bytes;
+        record.parent_hash = cur.parent_hash;
+        UpsertLocked(std::string(cur.obj_id, cur.obj_len), record);
+    }
+    header_->deleted.store(0, std::memory_order_relaxed);
+    header_->generation.store(generation + 1, std::memory_order_release);
+}
+
+bool ShmPrefixIndex::Retired() const {
+    return header_->retired.load(std::memory_order_acquire) != 0;
+}
+
+ShmPrefixIndex::Stats ShmPrefixIndex::GetStats() const {
+    Stats stats;
+    stats.slots = mask_ + 1;
+    stats.live = static_cast<size_t>(header_->live.load(std::memory_order_relaxed));
+    stats.deleted = static_cast<size_t>(header_->deleted.load(std::memory_order_relaxed));
+    stats.dropped = header_->dropped.load(std::memory_order_relaxed);
+    stats.rebuilds = header_->generation.load(std::memory_order_relaxed);
+    stats.read_retries = read_retries_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace prompt_cache_poc
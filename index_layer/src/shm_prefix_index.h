@@ -0,0 +1,109 @@
+#pragma once
+
+#include "cache.h"
+#include "metadata_event.h"
+#include "prefix_hash.h"
+#include "swa_planner.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Host-wide copy of a PrefixMap's prefix table in a named POSIX shared-memory
+// segment, so every engine worker on the host looks up one index with no IPC.
+//
+// One writer process owns the segment (flock on the shm fd) and mirrors a
+// PrefixMap into it through a mutation listener. Readers map the segment
+// read-only and never lock: the table is open addressing with linear probing
+// over fixed-size slots, each guarded by a seqlock (odd sequence = slot being
+// written, readers retry), and the header refers to the table by offset, so
+// the segment can be mapped at any address. The segment holds two tables:
+// once tombstones pile up the writer rebuilds the live slots into the idle
+// one and publishes it by bumping a generation; readers that saw the
+// generation change mid-lookup retry, so a rebuild never causes a miss. A
+// writer that replaces a segment marks the old one retired; readers check
+// Retired() and reopen.
+class ShmPrefixIndex {
+public:
+    struct Config {
+        size_t slots = 1u << 20;   // rounded up to a power of two
+        double max_load = 0.75;    // inserts past this fill are dropped
+    };
+
+    struct Stats {
+        size_t slots = 0;
+        size_t live = 0;
+        size_t deleted = 0;
+        uint64_t dropped = 0;      // records not inserted (table full, long obj_id)
+        uint64_t rebuilds = 0;     // tables published to drop tombstones
+        uint64_t read_retries = 0; // seqlock retries seen by this process
+    };
+
+    // Writer: creates (or replaces) the segment, loads the map's current
+    // prefixes and follows its mutations. Throws if another writer holds it.
+    ShmPrefixIndex(const std::string& name, std::shared_ptr<PrefixMap> map, Config cfg);
+    // Reader: maps an existing segment read-only.
+    explicit ShmPrefixIndex(const std::string& name);
+    ~ShmPrefixIndex();
+
+    ShmPrefixIndex(const ShmPrefixIndex&) = delete;
+    ShmPrefixIndex& operator=(const ShmPrefixIndex&) = delete;
+
+    // Same semantics as PrefixMap::Lookup (fingerprint, length and parent
+    // checks), without reuse accounting.
+    LookupResult Lookup(const std::vector<std::string>& tokens, int max_len_tokens = 0) const;
+    LookupResult LookupHashed(const PrefixHashes& prefixes, int max_len_tokens) const;
+    std::vector<int> PrefixLengths(int total_tokens) const;
+
+    // Writer only; called by the map listener.
+    void Apply(const MetadataEvent& event);
+
+    bool Retired() const;
+    Stats GetStats() const;
+
+    static void Unlink(const std::string& name);
+
+private:
+    struct Header;
+    struct Slot;
+    struct SlotData;
+
+    static bool ReadSlot(const Slot* table, size_t index, SlotData& out, uint64_t& retries);
+    bool Find(const Slot* table, uint64_t hash, SlotData& out, uint64_t& retries) const;
+    static void WriteSlot(Slot* table, size_t index, const SlotData& data);
+    LookupResult LookupIn(const Slot* table, const PrefixHashes& prefixes, int max_len_tokens, uint64_t& retries) const;
+    void ApplyLocked(const MetadataEvent& event);
+    void UpsertLocked(const std::string& obj_id, const PrefixRecord& record);
+    void EraseLocked(const std::string& obj_id);
+    void RebuildLocked();
+    void Map();
+
+    std::string name_;
+    int fd_ = -1;
+    void* base_ = nullptr;
+    size_t bytes_ = 0;
+    Header* header_ = nullptr;
+    Slot* tables_[2] = {nullptr, nullptr};
+    Slot* slots_ = nullptr; // writer: the published table
+    size_t mask_ = 0;
+    SwaConfig swa_;
+    int block_size_ = 0;
+    mutable std::atomic<uint64_t> read_retries_{0};
+
+    // Writer state.
+    std::shared_ptr<PrefixMap> map_;
+    int listener_id_ = 0;
+    std::mutex mu_;
+    size_t max_live_ = 0;
+    // Slots each object owns, for tombstones.
+    std::unordered_map<std::string, std::vector<size_t>> obj_slots_;
+};
+
+} // namespace prompt_cache_poc
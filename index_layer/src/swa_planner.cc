@@ -0,0 +1,101 @@
+#include "swa_planner.h"
+
+#include <algorithm>
+
+namespace prompt_cache_poc {
+
+bool SwaConfig::Enabled() const {
+    return window_tokens > 0;
+}
+
+bool SwaConfig::Valid(int column_tokens) const {
+    if (!Enabled()) {
+        return true;
+    }
+    return column_tokens > 0 &&
+           sink_tokens >= 0 &&
+           sink_tokens < window_tokens &&
+           window_tokens % column_tokens == 0;
+}
+
+int SwaSlot(const SwaConfig& cfg, int token) {
+    if (!cfg.Enabled() || token < cfg.window_tokens || token < cfg.sink_tokens) {
+        return token;
+    }
+    const int loop = cfg.window_tokens - cfg.sink_tokens;
+    return cfg.sink_tokens + (token - cfg.sink_tokens) % loop;
+}
+
+std::vector<int> SwaPrefixLengths(const SwaConfig& cfg, int column_tokens, int total_tokens) {
+    std::vector<int> lengths;
+    if (column_tokens <= 0) {
+        return lengths;
+    }
+
+    const int first_limit = cfg.Enabled() ? std::min(total_tokens, cfg.window_tokens) : total_tokens;
+    for (int len = column_tokens; len <= first_limit; len += column_tokens) {
+        lengths.push_back(len);
+    }
+    if (!cfg.Enabled() || !cfg.Valid(column_tokens) || total_tokens <= cfg.window_tokens) {
+        return lengths;
+    }
+
+    // Past the window the next token lands on slot SwaSlot(len); a column is
+    // complete whenever that slot is column-aligned.
+    int len = cfg.window_tokens;
+    while (true) {
+        const int slot = SwaSlot(cfg, len);
+        int next_aligned = (slot / column_tokens + 1) * column_tokens;
+        next_aligned = std::min(next_aligned, cfg.window_tokens);
+        len += next_aligned - slot;
+        if (len > total_tokens) {
+            break;
+        }
+        lengths.push_back(len);
+    }
+    return lengths;
+}
+
+int SwaNextPrefixLength(const SwaConfig& cfg, int column_tokens, int after) {
+    if (column_tokens <= 0 || after < 0) {
+        return 0;
+    }
+    const int next = (after / column_tokens + 1) * column_tokens;
+    if (!cfg.Enabled() || next <= cfg.window_tokens) {
+        return next;
+    }
+    if (!cfg.Valid(column_tokens)) {
+        return 0;
+    }
+    const int len = std::max(after, cfg.window_tokens);
+    const int slot = SwaSlot(cfg, len);
+    const int next_aligned = std::min((slot / column_tokens + 1) * column_tokens, cfg.window_tokens);
+    return len + next_aligned - slot;
+}
+
+std::vector<TokenSpan> PlanSwaRefill(const SwaConfig& cfg, int prefix_tokens) {
+    std::vector<TokenSpan> spans;
+    if (prefix_tokens <= 0) {
+        return spans;
+    }
+    if (!cfg.Enabled() || prefix_tokens <= cfg.window_tokens) {
+        spans.push_back({0, prefix_tokens});
+        return spans;
+    }
+
+    const int sink = cfg.sink_tokens;
+    const int loop = cfg.window_tokens - sink;
+    const int window_first = prefix_tokens - loop;   // oldest token still in the window
+    const int wrap_token = prefix_tokens - 1 - (SwaSlot(cfg, prefix_tokens - 1) - sink); // token in slot `sink`
+
+    if (sink > 0) {
+        spans.push_back({0, sink});
+    }
+    spans.push_back({wrap_token, prefix_tokens - wrap_token});
+    if (wrap_token > window_first) {
+        spans.push_back({window_first, wrap_token - window_first});
+    }
+    return spans;
+}
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "kv_layout.h"
+
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Sliding-window attention cache shape. window_tokens includes the sink
+// tokens; window_tokens == 0 means full attention.
+struct SwaConfig {
+    int window_tokens = 0;
+    int sink_tokens = 0;
+
+    bool Enabled() const;
+    bool Valid(int column_tokens) const;
+};
+
+// Wafer window slot that token t occupies once the window has wrapped.
+int SwaSlot(const SwaConfig& cfg, int token);
+
+// Prefix lengths at which a column of the wafer window is complete, up to
+// total_tokens. Without SWA these are the multiples of column_tokens; past the
+// window they follow the loop-around (e.g. W=100, S=3, C=10: ..., 100, 107,
+// 117, ...).
+std::vector<int> SwaPrefixLengths(const SwaConfig& cfg, int column_tokens, int total_tokens);
+
+// Smallest length in SwaPrefixLengths greater than after, or 0 if there is
+// none. O(1), for callers that grow a prompt a few tokens at a time.
+int SwaNextPrefixLength(const SwaConfig& cfg, int column_tokens, int after);
+
+// Token spans, in wafer window order, that reconstruct the window after
+// prefix_tokens logical tokens: sink tokens, the loop-around portion, then the
+// pre-loop portion. A prefix that fits in the window is one span.
+std::vector<TokenSpan> PlanSwaRefill(const SwaConfig& cfg, int prefix_tokens);
+
+} // namespace prompt_cache_poc
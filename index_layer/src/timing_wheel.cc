@@ -0,0 +1,84 @@
+#include "timing_wheel.h"
+
+#include <stdexcept>
+
+namespace prompt_cache_poc {
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tick, Clock::time_point start)
+    : tick_(tick), start_(start) {
+    if (tick_.count() <= 0) {
+        throw std::invalid_argument("timing wheel tick must be positive");
+    }
+}
+
+uint64_t TimingWheel::TickOf(Clock::time_point t, bool round_up) const {
+    if (t <= start_) {
+        return 0;
+    }
+    // Deadlines round up and the clock rounds down, so nothing fires early.
+    const auto elapsed = round_up ? std::chrono::ceil<std::chrono::milliseconds>(t - start_).count()
+                                  : std::chrono::floor<std::chrono::milliseconds>(t - start_).count();
+    return static_cast<uint64_t>((elapsed + (round_up ? tick_.count() - 1 : 0)) / tick_.count());
+}
+
+void TimingWheel::Schedule(const std::string& key, Clock::time_point deadline) {
+    Insert(Entry{key, TickOf(deadline, true)});
+    size_++;
+}
+
+void TimingWheel::Insert(Entry entry) {
+    // Overdue entries fire on the next tick.
+    const uint64_t tick = entry.deadline_tick > current_tick_ ? entry.deadline_tick : current_tick_ + 1;
+    const uint64_t delta = tick - current_tick_;
+    for (int level = 0; level < kLevels; ++level) {
+        const int shift = level * kSlotBits;
+        if (delta < (kSlots << shift) || level == kLevels - 1) {
+            // Past the top level's span, park in its furthest slot and
+            // cascade again later.
+            const uint64_t max_tick = current_tick_ + (kSlots << shift) - 1;
+            const uint64_t slot_tick = tick > max_tick && level == kLevels - 1 ? max_tick : tick;
+            slots_[level][(slot_tick >> shift) & (kSlots - 1)].push_back(std::move(entry));
+            return;
+        }
+    }
+}
+
+void TimingWheel::Advance(Clock::time_point now, std::vector<std::string>& fired) {
+    const uint64_t target = TickOf(now, false);
+    while (current_tick_ < target) {
+        current_tick_++;
+        // Cascade higher levels whose slot boundary was reached, top down.
+        for (int level = kLevels - 1; level >= 1; --level) {
+            const int shift = level * kSlotBits;
+            if ((current_tick_ & ((1ull << shift) - 1)) != 0) {
+                continue;
+            }
+            std::vector<Entry> moved;
+            moved.swap(slots_[level][(current_tick_ >> shift) & (kSlots - 1)]);
+            for (auto& entry : moved) {
+                if (entry.deadline_tick <= current_tick_) {
+                    fired.push_back(std::move(entry.key));
+                    size_--;
+                } else {
+                    Insert(std::move(entry));
+                }
+            }
+        }
+        std::vector<Entry> due;
+        due.swap(slots_[0][current_tick_ & (kSlots - 1)]);
+        for (auto& entry : due) {
+            if (entry.deadline_tick <= current_tick_) {
+                fired.push_back(std::move(entry.key));
+                size_--;
+            } else {
+                Insert(std::move(entry));
+            }
+        }
+    }
+}
+
+size_t TimingWheel::Size() const {
+    return size_;
+}
+
+} // namespace prompt_cache_poc
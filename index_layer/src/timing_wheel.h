@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Hierarchical timing wheel: 4 levels of 64 slots, so with a 1 s tick it
+// spans about 194 days. Schedule is O(1); Advance costs O(ticks elapsed +
+// entries fired or cascaded). Entries are not cancelled: owners re-check the
+// real deadline when a key fires and reschedule if it moved.
+class TimingWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimingWheel(std::chrono::milliseconds tick, Clock::time_point start);
+
+    void Schedule(const std::string& key, Clock::time_point deadline);
+
+    // Moves time forward to now and appends every key whose deadline has
+    // passed to fired.
+    void Advance(Clock::time_point now, std::vector<std::string>& fired);
+
+    size_t Size() const;
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 6;
+    static constexpr uint64_t kSlots = 1u << kSlotBits;
+
+    struct Entry {
+        std::string key;
+        uint64_t deadline_tick;
+    };
+
+    uint64_t TickOf(Clock::time_point t, bool round_up) const;
+    void Insert(Entry entry);
+
+    std::chrono::milliseconds tick_;
+    Clock::time_point start_;
+    uint64_t current_tick_ = 0;
+    size_t size_ = 0;
+    std::vector<Entry> slots_[kLevels][kSlots];
+};
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,118 @@
+#include "write_behind.h"
+
+#include <stdexcept>
+
+namespace prompt_cache_poc {
+
+WriteBehindQueue::WriteBehindQueue(Config cfg, Handler handler)
+    : cfg_(cfg), handler_(std::move(handler)) {
+    if (cfg_.threads <= 0 || cfg_.max_queue_items == 0 || cfg_.max_queue_bytes == 0) {
+        throw std::invalid_argument("write-behind threads and queue limits must be positive");
+    }
+    if (!handler_) {
+        throw std::invalid_argument("write-behind handler must be set");
+    }
+    for (int i = 0; i < cfg_.threads; ++i) {
+        workers_.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+WriteBehindQueue::~WriteBehindQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    space_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+bool WriteBehindQueue::Enqueue(Job job) {
+    const size_t bytes = job.data.size();
+    std::unique_lock<std::mutex> lock(mu_);
+    if (stop_ || bytes > cfg_.max_queue_bytes) {
+        stats_.dropped++;
+        return false;
+    }
+
+    if (!HasRoomLocked(bytes)) {
+        switch (cfg_.policy) {
+        case FullPolicy::kBlock:
+            stats_.blocked++;
+            space_cv_.wait(lock, [&] { return stop_ || HasRoomLocked(bytes); });
+            if (stop_) {
+                stats_.dropped++;
+                return false;
+            }
+            break;
+        case FullPolicy::kDropNewest:
+            stats_.dropped++;
+            return false;
+        case FullPolicy::kDropOldest:
+            while (!queue_.empty() && !HasRoomLocked(bytes)) {
+                queued_bytes_ -= queue_.front().data.size();
+                queue_.pop_front();
+                stats_.dropped++;
+            }
+            break;
+        }
+    }
+
+    queued_bytes_ += bytes;
+    queue_.push_back(std::move(job));
+    stats_.enqueued++;
+    lock.unlock();
+    work_cv_.notify_one();
+    return true;
+}
+
+void WriteBehindQueue::Flush() {
+    std::unique_lock<std::mutex> lock(mu_);
+    idle_cv_.wait(lock, [this] { return queue_.empty() && in_flight_ == 0; });
+}
+
+WriteBehindQueue::Stats WriteBehindQueue::GetStats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    Stats stats = stats_;
+    stats.queued_items = queue_.size();
+    stats.queued_bytes = queued_bytes_;
+    return stats;
+}
+
+bool WriteBehindQueue::HasRoomLocked(size_t bytes) const {
+    return queue_.size() < cfg_.max_queue_items && queued_bytes_ + bytes <= cfg_.max_queue_bytes;
+}
+
+void WriteBehindQueue::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+        work_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            // stop_ is set and everything accepted has been drained.
+            return;
+        }
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        queued_bytes_ -= job.data.size();
+        in_flight_++;
+        lock.unlock();
+        space_cv_.notify_all();
+
+        const bool ok = handler_(job);
+
+        lock.lock();
+        in_flight_--;
+        if (ok) {
+            stats_.uploaded++;
+        } else {
+            stats_.failed++;
+        }
+        if (queue_.empty() && in_flight_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+}
+
+} // namespace prompt_cache_poc
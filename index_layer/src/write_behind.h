@@ -0,0 +1,92 @@
+#pragma once
+
+#include "kv_layout.h"
+#include "prefix_hash.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace prompt_cache_poc {
+
+// Bounded upload queue for write-behind stores.
+//
+// Producers enqueue a payload and return immediately; worker threads run the
+// handler (PUT, then advertise) for each job. The queue is limited both in
+// items and in payload bytes, and a full queue either blocks the producer or
+// drops the newest/oldest job.
+class WriteBehindQueue {
+public:
+    enum class FullPolicy { kBlock, kDropNewest, kDropOldest };
+
+    struct Config {
+        size_t max_queue_bytes = 256u * 1024u * 1024u;
+        size_t max_queue_items = 1024;
+        int threads = 2;
+        FullPolicy policy = FullPolicy::kBlock;
+    };
+
+    struct Stats {
+        uint64_t enqueued = 0;
+        uint64_t uploaded = 0;
+        uint64_t failed = 0;
+        uint64_t dropped = 0;
+        uint64_t blocked = 0;
+        size_t queued_items = 0;
+        size_t queued_bytes = 0;
+    };
+
+    struct Job {
+        std::string obj_id;
+        PrefixHashes prefixes;
+        int total_tokens = 0;
+        std::vector<uint8_t> data;
+        ObjectLayout layout;
+        std::string owner_id;
+        int priority = 0;
+    };
+
+    using Handler = std::function<bool(const Job&)>;
+
+    WriteBehindQueue(Config cfg, Handler handler);
+    // Drains queued jobs before joining the workers.
+    ~WriteBehindQueue();
+
+    WriteBehindQueue(const WriteBehindQueue&) = delete;
+    WriteBehindQueue& operator=(const WriteBehindQueue&) = delete;
+
+    // False if the job was dropped (kDropNewest on a full queue, or a payload
+    // larger than max_queue_bytes).
+    bool Enqueue(Job job);
+
+    // Waits until every accepted job has been handled.
+    void Flush();
+
+    Stats GetStats() const;
+
+private:
+    bool HasRoomLocked(size_t bytes) const;
+    void WorkerLoop();
+
+    Config cfg_;
+    Handler handler_;
+
+    mutable std::mutex mu_;
+    std::condition_variable work_cv_;
+    std::condition_variable space_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<Job> queue_;
+    size_t queued_bytes_ = 0;
+    size_t in_flight_ = 0;
+    bool stop_ = false;
+    Stats stats_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace prompt_cache_poc
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../src/cache.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// In-process Storage used by tests that do not need a running gateway.
+class MemStorage final : public prompt_cache_poc::Storage {
+public:
+    bool Put(const std::string& obj_id, const std::vector<uint8_t>& data) override {
+        std::lock_guard<std::mutex> lock(mu_);
+        objects_[obj_id] = data;
+        puts++;
+        return true;
+    }
+
+    bool GetRange(const std::string& obj_id, int max_bytes, std::vector<uint8_t>& out) const override {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = objects_.find(obj_id);
+        if (it == objects_.end()) {
+            return false;
+        }
+        size_t n = it->second.size();
+        if (max_bytes > 0) {
+            n = std::min(n, static_cast<size_t>(max_bytes));
+        }
+        out.assign(it->second.begin(), it->second.begin() + n);
+        gets++;
+        bytes_read += n;
+        return true;
+    }
+
+    bool GetRanges(const std::string& obj_id,
+                   const std::vector<prompt_cache_poc::ByteRange>& ranges,
+                   std::vector<std::vector<uint8_t>>& out) const override {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto it = objects_.find(obj_id);
+        if (it == objects_.end()) {
+            return false;
+        }
+        out.clear();
+        for (const auto& r : ranges) {
+            if (r.offset < 0 || r.offset + r.length > static_cast<int64_t>(it->second.size())) {
+                return false;
+            }
+            out.emplace_back(it->second.begin() + r.offset, it->second.begin() + r.offset + r.length);
+            bytes_read += static_cast<size_t>(r.length);
+        }
+        gets++;
+        return true;
+    }
+
+    bool Delete(const std::string& obj_id) override {
+        std::lock_guard<std::mutex> lock(mu_);
+        return objects_.erase(obj_id) > 0;
+    }
+
+    size_t Size() const override {
+        std::lock_guard<std::mutex> lock(mu_);
+        return objects_.size();
+    }
+
+    bool Exists(const std::string& obj_id) const override {
+        std::lock_guard<std::mutex> lock(mu_);
+        heads++;
+        return objects_.count(obj_id) > 0;
+    }
+
+    mutable size_t puts = 0;
+    mutable size_t heads = 0;
+    mutable size_t gets = 0;
+    mutable size_t bytes_read = 0;
+
+private:
+    mutable std::mutex mu_;
+    std::map<std::string, std::vector<uint8_t>> objects_;
+};
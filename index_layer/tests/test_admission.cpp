@@ -0,0 +1,102 @@
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::AdmissionConfig;
+using prompt_cache_poc::FrequencySketch;
+using prompt_cache_poc::ObjectLayout;
+using prompt_cache_poc::PrefixHandle;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::StoreStatus;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& system, const std::string& user) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < 4; ++t) {
+        tokens.push_back(system + std::to_string(t));
+    }
+    for (int t = 0; t < 4; ++t) {
+        tokens.push_back(user + std::to_string(t));
+    }
+    return tokens;
+}
+
+} // namespace
+
+int main() {
+    FrequencySketch sketch(1024, 64);
+    for (int i = 0; i < 5; ++i) {
+        assert(sketch.Increment(42) == static_cast<uint32_t>(i + 1));
+    }
+    assert(sketch.Estimate(42) == 5);
+    assert(sketch.Estimate(43) <= 1);
+    // Aging halves the counts once sample_size increments have been seen.
+    for (uint64_t k = 1000; sketch.Agings() == 0; ++k) {
+        sketch.Increment(k);
+    }
+    assert(sketch.Estimate(42) == 2);
+
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap map(4, 1, storage);
+
+    // Disabled by default.
+    StoreStatus status = StoreStatus::kFailed;
+    assert(!map.Store(Prompt("s", "u"), std::vector<uint8_t>(8, 1), "r", 0, false, &status).empty());
+    assert(status == StoreStatus::kStored);
+    assert(storage->puts == 1);
+
+    AdmissionConfig cfg;
+    cfg.enabled = true;
+    cfg.min_frequency = 2;
+    cfg.bypass_priority = 5;
+    map.SetAdmissionConfig(cfg);
+
+    // First sight of a prompt is rejected without I/O, and reported as a
+    // rejection rather than a failure.
+    assert(map.Store(Prompt("a", "x"), std::vector<uint8_t>(8, 2), "r", 0, false, &status).empty());
+    assert(status == StoreStatus::kRejected);
+    assert(storage->puts == 1);
+    assert(map.AdmissionRejects() == 1);
+    assert(!map.Lookup(Prompt("a", "x")).hit);
+
+    // A different prompt sharing the leading column does not inherit its count.
+    assert(map.Store(Prompt("a", "y"), std::vector<uint8_t>(8, 3), "r", 0).empty());
+    assert(map.AdmissionRejects() == 2);
+
+    // The same prompt seen again is admitted.
+    assert(!map.Store(Prompt("a", "x"), std::vector<uint8_t>(8, 2), "r", 0, false, &status).empty());
+    assert(status == StoreStatus::kStored);
+    assert(storage->puts == 2);
+    assert(map.Lookup(Prompt("a", "x")).hit);
+
+    // High priority bypasses the filter.
+    assert(!map.Store(Prompt("b", "x"), std::vector<uint8_t>(8, 4), "r", 5).empty());
+    assert(map.AdmissionRejects() == 2);
+
+    // Continuations are counted on the whole conversation so far.
+    PrefixHandle first;
+    assert(map.StoreContinuation(first, Prompt("c", "x"), std::vector<uint8_t>(8, 5), {}, "r", 0, false, &status)
+               .empty());
+    assert(status == StoreStatus::kRejected);
+    PrefixHandle second;
+    assert(!map.StoreContinuation(second, Prompt("c", "x"), std::vector<uint8_t>(8, 5), {}, "r", 0, false, &status)
+                .empty());
+    assert(status == StoreStatus::kStored);
+
+    // An admitted store that fails (payload does not match its layout) is
+    // reported as a failure.
+    ObjectLayout layout;
+    layout.buffer_bytes_per_token = {3};
+    assert(map.Store(Prompt("b", "y"), std::vector<uint8_t>(8, 6), layout, "r", 5, false, &status).empty());
+    assert(status == StoreStatus::kFailed);
+    assert(map.AdmissionRejects() == 3);
+
+    std::cout << "test_admission passed\n";
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "../src/content_hash.h"
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using prompt_cache_poc::ContentHasher;
+using prompt_cache_poc::ContentId;
+using prompt_cache_poc::HashContent;
+
+int main() {
+    std::vector<uint8_t> data(3000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+
+    // Streaming in any split matches the one-shot hash.
+    const auto whole = HashContent(data.data(), data.size());
+    for (size_t step : {1u, 7u, 63u, 64u, 65u, 1000u}) {
+        ContentHasher hasher;
+        for (size_t off = 0; off < data.size(); off += step) {
+            hasher.Update(data.data() + off, std::min(step, data.size() - off));
+        }
+        assert(hasher.Finish() == whole);
+    }
+
+    // Zero padding and length are distinguished.
+    std::set<std::string> ids;
+    for (size_t n : {0u, 1u, 63u, 64u, 65u, 128u, 1024u, 1025u}) {
+        ids.insert(ContentId(std::vector<uint8_t>(n, 0)));
+    }
+    assert(ids.size() == 8);
+
+    // Single-bit changes change the id.
+    std::vector<uint8_t> flipped = data;
+    flipped[1500] ^= 1;
+    assert(ContentId(flipped) != ContentId(data));
+
+    // Multi-chunk payloads take the tree path (on the shared pool above
+    // 4 MiB) and stay deterministic, including under concurrent callers.
+    std::vector<uint8_t> big((5u << 20) + 123);
+    for (size_t i = 0; i < big.size(); ++i) {
+        big[i] = static_cast<uint8_t>((i >> 3) ^ i);
+    }
+    const std::string big_id = ContentId(big);
+    assert(big_id == "ccb8e602dd1c0045ad46570b1502eebd");
+    {
+        std::vector<std::thread> callers;
+        for (int t = 0; t < 4; ++t) {
+            callers.emplace_back([&] { assert(ContentId(big) == big_id); });
+        }
+        for (auto& t : callers) {
+            t.join();
+        }
+    }
+    big[(3u << 20) + 5] ^= 0x80;
+    assert(ContentId(big) == "8c8710b40fbba47878ef76071a17c906");
+
+    // Golden values: single-chunk ids are XXH3-128 (seed 0) and must match
+    // the reference implementation on every build and platform. They come
+    // from the xxhash Python package, xxhash.xxh3_128_hexdigest(b, seed=0),
+    // for b"", b"abc" and bytes((i * 131 + 7) & 0xff for i in range(3000)).
+    assert(ContentId({}) == "99aa06d3014798d86001c324468d497f");
+    assert(ContentId({'a', 'b', 'c'}) == "06b05ab6733a618578af5f94892f3950");
+    assert(ContentId(data) == "90cabc4f5f59603233a08283bba03e0c");
+
+    std::cout << "test_content_hash passed\n";
+    return 0;
+}
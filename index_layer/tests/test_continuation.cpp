@@ -0,0 +1,136 @@
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::HashPrefixes;
+using prompt_cache_poc::LookupResult;
+using prompt_cache_poc::MetadataEvent;
+using prompt_cache_poc::MutationScope;
+using prompt_cache_poc::ObjectLayout;
+using prompt_cache_poc::PrefixHandle;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::SwaConfig;
+using prompt_cache_poc::SwaNextPrefixLength;
+using prompt_cache_poc::SwaPrefixLengths;
+
+namespace {
+
+std::vector<std::string> Turn(const std::string& tag, int n) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < n; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+void Append(std::vector<std::string>& all, const std::vector<std::string>& more) {
+    all.insert(all.end(), more.begin(), more.end());
+}
+
+bool Same(const LookupResult& a, const LookupResult& b) {
+    return a.hit == b.hit && a.obj_id == b.obj_id && a.prefix_tokens == b.prefix_tokens &&
+           a.usable_len_bytes == b.usable_len_bytes;
+}
+
+} // namespace
+
+int main() {
+    // The O(1) next-boundary step walks the same lengths as SwaPrefixLengths.
+    const SwaConfig swa_cfgs[] = {{0, 0}, {100, 3}, {40, 0}, {32, 8}};
+    for (const auto& cfg : swa_cfgs) {
+        std::vector<int> stepped;
+        for (int len = SwaNextPrefixLength(cfg, 4, 0); len > 0 && len <= 500;
+             len = SwaNextPrefixLength(cfg, 4, len)) {
+            stepped.push_back(len);
+        }
+        assert(stepped == SwaPrefixLengths(cfg, 4, 500));
+    }
+
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap map(4, 2, storage);
+
+    // Extending a handle token by token yields the one-shot prefix hashes.
+    std::vector<std::string> convo = Turn("sys", 10);
+    PrefixHandle handle;
+    map.Extend(handle, convo);
+    const auto oneshot = HashPrefixes(convo, map.PrefixLengths(10));
+    assert(handle.prefixes.lengths == oneshot.lengths);
+    assert(handle.prefixes.hashes == oneshot.hashes);
+    assert(handle.prefixes.fingerprints == oneshot.fingerprints);
+    assert(handle.hasher.Count() == 10);
+
+    // Turn 1: nothing cached yet.
+    PrefixHandle chat;
+    LookupResult res = map.LookupContinuation(chat, convo);
+    assert(!res.hit && chat.matched == 0);
+    const std::string turn1 =
+        map.StoreContinuation(chat, {}, std::vector<uint8_t>(20, 1), ObjectLayout{}, "r", 0);
+    assert(!turn1.empty() && chat.matched == 2);
+
+    // Turn 2 probes only the new prefixes and agrees with a full lookup.
+    const auto user2 = Turn("u2-", 7);
+    Append(convo, user2);
+    res = map.LookupContinuation(chat, user2);
+    assert(res.hit && res.obj_id == turn1 && res.prefix_tokens == 8);
+    assert(Same(res, map.Lookup(convo)));
+    assert(chat.matched == 2 && chat.hasher.Count() == 17);
+
+    const std::string turn2 =
+        map.StoreContinuation(chat, {}, std::vector<uint8_t>(34, 2), ObjectLayout{}, "r", 0);
+    assert(!turn2.empty() && turn2 != turn1);
+    const auto user3 = Turn("u3-", 5);
+    Append(convo, user3);
+    res = map.LookupContinuation(chat, user3);
+    assert(res.hit && res.obj_id == turn2 && res.prefix_tokens == 16);
+    assert(Same(res, map.Lookup(convo)));
+    assert(chat.matched == 4);
+
+    // Stores carry the parent chain.
+    bool chained = true;
+    map.AddMutationListener([&chained](const MetadataEvent& event, MutationScope) {
+        for (size_t i = 0; i < event.prefixes.size(); ++i) {
+            const uint64_t parent = i > 0 ? event.prefixes[i - 1].hash : 0;
+            chained = chained && event.prefixes[i].parent_hash == parent;
+        }
+    });
+    const std::string turn3 = map.StoreContinuation(chat, Turn("a3-", 3), std::vector<uint8_t>(50, 3),
+                                                    ObjectLayout{}, "r", 0);
+    assert(!turn3.empty() && chained);
+    assert(chat.matched == 6 && chat.hasher.Count() == 25);
+
+    // The last match went away: the continuation rescans the hashes it holds
+    // and falls back to the longest surviving prefix.
+    assert(map.Tombstone(turn3));
+    const std::vector<std::string> first17(convo.begin(), convo.begin() + 17);
+    assert(map.Store(first17, std::vector<uint8_t>(34, 2), "r", 0) == turn2);
+    res = map.LookupContinuation(chat, {});
+    assert(res.hit && res.obj_id == turn2 && res.prefix_tokens == 16);
+    assert(chat.matched == 4);
+
+    // An entry whose parent is not the chain's previous prefix is a miss.
+    const uint64_t mismatches = map.FingerprintMismatches();
+    MetadataEvent forged;
+    forged.type = MetadataEvent::Type::kAdvertise;
+    forged.obj_id = "forged";
+    forged.total_bytes = 50;
+    forged.prefixes.push_back({chat.prefixes.hashes[4], chat.prefixes.fingerprints[4], 20, 40, 12345});
+    map.ApplyEvent(forged);
+    res = map.LookupContinuation(chat, {});
+    assert(res.hit && res.prefix_tokens == 16);
+    assert(map.FingerprintMismatches() == mismatches + 1);
+
+    // Short turns below the first block still extend the hash.
+    PrefixHandle tiny;
+    res = map.LookupContinuation(tiny, {"sys0", "sys1"});
+    assert(!res.hit && tiny.prefixes.lengths.empty());
+    res = map.LookupContinuation(tiny, {"sys2", "sys3"});
+    assert(res.hit && res.obj_id == turn2 && res.prefix_tokens == 4);
+
+    std::cout << "test_continuation passed\n";
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::EvictionConfig;
+using prompt_cache_poc::MetadataEvent;
+using prompt_cache_poc::MutationScope;
+using prompt_cache_poc::PrefixMap;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& tag, int n) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < n; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+} // namespace
+
+int main() {
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap map(4, 0, storage);
+
+    // Same bytes, longer prefix: more recompute saved per byte.
+    const std::string long_id = map.Store(Prompt("long", 64), std::vector<uint8_t>(100, 1), "r", 0);
+    const std::string short_id = map.Store(Prompt("short", 8), std::vector<uint8_t>(100, 2), "r", 0);
+    const std::string reused_id = map.Store(Prompt("reused", 8), std::vector<uint8_t>(100, 3), "r", 0);
+    assert(map.Score(long_id) > map.Score(short_id));
+    assert(map.StoredBytes() == 300);
+
+    // Observed reuse raises the score.
+    for (int i = 0; i < 4; ++i) {
+        assert(map.Lookup(Prompt("reused", 8)).hit);
+    }
+    assert(map.Score(reused_id) > map.Score(short_id));
+
+    std::vector<MetadataEvent> tombstones;
+    std::vector<MetadataEvent> replicated;
+    map.AddMutationListener([&](const MetadataEvent& event, MutationScope scope) {
+        if (event.type != MetadataEvent::Type::kTombstone) {
+            return;
+        }
+        if (scope == MutationScope::kLocalOnly) {
+            tombstones.push_back(event);
+        } else {
+            replicated.push_back(event);
+        }
+    });
+
+    EvictionConfig cfg;
+    cfg.capacity_bytes = 300;
+    cfg.low_watermark = 1.0;
+    map.SetEvictionConfig(cfg);
+    assert(map.EvictedObjects() == 0);
+
+    // The fourth object overflows the budget; the lowest score goes.
+    const std::string new_id = map.Store(Prompt("new", 8), std::vector<uint8_t>(100, 4), "r", 0);
+    assert(map.EvictedObjects() == 1);
+    assert(map.StoredBytes() == 300);
+    assert(!map.Lookup(Prompt("short", 8)).hit);
+    assert(map.Lookup(Prompt("long", 64)).hit);
+    assert(map.Lookup(Prompt("reused", 8)).hit);
+    assert(map.Lookup(Prompt("new", 8)).hit);
+    // The eviction is local only: not replicated, and the shared object stays.
+    assert(tombstones.size() == 1 && tombstones[0].obj_id == short_id);
+    assert(replicated.empty());
+    std::vector<uint8_t> out;
+    assert(storage->GetRange(short_id, 0, out));
+
+    // Replicated advertises past the budget do not evict; the next local
+    // advertise does.
+    MetadataEvent remote;
+    remote.obj_id = "remote";
+    remote.total_bytes = 100;
+    remote.prefixes.push_back({1234, 0, 8, 100, 0});
+    map.ApplyEvent(remote);
+    assert(map.EvictedObjects() == 1 && map.StoredBytes() == 400);
+    map.Store(Prompt("local", 8), std::vector<uint8_t>(100, 5), "r", 0);
+    assert(map.EvictedObjects() == 3 && map.StoredBytes() == 300);
+    assert(map.Lookup(Prompt("local", 8)).hit && map.Lookup(Prompt("long", 64)).hit);
+
+    // A higher per-model cost factor scales every score.
+    const double before = map.Score(long_id);
+    cfg.cost_factor = 4.0;
+    map.SetEvictionConfig(cfg);
+    assert(map.Score(long_id) > 3.9 * before);
+
+    // Shrinking the budget evicts down to the low watermark.
+    cfg.capacity_bytes = 200;
+    cfg.low_watermark = 0.5;
+    map.SetEvictionConfig(cfg);
+    assert(map.StoredBytes() <= 100);
+    assert(map.ObjectCount() == 1);
+    assert(replicated.empty());
+
+    // The cheapest objects go first, and only as many as the budget needs.
+    PrefixMap many(4, 0, storage);
+    for (int i = 0; i < 50; ++i) {
+        many.Store(Prompt("m" + std::to_string(i), 4 + 4 * (i % 10)), std::vector<uint8_t>(100, 10 + i), "r", 0);
+    }
+    cfg.capacity_bytes = 4000;
+    cfg.low_watermark = 1.0;
+    cfg.cost_factor = 1.0;
+    many.SetEvictionConfig(cfg);
+    assert(many.ObjectCount() == 40);
+    for (int i = 0; i < 50; ++i) {
+        // Shortest prefixes (4 and 8 tokens) score lowest.
+        assert(many.Lookup(Prompt("m" + std::to_string(i), 4 + 4 * (i % 10))).hit == (i % 10 >= 2));
+    }
+
+    std::cout << "test_eviction passed\n";
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "../src/kv_arena.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using prompt_cache_poc::ArenaStorage;
+using prompt_cache_poc::ByteRange;
+using prompt_cache_poc::KvArena;
+using prompt_cache_poc::PrefixMap;
+
+int main() {
+    KvArena::Config cfg;
+    cfg.tokens_per_column = 4;
+    cfg.bytes_per_token = 2;
+    cfg.region_bytes = 64 * 8;
+    cfg.huge_pages = false;
+    KvArena arena(cfg);
+    assert(arena.ColumnBytes() == 8);
+
+    // Reserved prompt lands in one extent and reads back with one copy.
+    assert(arena.ReserveSpace(1, 12));
+    for (uint8_t c = 0; c < 3; ++c) {
+        std::vector<uint8_t> col(8, c);
+        assert(arena.AppendColumn(1, col.data(), col.size()));
+    }
+    assert(arena.IsContiguous(1));
+    std::vector<uint8_t> out;
+    assert(arena.Read(1, 0, out));
+    assert(out.size() == 24);
+    assert(out[0] == 0 && out[8] == 1 && out[23] == 2);
+
+    // Interleaved appends without reservations fragment both prompts.
+    for (uint8_t c = 0; c < 3; ++c) {
+        std::vector<uint8_t> a(8, static_cast<uint8_t>(10 + c));
+        std::vector<uint8_t> b(8, static_cast<uint8_t>(20 + c));
+        assert(arena.AppendColumn(2, a.data(), a.size()));
+        assert(arena.AppendColumn(3, b.data(), b.size()));
+    }
+    assert(!arena.IsContiguous(2));
+    assert(arena.GetStats().fragmented_prompts == 2);
+
+    assert(arena.CompactOnce(std::chrono::milliseconds(0)) == 2);
+    assert(arena.IsContiguous(2));
+    assert(arena.IsContiguous(3));
+    assert(arena.Read(2, 2, out));
+    assert(out.size() == 16);
+    assert(out[0] == 10 && out[8] == 11);
+
+    // Growth after compaction stays contiguous when the next slot is free.
+    std::vector<uint8_t> more(8, 13);
+    assert(arena.AppendColumn(2, more.data(), more.size()));
+
+    arena.Truncate(3, 1);
+    assert(arena.ColumnCount(3) == 1);
+    arena.Release(1);
+    arena.Release(2);
+    arena.Release(3);
+    auto stats = arena.GetStats();
+    assert(stats.prompts == 0);
+    assert(stats.used_columns == 0);
+
+    // Reservations larger than a region are ignored, never fatal.
+    assert(!arena.ReserveSpace(4, 4 * 1000));
+
+    // Compaction copies without the lock; a prompt appended to meanwhile is
+    // left as it is rather than switched to a stale copy, and columns
+    // released meanwhile are not reused until the copy is done.
+    {
+        KvArena busy(cfg);
+        std::thread writer([&] {
+            for (int round = 0; round < 200; ++round) {
+                std::vector<uint8_t> a(8, static_cast<uint8_t>(round));
+                std::vector<uint8_t> b(8, static_cast<uint8_t>(round + 1));
+                assert(busy.AppendColumn(10, a.data(), a.size()));
+                assert(busy.AppendColumn(11, b.data(), b.size()));
+                if (busy.ColumnCount(10) >= 16) {
+                    busy.Release(10);
+                    busy.Release(11);
+                }
+            }
+        });
+        for (int i = 0; i < 200; ++i) {
+            busy.CompactOnce(std::chrono::milliseconds(0));
+        }
+        writer.join();
+        std::vector<uint8_t> cols;
+        const int n = busy.ColumnCount(10);
+        assert(n == 0 || busy.Read(10, 0, cols));
+        // Every column was written with a single byte value.
+        for (size_t i = 0; i < cols.size(); ++i) {
+            assert(cols[i] == cols[i / 8 * 8]);
+        }
+    }
+
+    // ArenaStorage: PrefixMap loads come from host memory after a Store.
+    {
+        auto backing = std::make_shared<MemStorage>();
+        KvArena::Config tier_cfg;
+        tier_cfg.tokens_per_column = 4;
+        tier_cfg.bytes_per_token = 4;
+        tier_cfg.region_bytes = 16 * 64;
+        tier_cfg.max_regions = 1;
+        tier_cfg.huge_pages = false;
+        auto tier = std::make_shared<ArenaStorage>(backing, tier_cfg);
+        PrefixMap map(4, 4, tier);
+
+        std::vector<std::string> tokens = {"a", "b", "c", "d", "e", "f", "g", "h", "i", "j"};
+        std::vector<uint8_t> payload(40);
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] = static_cast<uint8_t>(i);
+        }
+        const std::string obj_id = map.Store(tokens, payload, "owner", 0);
+        assert(!obj_id.empty());
+        assert(backing->puts == 1);
+
+        auto hit = map.Lookup(tokens);
+        assert(hit.hit);
+        std::vector<uint8_t> loaded;
+        assert(map.Load(hit.obj_id, hit.usable_len_bytes, loaded));
+        assert(loaded == std::vector<uint8_t>(payload.begin(), payload.begin() + hit.usable_len_bytes));
+        assert(map.Load(obj_id, 0, loaded));
+        assert(loaded == payload);
+        std::vector<std::vector<uint8_t>> parts;
+        assert(tier->GetRanges(obj_id, {ByteRange{3, 5}, ByteRange{37, 3}}, parts));
+        assert(parts[0][0] == 3 && parts[1][2] == 39);
+        assert(backing->gets == 0);
+        assert(tier->GetStats().hits == 3);
+
+        // Too big for the arena: written through, served by the backing store.
+        std::vector<uint8_t> big(4096, 7);
+        assert(tier->Put("big", big));
+        assert(tier->GetStats().cache_full == 1);
+        assert(tier->GetRange("big", 100, loaded) && loaded.size() == 100);
+        assert(backing->gets == 1);
+
+        assert(tier->Delete(obj_id));
+        assert(!tier->Exists(obj_id));
+        assert(tier->GetArenaStats().used_columns == 0);
+    }
+
+    std::cout << "test_kv_arena passed\n";
+    return 0;
+}
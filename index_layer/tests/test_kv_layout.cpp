@@ -0,0 +1,86 @@
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::ObjectLayout;
+using prompt_cache_poc::PrefixMap;
+
+int main() {
+    // 8 tokens, 4 buffers (d=0 K, d=0 V, d=1 K, d=1 V), 2 bytes per token each.
+    const int num_tokens = 8;
+    const int buffers = 4;
+    const int bpt = 2;
+    std::vector<std::string> tokens{"A", "B", "C", "D", "E", "F", "G", "H"};
+
+    // Buffer-major blob: byte value encodes (buffer, token).
+    std::vector<uint8_t> data;
+    for (int b = 0; b < buffers; ++b) {
+        for (int t = 0; t < num_tokens; ++t) {
+            for (int i = 0; i < bpt; ++i) {
+                data.push_back(static_cast<uint8_t>(b * 16 + t));
+            }
+        }
+    }
+
+    ObjectLayout layout;
+    layout.order = ObjectLayout::Order::kBufferMajor;
+    layout.buffer_bytes_per_token.assign(buffers, bpt);
+
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap cache(4, 0, storage);
+    std::string obj_id = cache.Store(tokens, data, layout, "replica-1", 1);
+    assert(!obj_id.empty());
+
+    std::vector<std::string> query{"A", "B", "C", "D", "X"};
+    auto hit = cache.Lookup(query, 0);
+    assert(hit.hit);
+    assert(hit.prefix_tokens == 4);
+    assert(hit.usable_len_bytes == 4 * buffers * bpt);
+
+    std::vector<std::vector<uint8_t>> out;
+    storage->gets = 0;
+    storage->bytes_read = 0;
+    assert(cache.LoadBuffers(obj_id, hit.prefix_tokens, out));
+    assert(storage->gets == 1);
+    assert(storage->bytes_read == static_cast<size_t>(4 * buffers * bpt));
+    assert(out.size() == static_cast<size_t>(buffers));
+    for (int b = 0; b < buffers; ++b) {
+        assert(out[b].size() == static_cast<size_t>(4 * bpt));
+        assert(out[b].front() == b * 16);
+        assert(out[b].back() == b * 16 + 3);
+    }
+
+    // Token-major blob: one contiguous prefix range, buffers strided.
+    std::vector<uint8_t> tm;
+    for (int t = 0; t < num_tokens; ++t) {
+        for (int b = 0; b < buffers; ++b) {
+            for (int i = 0; i < bpt; ++i) {
+                tm.push_back(static_cast<uint8_t>(b * 16 + t));
+            }
+        }
+    }
+    ObjectLayout tm_layout;
+    tm_layout.buffer_bytes_per_token.assign(buffers, bpt);
+    std::string tm_id = cache.Store(tokens, tm, tm_layout, "replica-1", 1);
+    assert(!tm_id.empty());
+    assert(tm_layout.FetchRanges(0, 4).size() == 1);
+    assert(cache.LoadBuffers(tm_id, 4, out));
+    for (int b = 0; b < buffers; ++b) {
+        assert(out[b].size() == static_cast<size_t>(4 * bpt));
+        assert(out[b][0] == b * 16);
+        assert(out[b][2] == b * 16 + 1);
+    }
+
+    // Layout that does not match the payload size is rejected.
+    ObjectLayout bad;
+    bad.buffer_bytes_per_token.assign(3, 1);
+    assert(cache.Store(tokens, data, bad, "replica-1", 1).empty());
+
+    std::cout << "test_kv_layout passed\n";
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "../src/metadata_bus.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using prompt_cache_poc::DecodeEvent;
+using prompt_cache_poc::EncodeEvent;
+using prompt_cache_poc::FileBroker;
+using prompt_cache_poc::MetadataBus;
+using prompt_cache_poc::MetadataEvent;
+using prompt_cache_poc::MutationScope;
+using prompt_cache_poc::PrefixMap;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& tag) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < 8; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+MetadataBus::Config BusConfig(const std::string& id) {
+    MetadataBus::Config cfg;
+    cfg.replica_id = id;
+    cfg.max_batch_events = 4;
+    return cfg;
+}
+
+} // namespace
+
+int main() {
+    // Codec round trip.
+    MetadataEvent ev;
+    ev.seq = 7;
+    ev.origin = "r1";
+    ev.origin_seq = 42;
+    ev.obj_id = "abc";
+    ev.total_bytes = 64;
+    ev.layout.order = prompt_cache_poc::ObjectLayout::Order::kBufferMajor;
+    ev.layout.num_tokens = 8;
+    ev.layout.buffer_bytes_per_token = {4, 4};
+    ev.owner_id = "owner";
+    ev.priority = 3;
+    ev.prefixes.push_back({1, 2, 4, 32, 9});
+    std::string wire;
+    EncodeEvent(ev, wire);
+    MetadataEvent back;
+    assert(DecodeEvent(reinterpret_cast<const uint8_t*>(wire.data()), wire.size(), back));
+    assert(back.seq == 7 && back.origin == "r1" && back.origin_seq == 42 && back.obj_id == "abc");
+    assert(back.layout.buffer_bytes_per_token.size() == 2 && back.priority == 3);
+    assert(back.prefixes.size() == 1 && back.prefixes[0].usable_len_bytes == 32 &&
+           back.prefixes[0].parent_hash == 9);
+    assert(!DecodeEvent(reinterpret_cast<const uint8_t*>(wire.data()), wire.size() - 1, back));
+
+    char path[] = "/tmp/test_metadata_bus_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    std::remove(path);
+
+    auto storage = std::make_shared<MemStorage>();
+    auto map_a = std::make_shared<PrefixMap>(4, 1, storage);
+    auto map_b = std::make_shared<PrefixMap>(4, 1, storage);
+    {
+        MetadataBus bus_a(map_a, std::make_shared<FileBroker>(path), BusConfig("a"));
+        MetadataBus bus_b(map_b, std::make_shared<FileBroker>(path), BusConfig("b"));
+
+        // A's store converges on B after publish + poll.
+        const std::string id = map_a->Store(Prompt("x"), std::vector<uint8_t>(8, 1), "a", 0);
+        assert(!map_b->Lookup(Prompt("x")).hit);
+        assert(bus_a.Flush());
+        assert(bus_b.Poll() == 1);
+        auto res = map_b->Lookup(Prompt("x"));
+        assert(res.hit && res.obj_id == id && res.prefix_tokens == 8);
+
+        // A's own events are not re-applied.
+        assert(bus_a.Poll() == 0);
+        assert(bus_a.GetStats().duplicates == 1);
+
+        // Tombstones remove every prefix of the object on peers.
+        assert(map_b->Tombstone(id));
+        assert(!map_b->Lookup(Prompt("x")).hit);
+        assert(bus_b.Flush());
+        assert(bus_a.Poll() == 1);
+        assert(!map_a->Lookup(Prompt("x")).hit);
+        assert(map_a->ObjectCount() == 0);
+
+        // A full batch is published without an explicit Flush.
+        for (int i = 0; i < 4; ++i) {
+            map_a->Store(Prompt("y" + std::to_string(i)), std::vector<uint8_t>(8, static_cast<uint8_t>(10 + i)), "a", 0);
+        }
+        assert(bus_a.GetStats().pending == 0);
+        assert(bus_b.Poll() == 4);
+        assert(map_b->Lookup(Prompt("y3")).hit);
+    }
+
+    // A late replica replays the whole log; replaying twice is idempotent.
+    auto map_c = std::make_shared<PrefixMap>(4, 1, storage);
+    MetadataBus bus_c(map_c, std::make_shared<FileBroker>(path), BusConfig("c"));
+    assert(bus_c.Poll() == 6);
+    assert(!map_c->Lookup(Prompt("x")).hit);
+    assert(map_c->Lookup(Prompt("y0")).hit);
+    assert(bus_c.GetStats().applied_seq == 6);
+    const size_t prefixes = map_c->PrefixCount();
+    auto broker = std::make_shared<FileBroker>(path);
+    std::vector<MetadataEvent> all;
+    assert(broker->Fetch(0, 100, all) && all.size() == 6);
+    for (const auto& event : all) {
+        map_c->ApplyEvent(event);
+    }
+    assert(map_c->PrefixCount() == prefixes);
+
+    // Bytes left past the commit point by a publisher that died mid-batch
+    // are dropped by the next publish.
+    fd = open(path, O_WRONLY | O_APPEND);
+    assert(fd >= 0);
+    assert(write(fd, "orphaned", 8) == 8);
+    close(fd);
+    std::vector<MetadataEvent> one(1);
+    one[0].type = MetadataEvent::Type::kTombstone;
+    one[0].origin = "z";
+    one[0].origin_seq = 1;
+    one[0].obj_id = "gone";
+    assert(broker->Publish(one) && one[0].seq == 7);
+    assert(broker->Fetch(6, 100, all) && all.size() == 1 && all[0].obj_id == "gone");
+
+    // Concurrent advertises and tombstones of one object reach the log in
+    // the order they were applied, so a replica replaying it agrees.
+    std::remove(path);
+    for (int round = 0; round < 20; ++round) {
+        auto src = std::make_shared<PrefixMap>(4, 1, storage);
+        auto dst = std::make_shared<PrefixMap>(4, 1, storage);
+        // Runs before the bus listener and widens the window between
+        // applying an event and publishing it.
+        src->AddMutationListener([](const MetadataEvent&, MutationScope) { std::this_thread::sleep_for(std::chrono::microseconds(20)); });
+        MetadataBus src_bus(src, std::make_shared<FileBroker>(path), BusConfig("src"));
+        MetadataBus dst_bus(dst, std::make_shared<FileBroker>(path), BusConfig("dst"));
+        const std::vector<uint8_t> payload(8, 5);
+        const std::string id = src->Store(Prompt("race"), payload, "src", 0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 50; ++i) {
+                    if ((i + t) % 2 == 0) {
+                        src->Store(Prompt("race"), payload, "src", 0);
+                    } else {
+                        src->Tombstone(id);
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        assert(src_bus.Flush());
+        dst_bus.Poll();
+        assert(dst->Lookup(Prompt("race")).hit == src->Lookup(Prompt("race")).hit);
+        std::remove(path);
+    }
+
+    std::remove(path);
+    std::cout << "test_metadata_bus passed\n";
+    return 0;
+}
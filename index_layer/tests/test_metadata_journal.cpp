@@ -0,0 +1,187 @@
+#include "../src/metadata_journal.h"
+#include "mem_storage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using prompt_cache_poc::MetadataEvent;
+using prompt_cache_poc::MetadataJournal;
+using prompt_cache_poc::PrefixMap;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& tag) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < 8; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+std::vector<uint8_t> Payload(int i) {
+    return std::vector<uint8_t>(8, static_cast<uint8_t>(i));
+}
+
+off_t FileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+std::string SegmentPath(const std::string& dir, const MetadataJournal& journal) {
+    return dir + "/journal." + std::to_string(journal.GetStats().segment);
+}
+
+} // namespace
+
+int main() {
+    char tmpl[] = "/tmp/test_metadata_journal_XXXXXX";
+    const std::string dir = mkdtemp(tmpl);
+    auto storage = std::make_shared<MemStorage>();
+    MetadataJournal::Config cfg;
+    cfg.dir = dir;
+    cfg.compact_bytes = 0;
+
+    // Mutations survive a restart.
+    std::string tomb_id;
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        MetadataJournal journal(map, cfg);
+        for (int i = 0; i < 3; ++i) {
+            assert(!map->Store(Prompt("p" + std::to_string(i)), Payload(i), "r", 0).empty());
+        }
+        tomb_id = map->Lookup(Prompt("p1")).obj_id;
+        assert(map->Tombstone(tomb_id));
+        auto stats = journal.GetStats();
+        assert(stats.appended == 4 && stats.last_seq == 4 && stats.commits >= 1);
+
+        std::vector<MetadataEvent> feed;
+        assert(journal.ReadSince(2, 100, feed) && feed.size() == 2);
+        assert(feed[1].type == MetadataEvent::Type::kTombstone && feed[1].obj_id == tomb_id);
+    }
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        MetadataJournal journal(map, cfg);
+        assert(journal.GetStats().replayed == 4);
+        assert(map->Lookup(Prompt("p0")).hit);
+        assert(!map->Lookup(Prompt("p1")).hit);
+        assert(map->Lookup(Prompt("p2")).prefix_tokens == 8);
+
+        // Compaction folds the journal into a snapshot and starts a new
+        // segment; the old one is deleted.
+        const std::string old_segment = SegmentPath(dir, journal);
+        assert(journal.Compact());
+        assert(journal.GetStats().journal_bytes == 0);
+        assert(FileSize(old_segment) == -1);
+        assert(FileSize(SegmentPath(dir, journal)) == 0);
+        std::vector<MetadataEvent> feed;
+        assert(!journal.ReadSince(0, 100, feed));
+        assert(!map->Store(Prompt("p3"), Payload(3), "r", 0).empty());
+        assert(journal.ReadSince(4, 100, feed) && feed.size() == 1 && feed[0].seq == 5);
+    }
+
+    // A torn tail record is dropped and truncated on replay.
+    std::string segment;
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        segment = SegmentPath(dir, MetadataJournal(map, cfg));
+    }
+    const off_t good = FileSize(segment);
+    {
+        const int fd = open(segment.c_str(), O_WRONLY | O_APPEND);
+        const char junk[] = "\x30\x00\x00\x00garbage";
+        assert(write(fd, junk, sizeof(junk) - 1) > 0);
+        close(fd);
+    }
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        MetadataJournal journal(map, cfg);
+        assert(journal.GetStats().replayed == 3); // two snapshot objects + p3
+        assert(FileSize(segment) == good);
+        assert(map->Lookup(Prompt("p0")).hit && map->Lookup(Prompt("p3")).hit);
+        assert(!map->Lookup(Prompt("p1")).hit);
+        assert(journal.GetStats().last_seq == 5);
+    }
+
+    // Concurrent appenders share group commits; auto-compaction keeps the
+    // journal bounded.
+    cfg.compact_bytes = 4096;
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        MetadataJournal journal(map, cfg);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&map, t] {
+                for (int i = 0; i < 50; ++i) {
+                    map->Store(Prompt("t" + std::to_string(t) + "_" + std::to_string(i)), Payload(t * 50 + i + 10), "r", 0);
+                }
+            });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+        auto stats = journal.GetStats();
+        assert(stats.appended == 200);
+        assert(stats.commits <= stats.appended);
+        assert(stats.compactions > 0);
+        assert(stats.journal_bytes < 4096 + 1024);
+
+        // The feed since the last snapshot is complete and in order.
+        std::vector<MetadataEvent> feed;
+        assert(journal.ReadSince(stats.base_seq, 1000, feed));
+        assert(feed.size() == stats.last_seq - stats.base_seq);
+        for (size_t i = 0; i < feed.size(); ++i) {
+            assert(feed[i].seq == stats.base_seq + 1 + i);
+        }
+        const uint64_t mid = stats.base_seq + feed.size() / 2;
+        assert(journal.ReadSince(mid, 2, feed) && feed.size() == std::min<uint64_t>(2, stats.last_seq - mid));
+        assert(feed.empty() || feed[0].seq == mid + 1);
+    }
+
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        MetadataJournal journal(map, cfg);
+        assert(map->ObjectCount() == 203);
+        assert(map->Lookup(Prompt("t3_49")).hit);
+    }
+
+    // ReadSince starts from the offset index: a feed deep into a large
+    // segment matches a full scan.
+    cfg.compact_bytes = 0;
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        MetadataJournal journal(map, cfg);
+        const uint64_t first = journal.GetStats().last_seq;
+        for (int i = 0; i < 2000; ++i) {
+            map->Store(Prompt("s" + std::to_string(i)), Payload(i + 300), "r", 0);
+        }
+        const uint64_t last = journal.GetStats().last_seq;
+        assert(last >= first + 2000);
+        assert(journal.GetStats().journal_bytes > (64u << 10) * 2);
+        std::vector<MetadataEvent> feed;
+        assert(journal.ReadSince(first + 1500, 10, feed) && feed.size() == 10);
+        for (size_t i = 0; i < feed.size(); ++i) {
+            assert(feed[i].seq == first + 1501 + i);
+        }
+        assert(journal.ReadSince(last - 1, 10, feed) && feed.size() == 1 && feed[0].seq == last);
+        assert(journal.ReadSince(last, 10, feed) && feed.empty());
+    }
+    {
+        auto map = std::make_shared<PrefixMap>(4, 1, storage);
+        std::remove(SegmentPath(dir, MetadataJournal(map, cfg)).c_str());
+    }
+    std::remove((dir + "/snapshot").c_str());
+    rmdir(dir.c_str());
+    std::cout << "test_metadata_journal passed\n";
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "../src/multi_cache_index.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::MultiCacheIndex;
+using prompt_cache_poc::PrefixMap;
+
+int main() {
+    auto target_storage = std::make_shared<MemStorage>();
+    auto draft_storage = std::make_shared<MemStorage>();
+    auto target = std::make_shared<PrefixMap>(4, 1, target_storage);
+    auto draft = std::make_shared<PrefixMap>(4, 1, draft_storage);
+
+    std::vector<std::string> tokens;
+    for (int i = 0; i < 16; ++i) {
+        tokens.push_back("t" + std::to_string(i));
+    }
+    std::vector<std::string> target_tokens(tokens.begin(), tokens.begin() + 12);
+    std::vector<std::string> draft_tokens(tokens.begin(), tokens.begin() + 8);
+    assert(!target->Store(target_tokens, std::vector<uint8_t>(12, 1), "r", 0).empty());
+    assert(!draft->Store(draft_tokens, std::vector<uint8_t>(8, 2), "r", 0).empty());
+
+    MultiCacheIndex index;
+    index.AddCache(0, target);
+    index.AddCache(1, draft);
+    assert(index.CacheCount() == 2);
+
+    auto res = index.Lookup(tokens);
+    assert(res.per_cache.size() == 2);
+    assert(res.per_cache[0].hit && res.per_cache[0].prefix_tokens == 12);
+    assert(res.per_cache[1].hit && res.per_cache[1].prefix_tokens == 8);
+    assert(res.joint_prefix_tokens == 8);
+
+    // Same answers as per-cache lookups.
+    assert(target->Lookup(tokens).prefix_tokens == 12);
+    assert(draft->Lookup(tokens).prefix_tokens == 8);
+
+    // A miss in any cache means nothing is jointly usable.
+    auto cold = std::make_shared<PrefixMap>(4, 1, std::make_shared<MemStorage>());
+    index.AddCache(2, cold);
+    res = index.Lookup(tokens);
+    assert(!res.per_cache[2].hit);
+    assert(res.joint_prefix_tokens == 0);
+
+    std::cout << "test_multi_cache_index passed\n";
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::HashPrefixes;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::TokenHasher;
+
+int main() {
+    // Streaming hashes match hashing each prefix from scratch.
+    std::vector<std::string> tokens = {"alpha", "beta", "gamma", "delta"};
+    auto prefixes = HashPrefixes(tokens, {1, 2, 4});
+    assert(prefixes.lengths.size() == 3);
+    TokenHasher h;
+    h.Update("alpha");
+    h.Update("beta");
+    assert(prefixes.IndexOf(2) == 1);
+    assert(prefixes.hashes[1] == h.Value());
+    assert(prefixes.fingerprints[1] == h.Fingerprint());
+    assert(prefixes.IndexOf(3) == -1);
+
+    // ["a", "b"] and ["a\x1fb"] hash to the same primary key; the
+    // fingerprint must keep them apart.
+    TokenHasher two;
+    two.Update("a");
+    two.Update("b");
+    TokenHasher one;
+    one.Update(std::string("a\x1f" "b"));
+    assert(two.Value() == one.Value());
+    assert(two.Fingerprint() != one.Fingerprint());
+
+    // Same token count and joined bytes, split differently: only the
+    // length-prefixed fingerprint stream tells them apart.
+    TokenHasher left;
+    left.Update(std::string("a\x1f" "b"));
+    left.Update("c");
+    TokenHasher right;
+    right.Update("a");
+    right.Update(std::string("b\x1f" "c"));
+    assert(left.Value() == right.Value());
+    assert(left.Fingerprint() != right.Fingerprint());
+
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap map(1, 1, storage);
+    assert(!map.Store({"a", "b"}, std::vector<uint8_t>(2, 7), "r", 0).empty());
+    auto res = map.Lookup({std::string("a\x1f" "b")});
+    assert(!res.hit);
+    assert(map.FingerprintMismatches() == 1);
+    res = map.Lookup({"a", "b"});
+    assert(res.hit && res.prefix_tokens == 2);
+
+    // Same primary hash but a different fingerprint is a miss.
+    auto forged = HashPrefixes({"a", "b"}, {1, 2});
+    forged.fingerprints[1] ^= 1;
+    res = map.LookupHashed(forged, 2);
+    assert(res.hit && res.prefix_tokens == 1);
+    assert(map.FingerprintMismatches() == 2);
+
+    std::cout << "test_prefix_hash passed\n";
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "../src/cache.h"
+#include "../src/shm_prefix_index.h"
+#include "mem_storage.h"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using prompt_cache_poc::LookupResult;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::ShmPrefixIndex;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& tag, int n) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < n; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+bool Same(const LookupResult& a, const LookupResult& b) {
+    return a.hit == b.hit && a.obj_id == b.obj_id && a.prefix_tokens == b.prefix_tokens &&
+           a.usable_len_bytes == b.usable_len_bytes;
+}
+
+} // namespace
+
+int main() {
+    const std::string name = "/pcpoc_test_" + std::to_string(getpid());
+    ShmPrefixIndex::Unlink(name);
+
+    auto storage = std::make_shared<MemStorage>();
+    auto map = std::make_shared<PrefixMap>(4, 2, storage);
+    const std::string before = map->Store(Prompt("before", 12), std::vector<uint8_t>(24, 1), "r", 0);
+
+    ShmPrefixIndex::Config cfg;
+    cfg.slots = 1000;
+    auto writer = std::make_unique<ShmPrefixIndex>(name, map, cfg);
+    assert(writer->GetStats().slots == 1024);
+    assert(writer->GetStats().live == 3);
+
+    // Only one writer per segment.
+    bool threw = false;
+    try {
+        ShmPrefixIndex second(name, map, cfg);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    ShmPrefixIndex reader(name);
+    assert(!reader.Retired());
+    const std::string after = map->Store(Prompt("after", 9), std::vector<uint8_t>(18, 2), "r", 0);
+    for (const auto& tokens : {Prompt("before", 12), Prompt("before", 6), Prompt("after", 9),
+                               Prompt("miss", 8)}) {
+        assert(Same(reader.Lookup(tokens), map->Lookup(tokens)));
+    }
+    assert(reader.Lookup(Prompt("before", 12)).obj_id == before);
+    assert(reader.Lookup(Prompt("after", 9)).prefix_tokens == 8);
+
+    // Another process sees the same index through its own mapping.
+    const pid_t pid = fork();
+    if (pid == 0) {
+        ShmPrefixIndex child(name);
+        const LookupResult res = child.Lookup(Prompt("after", 9));
+        _exit(res.hit && res.obj_id == after && res.prefix_tokens == 8 ? 0 : 1);
+    }
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    assert(map->Tombstone(after));
+    assert(!reader.Lookup(Prompt("after", 9)).hit);
+    assert(reader.Lookup(Prompt("before", 12)).hit);
+
+    // Lock-free readers race the writer: every answer is a miss or a full
+    // prefix of an object that was stored for it, and an object that stays
+    // put is never missed, not even while a rebuild is published.
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> bad{0};
+    std::atomic<uint64_t> missed{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&] {
+            ShmPrefixIndex local(name);
+            while (!stop.load()) {
+                for (int i = 0; i < 1000; i += 7) {
+                    const LookupResult res = local.Lookup(Prompt("churn" + std::to_string(i), 8));
+                    if (res.hit && (res.prefix_tokens % 4 != 0 || res.obj_id.size() != before.size())) {
+                        bad++;
+                    }
+                }
+                if (local.Lookup(Prompt("before", 12)).obj_id != before) {
+                    missed++;
+                }
+            }
+        });
+    }
+    for (int round = 0; round < 50; ++round) {
+        std::vector<std::string> ids;
+        for (int i = 0; i < 20; ++i) {
+            ids.push_back(map->Store(Prompt("churn" + std::to_string(round * 20 + i), 8),
+                                     std::vector<uint8_t>(16, static_cast<uint8_t>(round + i)), "r", 0));
+        }
+        for (const auto& id : ids) {
+            map->Tombstone(id);
+        }
+    }
+    stop = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    assert(bad == 0);
+    assert(missed == 0);
+    // Churn tombstones forced rebuilds; the survivors are intact.
+    assert(writer->GetStats().rebuilds > 0);
+    assert(writer->GetStats().live == 3);
+    assert(writer->GetStats().deleted <= 256);
+    assert(reader.Lookup(Prompt("before", 12)).obj_id == before);
+
+    // A new writer retires the old segment; open readers notice and reopen.
+    writer.reset();
+    assert(!reader.Retired());
+    ShmPrefixIndex replacement(name, map, cfg);
+    assert(reader.Retired());
+    ShmPrefixIndex reopened(name);
+    assert(!reopened.Retired());
+    assert(reopened.Lookup(Prompt("before", 12)).obj_id == before);
+
+    ShmPrefixIndex::Unlink(name);
+    threw = false;
+    try {
+        ShmPrefixIndex missing(name);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "test_shm_prefix_index passed\n";
+    return 0;
+}
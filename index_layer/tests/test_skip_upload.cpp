@@ -0,0 +1,79 @@
+#include "../src/bloom_filter.h"
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::BloomFilter;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::WriteBehindQueue;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& tag, int n) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < n; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+} // namespace
+
+int main() {
+    BloomFilter filter(1000, 0.01);
+    for (int i = 0; i < 1000; ++i) {
+        filter.Add("obj" + std::to_string(i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        assert(filter.MayContain("obj" + std::to_string(i)));
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        false_positives += filter.MayContain("other" + std::to_string(i)) ? 1 : 0;
+    }
+    assert(false_positives < 300);
+
+    // Same payload under a different prompt: one PUT, both prompts advertised.
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap map(4, 1, storage);
+    const std::vector<uint8_t> system_kv(8, 42);
+    const std::string id = map.Store(Prompt("a", 8), system_kv, "r", 0);
+    assert(map.Store(Prompt("b", 8), system_kv, "r", 0) == id);
+    assert(storage->puts == 1);
+    assert(map.SkippedPuts() == 1);
+    assert(map.Lookup(Prompt("b", 8)).hit);
+
+    // Objects uploaded by a peer: the filter hit is confirmed with Exists.
+    PrefixMap peer(4, 1, storage);
+    peer.NoteRemoteObject(id);
+    const size_t heads = storage->heads;
+    assert(peer.Store(Prompt("c", 8), system_kv, "r", 0) == id);
+    assert(storage->heads == heads + 1);
+    assert(storage->puts == 1);
+
+    // A stale filter entry falls back to the upload.
+    assert(storage->Delete(id));
+    PrefixMap stale(4, 1, storage);
+    stale.NoteRemoteObject(id);
+    assert(stale.Store(Prompt("d", 8), system_kv, "r", 0) == id);
+    assert(storage->puts == 2);
+    assert(stale.SkippedPuts() == 0);
+
+    // Write-behind: known objects are advertised without being queued.
+    PrefixMap wb(4, 1, storage);
+    wb.EnableWriteBehind(WriteBehindQueue::Config{});
+    assert(wb.Store(Prompt("e", 8), system_kv, "r", 0) == id);
+    wb.FlushWriteBehind();
+    assert(wb.Store(Prompt("f", 8), system_kv, "r", 0) == id);
+    assert(wb.Lookup(Prompt("f", 8)).hit);
+    assert(wb.GetWriteBehindStats().enqueued == 1);
+    assert(storage->puts == 3);
+
+    std::cout << "test_skip_upload passed\n";
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "../src/cache.h"
+#include "../src/swa_planner.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using prompt_cache_poc::PlanSwaRefill;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::RefillPlan;
+using prompt_cache_poc::SwaConfig;
+using prompt_cache_poc::SwaPrefixLengths;
+
+int main() {
+    // Design doc example: window 100 (3 sink tokens), column 10.
+    SwaConfig swa;
+    swa.window_tokens = 100;
+    swa.sink_tokens = 3;
+
+    auto lengths = SwaPrefixLengths(swa, 10, 140);
+    std::vector<int> expected_tail{100, 107, 117, 127, 137};
+    assert(lengths.size() == 14);
+    assert(std::vector<int>(lengths.end() - 5, lengths.end()) == expected_tail);
+
+    auto spans = PlanSwaRefill(swa, 137);
+    assert(spans.size() == 3);
+    assert(spans[0].first == 0 && spans[0].count == 3);
+    assert(spans[1].first == 100 && spans[1].count == 37);
+    assert(spans[2].first == 40 && spans[2].count == 60);
+
+    assert(PlanSwaRefill(swa, 80).size() == 1);
+
+    // End to end through PrefixMap: only the window bytes are fetched.
+    std::vector<std::string> tokens;
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 140; ++i) {
+        tokens.push_back("t" + std::to_string(i));
+        data.push_back(static_cast<uint8_t>(i));
+    }
+
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap cache(10, 1, storage);
+    cache.SetSwaConfig(swa);
+    std::string obj_id = cache.Store(tokens, data, "replica-1", 1);
+    assert(!obj_id.empty());
+    assert(cache.PrefixCount() == 14);
+
+    auto hit = cache.Lookup(tokens, 0);
+    assert(hit.hit);
+    assert(hit.prefix_tokens == 137);
+
+    RefillPlan plan;
+    assert(cache.PlanRefill(obj_id, hit.prefix_tokens, plan));
+    assert(plan.glued_tokens == 100);
+    assert(plan.bytes == 100);
+
+    std::vector<std::vector<uint8_t>> out;
+    storage->bytes_read = 0;
+    assert(cache.LoadRefill(obj_id, plan, out));
+    assert(storage->bytes_read == 100);
+    assert(out.size() == 1 && out[0].size() == 100);
+    assert(out[0][0] == 0 && out[0][2] == 2);
+    assert(out[0][3] == 100 && out[0][39] == 136);
+    assert(out[0][40] == 40 && out[0][99] == 99);
+
+    bool threw = false;
+    try {
+        SwaConfig bad;
+        bad.window_tokens = 95;
+        cache.SetSwaConfig(bad);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "test_swa_planner passed\n";
+    return 0;
+}
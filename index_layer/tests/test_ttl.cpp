@@ -0,0 +1,173 @@
+#include "../src/cache.h"
+#include "../src/timing_wheel.h"
+#include "mem_storage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using prompt_cache_poc::MetadataEvent;
+using prompt_cache_poc::MutationScope;
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::TimingWheel;
+using prompt_cache_poc::TtlConfig;
+using prompt_cache_poc::TtlMode;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::vector<std::string> Prompt(const std::string& tag, int n) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < n; ++t) {
+        tokens.push_back(tag + std::to_string(t));
+    }
+    return tokens;
+}
+
+bool Contains(const std::vector<std::string>& keys, const std::string& key) {
+    return std::find(keys.begin(), keys.end(), key) != keys.end();
+}
+
+void TestWheel() {
+    const auto start = std::chrono::steady_clock::now();
+    TimingWheel wheel(1ms, start);
+    // One deadline per level, plus one already overdue.
+    wheel.Schedule("l0", start + 5ms);
+    wheel.Schedule("l1", start + 100ms);
+    wheel.Schedule("l2", start + 5000ms);
+    wheel.Schedule("l3", start + 300000ms);
+    wheel.Schedule("late", start - 1ms);
+    assert(wheel.Size() == 5);
+
+    std::vector<std::string> fired;
+    wheel.Advance(start + 1ms, fired);
+    assert(fired.size() == 1 && fired[0] == "late");
+
+    fired.clear();
+    wheel.Advance(start + 4ms, fired);
+    assert(fired.empty());
+    wheel.Advance(start + 5ms, fired);
+    assert(fired.size() == 1 && fired[0] == "l0");
+
+    fired.clear();
+    wheel.Advance(start + 99ms, fired);
+    assert(fired.empty());
+    wheel.Advance(start + 100ms, fired);
+    assert(fired.size() == 1 && fired[0] == "l1");
+
+    fired.clear();
+    wheel.Advance(start + 4999ms, fired);
+    assert(fired.empty());
+    wheel.Advance(start + 5000ms, fired);
+    assert(fired.size() == 1 && fired[0] == "l2");
+
+    fired.clear();
+    wheel.Advance(start + 299999ms, fired);
+    assert(fired.empty());
+    wheel.Advance(start + 300000ms, fired);
+    assert(fired.size() == 1 && fired[0] == "l3");
+    assert(wheel.Size() == 0);
+
+    // Scheduled relative to a clock that has moved on.
+    wheel.Schedule("later", start + 300070ms);
+    fired.clear();
+    wheel.Advance(start + 300069ms, fired);
+    assert(fired.empty());
+    wheel.Advance(start + 300070ms, fired);
+    assert(Contains(fired, "later"));
+
+    bool threw = false;
+    try {
+        TimingWheel bad(0ms, start);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void TestExpiry() {
+    auto storage = std::make_shared<MemStorage>();
+    PrefixMap map(4, 0, storage);
+
+    // Stored before TTL is enabled: picked up by SetTtlConfig.
+    const std::string early = map.Store(Prompt("early", 8), std::vector<uint8_t>(16, 1), "r", 0);
+
+    TtlConfig cfg;
+    cfg.mode = TtlMode::kAbsolute;
+    cfg.ttl = 300ms;
+    cfg.tick = 10ms;
+    map.SetTtlConfig(cfg);
+
+    std::vector<std::string> tombstones;
+    int replicated = 0;
+    map.AddMutationListener([&](const MetadataEvent& event, MutationScope scope) {
+        if (event.type != MetadataEvent::Type::kTombstone) {
+            return;
+        }
+        // Expiry is local only: sliding deadlines see only this map's hits.
+        if (scope == MutationScope::kLocalOnly) {
+            tombstones.push_back(event.obj_id);
+        } else {
+            replicated++;
+        }
+    });
+
+    const std::string absolute = map.Store(Prompt("abs", 8), std::vector<uint8_t>(16, 2), "r", 0);
+    const std::string sliding = map.Store(Prompt("slide", 8), std::vector<uint8_t>(16, 3), "r", 0);
+    const std::string pinned = map.Store(Prompt("pin", 8), std::vector<uint8_t>(16, 4), "r", 0);
+    assert(map.SetObjectTtl(sliding, TtlMode::kSliding, 300ms));
+    assert(map.SetObjectTtl(pinned, TtlMode::kNone, 0ms));
+    assert(!map.SetObjectTtl("missing", TtlMode::kSliding, 1s));
+    assert(map.ExpireDue() == 0);
+
+    // Hits refresh the sliding deadline but not the absolute one.
+    std::this_thread::sleep_for(200ms);
+    assert(map.Lookup(Prompt("abs", 8)).hit);
+    assert(map.Lookup(Prompt("slide", 8)).hit);
+    const auto touched = std::chrono::steady_clock::now();
+
+    assert(map.ExpireDue(touched + 150ms) == 2);
+    assert(map.ExpiredObjects() == 2);
+    assert(Contains(tombstones, early) && Contains(tombstones, absolute));
+    assert(!map.Lookup(Prompt("abs", 8)).hit);
+    assert(map.Lookup(Prompt("slide", 8)).hit);
+
+    assert(map.ExpireDue(touched + 400ms) == 1);
+    assert(Contains(tombstones, sliding));
+    assert(!map.Lookup(Prompt("slide", 8)).hit);
+
+    // kNone never expires.
+    assert(map.ExpireDue(touched + 3600s) == 0);
+    assert(map.Lookup(Prompt("pin", 8)).hit);
+    assert(replicated == 0);
+    assert(map.ObjectCount() == 1);
+
+    // Re-storing expired content starts a fresh lifetime.
+    assert(map.Store(Prompt("abs", 8), std::vector<uint8_t>(16, 2), "r", 0) == absolute);
+    assert(map.Lookup(Prompt("abs", 8)).hit);
+
+    bool threw = false;
+    try {
+        TtlConfig bad;
+        bad.mode = TtlMode::kSliding;
+        map.SetTtlConfig(bad);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+} // namespace
+
+int main() {
+    TestWheel();
+    TestExpiry();
+    std::cout << "test_ttl passed\n";
+    return 0;
+}
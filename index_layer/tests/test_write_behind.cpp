@@ -0,0 +1,140 @@
+#include "../src/cache.h"
+#include "mem_storage.h"
+
+#include <cassert>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using prompt_cache_poc::PrefixMap;
+using prompt_cache_poc::WriteBehindQueue;
+
+namespace {
+
+// Holds every Put until Open() so tests can observe the queued state.
+class GatedStorage final : public prompt_cache_poc::Storage {
+public:
+    bool Put(const std::string& obj_id, const std::vector<uint8_t>& data) override {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return open_; });
+        lock.unlock();
+        return fail_ ? false : inner_.Put(obj_id, data);
+    }
+    bool GetRange(const std::string& obj_id, int max_bytes, std::vector<uint8_t>& out) const override {
+        return inner_.GetRange(obj_id, max_bytes, out);
+    }
+    bool Delete(const std::string& obj_id) override { return inner_.Delete(obj_id); }
+    size_t Size() const override { return inner_.Size(); }
+
+    void Open() {
+        std::lock_guard<std::mutex> lock(mu_);
+        open_ = true;
+        cv_.notify_all();
+    }
+
+    bool fail_ = false;
+
+private:
+    MemStorage inner_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool open_ = false;
+};
+
+std::vector<std::string> Prompt(int id) {
+    std::vector<std::string> tokens;
+    for (int t = 0; t < 8; ++t) {
+        tokens.push_back("p" + std::to_string(id) + "_" + std::to_string(t));
+    }
+    return tokens;
+}
+
+} // namespace
+
+int main() {
+    // Prefixes become visible only once the PUT has completed.
+    {
+        auto storage = std::make_shared<GatedStorage>();
+        PrefixMap map(4, 1, storage);
+        WriteBehindQueue::Config cfg;
+        cfg.threads = 1;
+        map.EnableWriteBehind(cfg);
+
+        const std::string obj_id = map.Store(Prompt(0), std::vector<uint8_t>(8, 1), "r", 0);
+        assert(!obj_id.empty());
+        assert(!map.Lookup(Prompt(0)).hit);
+        assert(map.ObjectCount() == 0);
+
+        storage->Open();
+        map.FlushWriteBehind();
+        auto res = map.Lookup(Prompt(0));
+        assert(res.hit && res.obj_id == obj_id && res.prefix_tokens == 8);
+        auto stats = map.GetWriteBehindStats();
+        assert(stats.enqueued == 1 && stats.uploaded == 1 && stats.queued_items == 0);
+    }
+
+    // Failed uploads are never advertised.
+    {
+        auto storage = std::make_shared<GatedStorage>();
+        storage->fail_ = true;
+        storage->Open();
+        PrefixMap map(4, 1, storage);
+        map.EnableWriteBehind(WriteBehindQueue::Config{});
+        assert(!map.Store(Prompt(1), std::vector<uint8_t>(8, 1), "r", 0).empty());
+        map.FlushWriteBehind();
+        assert(!map.Lookup(Prompt(1)).hit);
+        assert(map.GetWriteBehindStats().failed == 1);
+    }
+
+    // Drop policies under a full byte budget. The single worker holds one job
+    // in flight, so the queue itself has room for two 8-byte payloads.
+    for (auto policy : {WriteBehindQueue::FullPolicy::kDropNewest, WriteBehindQueue::FullPolicy::kDropOldest}) {
+        auto storage = std::make_shared<GatedStorage>();
+        PrefixMap map(4, 1, storage);
+        WriteBehindQueue::Config cfg;
+        cfg.threads = 1;
+        cfg.max_queue_bytes = 16;
+        cfg.policy = policy;
+        map.EnableWriteBehind(cfg);
+
+        assert(!map.Store(Prompt(0), std::vector<uint8_t>(8, 0), "r", 0).empty());
+        while (map.GetWriteBehindStats().queued_items != 0) {
+            std::this_thread::yield();
+        }
+        assert(!map.Store(Prompt(1), std::vector<uint8_t>(8, 1), "r", 0).empty());
+        assert(!map.Store(Prompt(2), std::vector<uint8_t>(8, 2), "r", 0).empty());
+        const bool accepted = !map.Store(Prompt(3), std::vector<uint8_t>(8, 3), "r", 0).empty();
+        assert(accepted == (policy == WriteBehindQueue::FullPolicy::kDropOldest));
+        // Larger than the whole budget: always rejected.
+        assert(map.Store(Prompt(4), std::vector<uint8_t>(32, 4), "r", 0).empty());
+
+        storage->Open();
+        map.FlushWriteBehind();
+        assert(map.Lookup(Prompt(0)).hit);
+        assert(map.Lookup(Prompt(2)).hit);
+        assert(map.Lookup(Prompt(1)).hit == (policy == WriteBehindQueue::FullPolicy::kDropNewest));
+        assert(map.Lookup(Prompt(3)).hit == (policy == WriteBehindQueue::FullPolicy::kDropOldest));
+        assert(map.GetWriteBehindStats().dropped == 2);
+    }
+
+    // Destruction drains accepted uploads.
+    {
+        auto storage = std::make_shared<GatedStorage>();
+        storage->Open();
+        {
+            PrefixMap map(4, 1, storage);
+            map.EnableWriteBehind(WriteBehindQueue::Config{});
+            for (int i = 0; i < 16; ++i) {
+                assert(!map.Store(Prompt(i), std::vector<uint8_t>(8, static_cast<uint8_t>(i)), "r", 0).empty());
+            }
+        }
+        assert(storage->Size() == 16);
+    }
+
+    std::cout << "test_write_behind passed\n";
+    return 0;
+}
@@ -19,8 +19,9 @@ using tcp = asio::ip::tcp;
 
 class Session : public std::enable_shared_from_this<Session> {
 public:
-  Session(tcp::socket socket, s3::Api& api, std::size_t max_body, Metrics* metrics)
-    : socket_(std::move(socket)), api_(api), max_body_(max_body), metrics_(metrics) {}
+  Session(tcp::socket socket, s3::Api& api, const Config& cfg)
+    : socket_(std::move(socket)), api_(api), max_body_(cfg.max_request_body_bytes),
+      metrics_(cfg.metrics), storage_(cfg.storage), render_metrics_(cfg.render_metrics) {}
 
   void run() {
     beast::error_code ec;
@@ -49,16 +50,34 @@ private:
 
     if (req.method() == http::verb::get &&
         std::string_view(req.target().data(), req.target().size()) == "/metrics") {
-      const std::string body = metrics_ ? metrics_->RenderPrometheus() : std::string();
+      const std::string body = render_metrics_ ? render_metrics_()
+                               : metrics_ ? metrics_->RenderPrometheus() : std::string();
       res_ = s3::Response{http::status::ok, req.version()};
       res_.set(http::field::content_type, "text/plain; version=0.0.4");
       res_.keep_alive(req.keep_alive());
-      res_.body().assign(body.begin(), body.end());
+      res_.body().assign(body);
       res_.content_length(res_.body().size());
+    } else if (storage_) {
+      // The request stays in parser_ and the socket idle until the storage
+      // thread posts the response back to this session's strand.
+      auto self = shared_from_this();
+      const bool queued = storage_->try_post([self] {
+        s3::Response res = self->api_.handle(self->parser_->get());
+        asio::post(self->socket_.get_executor(), [self, res = std::move(res)]() mutable {
+          self->res_ = std::move(res);
+          self->do_write();
+        });
+      });
+      if (queued) return;
+      res_ = api_.busy(req);
     } else {
       res_ = api_.handle(req);
     }
+    do_write();
+  }
 
+  void do_write() {
+    const auto& req = parser_->get();
     if (metrics_) {
       stats_.method.assign(req.method_string().data(), req.method_string().size());
       stats_.status = res_.result_int();
@@ -99,6 +118,8 @@ private:
   std::optional<http::request_parser<s3::Request::body_type>> parser_;
   s3::Response res_;
   Metrics* metrics_ = nullptr;
+  StorageExecutor* storage_ = nullptr;
+  std::function<std::string()> render_metrics_;
   std::chrono::steady_clock::time_point request_start_{};
   struct RequestStats {
     std::string method;
@@ -115,6 +136,12 @@ Listener::Listener(asio::io_context& ioc, tcp::endpoint endpoint, s3::Api& api,
   if (ec) return;
   acceptor_.set_option(asio::socket_base::reuse_address(true), ec);
   if (ec) return;
+#ifdef SO_REUSEPORT
+  if (cfg_.reuse_port) {
+    acceptor_.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+    if (ec) return;
+  }
+#endif
   acceptor_.bind(endpoint, ec);
   if (ec) return;
   acceptor_.listen(asio::socket_base::max_listen_connections, ec);
@@ -126,7 +153,10 @@ void Listener::run() {
 
 void Listener::do_accept() {
   auto self = shared_from_this();
+  // Each connection gets its own strand, which storage completions are
+  // posted back to.
   acceptor_.async_accept(
+    asio::make_strand(ioc_),
     [self](beast::error_code ec, tcp::socket socket) {
       self->on_accept(ec, std::move(socket));
     });
@@ -134,7 +164,7 @@ void Listener::do_accept() {
 
 void Listener::on_accept(beast::error_code ec, tcp::socket socket) {
   if (!ec) {
-    std::make_shared<Session>(std::move(socket), api_, cfg_.max_request_body_bytes, cfg_.metrics)->run();
+    std::make_shared<Session>(std::move(socket), api_, cfg_)->run();
   }
   do_accept();
 }
@@ -2,10 +2,12 @@
 
 #include "metrics.hpp"
 #include "s3_api.hpp"
+#include "storage_executor.hpp"
 
 #include <boost/asio.hpp>
 
 #include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -19,6 +21,12 @@ struct Config {
   unsigned short listen_port = 9000;
   std::size_t max_request_body_bytes = 64u * 1024u * 1024u;
   Metrics* metrics = nullptr;
+  // Runs Api::handle off the I/O threads; nullptr handles inline.
+  StorageExecutor* storage = nullptr;
+  // Sharded mode: every shard binds the same port with SO_REUSEPORT and
+  // /metrics renders all shards' metrics merged.
+  bool reuse_port = false;
+  std::function<std::string()> render_metrics;
 };
 
 class Listener : public std::enable_shared_from_this<Listener> {
@@ -1,6 +1,7 @@
 #include "http_server.hpp"
 #include "s3_api.hpp"
 #include "storage.hpp"
+#include "write_combiner.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/program_options.hpp>
@@ -10,11 +11,25 @@
 #include <rocksdb/options.h>
 #include <rocksdb/table.h>
 
+#include <algorithm>
+#include <csignal>
 #include <cstdlib>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rocksdb {
+// Exported by librocksdb; declared in options/options_helper.h, which is not
+// installed with the public headers.
+std::vector<CompressionType> GetSupportedCompressions();
+} // namespace rocksdb
 
 namespace po = boost::program_options;
 namespace asio = boost::asio;
@@ -25,33 +40,105 @@ static auth::Mode parse_auth_mode(const std::string& s) {
   return auth::Mode::SigV4;
 }
 
+// Fastest codec linked into this librocksdb, for the small metadata values.
+static rocksdb::CompressionType pick_meta_compression() {
+  const auto supported = rocksdb::GetSupportedCompressions();
+  for (auto c : {rocksdb::kLZ4Compression, rocksdb::kSnappyCompression, rocksdb::kZSTD}) {
+    if (std::find(supported.begin(), supported.end(), c) != supported.end()) return c;
+  }
+  return rocksdb::kNoCompression;
+}
+
+// Gives a column family `budget` bytes of memtables, split into two write
+// buffers, and sizes L0 files and L1 to match (as OptimizeLevelStyleCompaction
+// does from its own, much larger, default budget).
+static void size_memtables(rocksdb::ColumnFamilyOptions* cf, std::uint64_t budget) {
+  cf->max_write_buffer_number = 2;
+  cf->min_write_buffer_number_to_merge = 1;
+  cf->write_buffer_size = std::max<std::uint64_t>(budget / 2, 1u << 20);
+  cf->level0_file_num_compaction_trigger = 4;
+  cf->target_file_size_base = cf->write_buffer_size;
+  cf->max_bytes_for_level_base = cf->write_buffer_size * cf->level0_file_num_compaction_trigger;
+}
+
+static void pin_current_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    std::cerr << "Failed to pin shard thread to CPU " << cpu << "\n";
+  }
+#else
+  (void)cpu;
+#endif
+}
+
 int main(int argc, char** argv) {
   std::string listen = "0.0.0.0:9000";
   std::string db_path = "./s3gw_rocksdb";
   int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  int storage_threads = 2 * threads;
+  int shards = 0;
+  bool pin_cpus = false;
+  int storage_queue = 1024;
   int cache_mb = 512;
+  int memtable_mb = 256;
   int max_object_mb = 64;
+  int max_batch_entries = 1000;
+  int max_batch_mb = 64;
+  int max_ranges = 64;
+  int chunk_kb = 1024;
   std::string auth_mode_s = "none";
   std::string access_key = "AKIDEXAMPLE";
   std::string secret_key = "YOURSECRET";
   std::string vhost_suffix = "";
   bool disable_wal = false;
   bool sync = false;
+  bool group_commit = false;
+  int group_commit_us = 100;
+  int group_commit_kb = 4096;
+  bool blob_files = false;
+  int min_blob_kb = 16;
+  int blob_file_mb = 256;
+  bool blob_gc = true;
+  double blob_gc_age_cutoff = 0.25;
+  double blob_gc_force_threshold = 1.0;
+  bool dump_stats = false;
 
   po::options_description desc("s3_rocksdb_gateway options");
   desc.add_options()
     ("help,h", "Show help")
     ("listen", po::value<std::string>(&listen)->default_value(listen), "Listen address host:port")
     ("db_path", po::value<std::string>(&db_path)->default_value(db_path), "RocksDB path")
-    ("threads", po::value<int>(&threads)->default_value(threads), "Worker threads")
+    ("threads", po::value<int>(&threads)->default_value(threads), "I/O threads (HTTP parsing and writes)")
+    ("shards", po::value<int>(&shards)->default_value(shards), "Thread-per-core mode: N io_contexts, each with its own SO_REUSEPORT acceptor (0 = one shared io_context on --threads)")
+    ("pin_cpus", po::bool_switch(&pin_cpus)->default_value(pin_cpus), "With --shards, pin shard i to CPU i")
+    ("storage_threads", po::value<int>(&storage_threads)->default_value(storage_threads), "Threads running RocksDB calls; 0 runs them on the I/O threads (the default with --shards)")
+    ("storage_queue", po::value<int>(&storage_queue)->default_value(storage_queue), "Requests waiting for a storage thread before answering 503 SlowDown")
     ("cache_mb", po::value<int>(&cache_mb)->default_value(cache_mb), "RocksDB block cache (MiB)")
+    ("memtable_mb", po::value<int>(&memtable_mb)->default_value(memtable_mb), "Memtable budget shared by all column families (MiB); data gets 3/4")
     ("max_object_mb", po::value<int>(&max_object_mb)->default_value(max_object_mb), "Max PUT object size (MiB)")
+    ("max_batch_entries", po::value<int>(&max_batch_entries)->default_value(max_batch_entries), "Max entries in one ?batch request")
+    ("max_batch_mb", po::value<int>(&max_batch_mb)->default_value(max_batch_mb), "Max object data one ?batch read returns (MiB); larger batches get 413")
+    ("max_ranges", po::value<int>(&max_ranges)->default_value(max_ranges), "Max specs in one Range header; more are ignored")
+    ("chunk_kb", po::value<int>(&chunk_kb)->default_value(chunk_kb), "Object chunk size (KiB); range GETs read only overlapping chunks")
     ("auth", po::value<std::string>(&auth_mode_s)->default_value(auth_mode_s), "Auth mode: none | sigv4")
     ("access_key", po::value<std::string>(&access_key)->default_value(access_key), "SigV4 access key")
     ("secret_key", po::value<std::string>(&secret_key)->default_value(secret_key), "SigV4 secret key")
     ("virtual_host_suffix", po::value<std::string>(&vhost_suffix)->default_value(vhost_suffix), "Enable virtual-host style: bucket.<suffix>")
     ("disable_wal", po::bool_switch(&disable_wal)->default_value(disable_wal), "Disable RocksDB WAL (lower latency, weaker durability)")
-    ("sync", po::bool_switch(&sync)->default_value(sync), "fsync on write (higher durability, higher latency)");
+    ("sync", po::bool_switch(&sync)->default_value(sync), "fsync on write (higher durability, higher latency)")
+    ("group_commit", po::bool_switch(&group_commit)->default_value(group_commit), "Combine concurrent PUT/DELETE batches into shared RocksDB writes")
+    ("group_commit_us", po::value<int>(&group_commit_us)->default_value(group_commit_us), "How long a group waits for more writers (microseconds)")
+    ("group_commit_kb", po::value<int>(&group_commit_kb)->default_value(group_commit_kb), "Stop waiting once a group holds this much data (KiB)")
+    ("blob_files", po::bool_switch(&blob_files)->default_value(blob_files), "Store large values in RocksDB blob files (integrated BlobDB) instead of inline in SSTs")
+    ("min_blob_kb", po::value<int>(&min_blob_kb)->default_value(min_blob_kb), "Values at least this large (KiB) go to blob files")
+    ("blob_file_mb", po::value<int>(&blob_file_mb)->default_value(blob_file_mb), "Target blob file size (MiB)")
+    ("blob_gc", po::value<bool>(&blob_gc)->default_value(blob_gc), "Relocate live blobs out of old blob files during compaction")
+    ("blob_gc_age_cutoff", po::value<double>(&blob_gc_age_cutoff)->default_value(blob_gc_age_cutoff), "Fraction of oldest blob files eligible for GC")
+    ("blob_gc_force_threshold", po::value<double>(&blob_gc_force_threshold)->default_value(blob_gc_force_threshold), "Garbage ratio of the oldest blob files that forces a compaction (1.0 = never)")
+    ("dump_stats", po::bool_switch(&dump_stats)->default_value(dump_stats), "On SIGINT/SIGTERM, print each column family's rocksdb.stats to stderr before exiting");
 
   po::variables_map vm;
   try {
@@ -67,6 +154,10 @@ int main(int argc, char** argv) {
     return 0;
   }
 
+  // Shards run their requests inline so a connection stays on its core; a
+  // shared storage pool would hop every request to another thread.
+  if (shards > 0 && vm["storage_threads"].defaulted()) storage_threads = 0;
+
   // Parse listen
   auto colon = listen.rfind(':');
   if (colon == std::string::npos) {
@@ -79,62 +170,209 @@ int main(int argc, char** argv) {
     std::cerr << "Invalid port\n";
     return 2;
   }
+  if (memtable_mb < 8) {
+    std::cerr << "--memtable_mb must be at least 8\n";
+    return 2;
+  }
+  if (chunk_kb <= 0) {
+    std::cerr << "--chunk_kb must be positive\n";
+    return 2;
+  }
+  if (blob_files && (min_blob_kb < 0 || blob_file_mb <= 0 ||
+                     blob_gc_age_cutoff < 0.0 || blob_gc_age_cutoff > 1.0 ||
+                     blob_gc_force_threshold < 0.0 || blob_gc_force_threshold > 1.0)) {
+    std::cerr << "Invalid blob options\n";
+    return 2;
+  }
 
   // RocksDB options (latency-oriented defaults)
   rocksdb::Options opt;
   opt.create_if_missing = true;
   opt.IncreaseParallelism();
-  opt.OptimizeLevelStyleCompaction();
+
+  // Memtables: one budget for the whole DB, enforced by db_write_buffer_size,
+  // most of it for object data. The default family holds nothing once
+  // migrated.
+  const std::uint64_t memtable_budget = static_cast<std::uint64_t>(memtable_mb) * 1024u * 1024u;
+  opt.db_write_buffer_size = static_cast<size_t>(memtable_budget);
+  size_memtables(&opt, memtable_budget / 16);
+
+  // One block cache shared by every column family.
+  auto block_cache = rocksdb::NewLRUCache(static_cast<size_t>(cache_mb) * 1024u * 1024u);
+  std::shared_ptr<const rocksdb::FilterPolicy> bloom(rocksdb::NewBloomFilterPolicy(10, false));
 
   rocksdb::BlockBasedTableOptions table;
-  table.block_cache = rocksdb::NewLRUCache(static_cast<size_t>(cache_mb) * 1024u * 1024u);
-  table.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, false));
+  table.block_cache = block_cache;
+  table.filter_policy = bloom;
   table.cache_index_and_filter_blocks = true;
   table.pin_l0_filter_and_index_blocks_in_cache = true;
   opt.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table));
 
+  // Bucket markers and object metadata: tiny values served by HEAD, list and
+  // every GET. Small blocks, bloom filters and pinned indexes keep them in
+  // cache without sharing compactions with object data.
+  storage::ColumnFamilyOptionsSet cf_opts;
+  cf_opts.meta.compression = pick_meta_compression();
+  {
+    rocksdb::BlockBasedTableOptions meta_table = table;
+    meta_table.block_size = 4 * 1024;
+    meta_table.pin_top_level_index_and_filter = true;
+    meta_table.data_block_index_type =
+      rocksdb::BlockBasedTableOptions::DataBlockIndexType::kDataBlockBinaryAndHash;
+    cf_opts.meta.table_factory.reset(rocksdb::NewBlockBasedTableFactory(meta_table));
+  }
+  cf_opts.buckets = cf_opts.meta;
+  size_memtables(&cf_opts.meta, memtable_budget / 8);
+  size_memtables(&cf_opts.buckets, memtable_budget / 16);
+
+  // Object chunks: large incompressible values, so large blocks and no
+  // compression.
+  size_memtables(&cf_opts.data, memtable_budget / 4 * 3);
+  cf_opts.data.compression = rocksdb::kNoCompression;
+  {
+    rocksdb::BlockBasedTableOptions data_table = table;
+    data_table.block_size = 256 * 1024;
+    cf_opts.data.table_factory.reset(rocksdb::NewBlockBasedTableFactory(data_table));
+  }
+
+  // Integrated BlobDB: object chunks are written once to blob files at flush
+  // and only their small references move through compactions.
+  if (blob_files) {
+    cf_opts.data.enable_blob_files = true;
+    cf_opts.data.min_blob_size = static_cast<std::uint64_t>(min_blob_kb) * 1024u;
+    cf_opts.data.blob_file_size = static_cast<std::uint64_t>(blob_file_mb) * 1024u * 1024u;
+    cf_opts.data.blob_compression_type = rocksdb::kNoCompression;
+    cf_opts.data.enable_blob_garbage_collection = blob_gc;
+    cf_opts.data.blob_garbage_collection_age_cutoff = blob_gc_age_cutoff;
+    cf_opts.data.blob_garbage_collection_force_threshold = blob_gc_force_threshold;
+  }
+
   std::unique_ptr<rocksdb::DB> db;
   rocksdb::DB* raw = nullptr;
-  auto st = rocksdb::DB::Open(opt, db_path, &raw);
+  std::vector<rocksdb::ColumnFamilyHandle*> cf_handles;
+  storage::ColumnFamilies cfs;
+  std::uint64_t migrated = 0;
+  auto st = storage::open_db(opt, cf_opts, db_path, &raw, &cf_handles, &cfs, &migrated);
+  db.reset(raw);
   if (!st.ok()) {
     std::cerr << "Failed to open RocksDB at " << db_path << ": " << st.ToString() << "\n";
     return 1;
   }
-  db.reset(raw);
+  if (migrated > 0) {
+    std::cerr << "Moved " << migrated << " keys into the buckets/meta/data column families\n";
+  }
 
   rocksdb::WriteOptions wo;
   wo.disableWAL = disable_wal;
   wo.sync = sync;
 
   server::Metrics metrics;
-  storage::RocksObjectStore store(db.get(), wo, &metrics);
+  storage::RocksObjectStore store(db.get(), wo, &metrics, static_cast<std::int64_t>(chunk_kb) * 1024, cfs);
+  std::unique_ptr<storage::WriteCombiner> combiner;
+  if (group_commit) {
+    storage::WriteCombiner::Options gc;
+    gc.window = std::chrono::microseconds(std::max(0, group_commit_us));
+    gc.max_bytes = static_cast<std::size_t>(std::max(1, group_commit_kb)) * 1024u;
+    combiner = std::make_unique<storage::WriteCombiner>(db.get(), wo, gc, &metrics);
+    store.set_write_combiner(combiner.get());
+  }
 
   s3::Config s3cfg;
   s3cfg.auth_mode = parse_auth_mode(auth_mode_s);
   s3cfg.creds = auth::Credentials{access_key, secret_key};
   s3cfg.virtual_host_suffix = vhost_suffix;
   s3cfg.max_object_bytes = static_cast<size_t>(std::max(1, max_object_mb)) * 1024u * 1024u;
+  s3cfg.max_batch_entries = static_cast<size_t>(std::max(1, max_batch_entries));
+  s3cfg.max_batch_response_bytes = static_cast<size_t>(std::max(1, max_batch_mb)) * 1024u * 1024u;
+  s3cfg.max_ranges = static_cast<size_t>(std::max(1, max_ranges));
 
   s3::Api api(&store, s3cfg);
 
-  asio::io_context ioc{static_cast<int>(std::max(1, threads))};
-
   tcp::endpoint endpoint{asio::ip::make_address(host), static_cast<unsigned short>(port_i)};
   server::Config scfg;
   scfg.listen_host = host;
   scfg.listen_port = static_cast<unsigned short>(port_i);
   scfg.max_request_body_bytes = s3cfg.max_object_bytes;
   scfg.metrics = &metrics;
+  std::unique_ptr<server::StorageExecutor> storage_pool;
+  if (storage_threads > 0) {
+    storage_pool = std::make_unique<server::StorageExecutor>(
+      static_cast<std::size_t>(storage_threads), static_cast<std::size_t>(std::max(1, storage_queue)), &metrics);
+    scfg.storage = storage_pool.get();
+  }
 
-  auto listener = std::make_shared<server::Listener>(ioc, endpoint, api, scfg);
-  listener->run();
+  // SIGINT/SIGTERM stop the io_contexts, so the process shuts down through
+  // the normal path below (storage pool, column family handles, DB close).
+  std::vector<asio::io_context*> running;
+  auto watch_signals = [&running](asio::io_context& ioc) {
+    auto signals = std::make_shared<asio::signal_set>(ioc, SIGINT, SIGTERM);
+    signals->async_wait([signals, &running](const boost::system::error_code& ec, int) {
+      if (ec) return;
+      for (auto* c : running) c->stop();
+    });
+  };
 
+  // The io_contexts (and the shard metrics their handlers touch) live at
+  // function scope: storage_pool->stop() drains queued tasks, which post
+  // their completions back onto them, so they must outlive the pool.
+  std::vector<std::unique_ptr<asio::io_context>> iocs;
+  std::vector<std::unique_ptr<server::Metrics>> shard_metrics;
+  std::vector<const server::Metrics*> scrape;
   std::vector<std::thread> workers;
-  workers.reserve(static_cast<size_t>(threads));
-  for (int i = 0; i < threads; ++i) {
-    workers.emplace_back([&ioc]{ ioc.run(); });
-  }
+  if (shards > 0) {
+    // One single-threaded io_context and acceptor per shard; the kernel
+    // spreads connections across the SO_REUSEPORT listeners and each
+    // connection stays on its shard. Shards record HTTP metrics separately
+    // (the shared `metrics` keeps storage ones) and /metrics merges them.
+    const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < shards; ++i) {
+      iocs.push_back(std::make_unique<asio::io_context>(1));
+      shard_metrics.push_back(std::make_unique<server::Metrics>());
+      scrape.push_back(shard_metrics.back().get());
+      running.push_back(iocs.back().get());
+    }
+    watch_signals(*iocs[0]);
+    scrape.push_back(&metrics);
+    const std::size_t shard_count = static_cast<std::size_t>(shards);
+
+    for (int i = 0; i < shards; ++i) {
+      server::Config shard_cfg = scfg;
+      shard_cfg.metrics = shard_metrics[i].get();
+      shard_cfg.reuse_port = true;
+      shard_cfg.render_metrics = [&scrape, shard_count] {
+        return server::Metrics::RenderMerged(scrape, shard_count);
+      };
+      std::make_shared<server::Listener>(*iocs[i], endpoint, api, shard_cfg)->run();
+    }
+    workers.reserve(shard_count);
+    for (int i = 0; i < shards; ++i) {
+      workers.emplace_back([&iocs, i, pin_cpus, cpus] {
+        if (pin_cpus) pin_current_thread(static_cast<int>(static_cast<unsigned>(i) % cpus));
+        iocs[i]->run();
+      });
+    }
+    for (auto& t : workers) t.join();
+  } else {
+    iocs.push_back(std::make_unique<asio::io_context>(std::max(1, threads)));
+    asio::io_context& ioc = *iocs.back();
+    auto listener = std::make_shared<server::Listener>(ioc, endpoint, api, scfg);
+    listener->run();
+    running.push_back(&ioc);
+    watch_signals(ioc);
 
-  for (auto& t : workers) t.join();
+    workers.reserve(static_cast<size_t>(threads));
+    for (int i = 0; i < threads; ++i) {
+      workers.emplace_back([&ioc]{ ioc.run(); });
+    }
+    for (auto& t : workers) t.join();
+  }
+  if (storage_pool) storage_pool->stop();
+  if (dump_stats) {
+    for (auto* h : cf_handles) {
+      std::string stats;
+      if (db->GetProperty(h, "rocksdb.stats", &stats)) std::cerr << stats;
+    }
+  }
+  for (auto* h : cf_handles) db->DestroyColumnFamilyHandle(h);
   return 0;
 }
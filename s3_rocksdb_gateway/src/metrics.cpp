@@ -24,6 +24,14 @@ void Metrics::DecInFlight() {
   inflight_.fetch_sub(1, std::memory_order_relaxed);
 }
 
+void Metrics::SetStorageQueued(std::size_t queued) {
+  storage_queued_.store(queued, std::memory_order_relaxed);
+}
+
+void Metrics::IncStorageRejected() {
+  storage_rejected_.fetch_add(1, std::memory_order_relaxed);
+}
+
 Metrics::MethodIndex Metrics::method_index(std::string_view method) {
   if (method == "GET") return kGet;
   if (method == "PUT") return kPut;
@@ -75,6 +83,7 @@ Metrics::RocksOpIndex Metrics::rocks_op_index(std::string_view op) {
   if (op == "write") return kRdbWrite;
   if (op == "delete") return kRdbDelete;
   if (op == "iter") return kRdbIter;
+  if (op == "multiget") return kRdbMultiGet;
   return kRdbOther;
 }
 
@@ -85,6 +94,7 @@ const char* Metrics::rocks_op_name(RocksOpIndex idx) {
     case kRdbWrite: return "write";
     case kRdbDelete: return "delete";
     case kRdbIter: return "iter";
+    case kRdbMultiGet: return "multiget";
     default: return "other";
   }
 }
@@ -112,6 +122,64 @@ void Metrics::ObserveRocksdb(std::string_view op,
   }
 }
 
+void Metrics::MergeInto(Metrics& out) const {
+  auto add = [](auto& dst, const auto& src) {
+    for (std::size_t i = 0; i < src.size(); ++i) {
+      dst[i].fetch_add(src[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+  };
+  add(out.req_counts_, req_counts_);
+  add(out.err_counts_, err_counts_);
+  add(out.req_bytes_, req_bytes_);
+  add(out.resp_bytes_, resp_bytes_);
+  add(out.bucket_counts_, bucket_counts_);
+  add(out.rdb_counts_, rdb_counts_);
+  add(out.rdb_err_counts_, rdb_err_counts_);
+  add(out.rdb_bytes_, rdb_bytes_);
+  add(out.rdb_bucket_counts_, rdb_bucket_counts_);
+  out.latency_count_.fetch_add(latency_count_.load(), std::memory_order_relaxed);
+  out.latency_sum_us_.fetch_add(latency_sum_us_.load(), std::memory_order_relaxed);
+  out.rdb_latency_count_.fetch_add(rdb_latency_count_.load(), std::memory_order_relaxed);
+  out.rdb_latency_sum_us_.fetch_add(rdb_latency_sum_us_.load(), std::memory_order_relaxed);
+  out.inflight_.fetch_add(inflight_.load(), std::memory_order_relaxed);
+  out.storage_queued_.fetch_add(storage_queued_.load(), std::memory_order_relaxed);
+  out.storage_rejected_.fetch_add(storage_rejected_.load(), std::memory_order_relaxed);
+  out.group_writes_.fetch_add(group_writes_.load(), std::memory_order_relaxed);
+  out.group_requests_.fetch_add(group_requests_.load(), std::memory_order_relaxed);
+  out.group_bytes_.fetch_add(group_bytes_.load(), std::memory_order_relaxed);
+  out.group_wait_us_.fetch_add(group_wait_us_.load(), std::memory_order_relaxed);
+}
+
+std::string Metrics::RenderMerged(const std::vector<const Metrics*>& parts, std::size_t shards) {
+  Metrics total;
+  for (const auto* m : parts) m->MergeInto(total);
+  std::ostringstream oss;
+  oss << total.RenderPrometheus();
+
+  shards = std::min(shards, parts.size());
+  oss << "# HELP s3gw_shard_requests_total HTTP requests per server shard.\n";
+  oss << "# TYPE s3gw_shard_requests_total counter\n";
+  for (std::size_t s = 0; s < shards; ++s) {
+    std::uint64_t n = 0;
+    for (const auto& c : parts[s]->req_counts_) n += c.load();
+    oss << "s3gw_shard_requests_total{shard=\"" << s << "\"} " << n << "\n";
+  }
+  oss << "# HELP s3gw_shard_inflight_requests In-flight HTTP requests per server shard.\n";
+  oss << "# TYPE s3gw_shard_inflight_requests gauge\n";
+  for (std::size_t s = 0; s < shards; ++s) {
+    oss << "s3gw_shard_inflight_requests{shard=\"" << s << "\"} " << parts[s]->inflight_.load() << "\n";
+  }
+  return oss.str();
+}
+
+void Metrics::ObserveGroupCommit(std::size_t requests, std::size_t bytes, double wait_ms) {
+  group_writes_.fetch_add(1, std::memory_order_relaxed);
+  group_requests_.fetch_add(requests, std::memory_order_relaxed);
+  group_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  group_wait_us_.fetch_add(static_cast<std::uint64_t>(std::llround(wait_ms * 1000.0)),
+                           std::memory_order_relaxed);
+}
+
 std::string Metrics::RenderPrometheus() const {
   std::ostringstream oss;
 
@@ -147,6 +215,14 @@ std::string Metrics::RenderPrometheus() const {
   oss << "# TYPE s3gw_inflight_requests gauge\n";
   oss << "s3gw_inflight_requests " << inflight_.load() << "\n";
 
+  oss << "# HELP s3gw_storage_queue_depth Requests waiting for a storage thread.\n";
+  oss << "# TYPE s3gw_storage_queue_depth gauge\n";
+  oss << "s3gw_storage_queue_depth " << storage_queued_.load() << "\n";
+
+  oss << "# HELP s3gw_storage_rejected_total Requests refused with 503 because the storage queue was full.\n";
+  oss << "# TYPE s3gw_storage_rejected_total counter\n";
+  oss << "s3gw_storage_rejected_total " << storage_rejected_.load() << "\n";
+
   oss << "# HELP s3gw_request_latency_ms Request latency in milliseconds.\n";
   oss << "# TYPE s3gw_request_latency_ms histogram\n";
 
@@ -197,6 +273,19 @@ std::string Metrics::RenderPrometheus() const {
   oss << "s3gw_rocksdb_latency_ms_sum " << rdb_sum_ms << "\n";
   oss << "s3gw_rocksdb_latency_ms_count " << rdb_count << "\n";
 
+  oss << "# HELP s3gw_group_commit_writes_total Combined RocksDB writes issued by group commit.\n";
+  oss << "# TYPE s3gw_group_commit_writes_total counter\n";
+  oss << "s3gw_group_commit_writes_total " << group_writes_.load() << "\n";
+  oss << "# HELP s3gw_group_commit_requests_total PUT/DELETE requests carried by those writes.\n";
+  oss << "# TYPE s3gw_group_commit_requests_total counter\n";
+  oss << "s3gw_group_commit_requests_total " << group_requests_.load() << "\n";
+  oss << "# HELP s3gw_group_commit_bytes_total Bytes in combined writes.\n";
+  oss << "# TYPE s3gw_group_commit_bytes_total counter\n";
+  oss << "s3gw_group_commit_bytes_total " << group_bytes_.load() << "\n";
+  oss << "# HELP s3gw_group_commit_wait_ms_sum Time requests waited for their group to close.\n";
+  oss << "# TYPE s3gw_group_commit_wait_ms_sum counter\n";
+  oss << "s3gw_group_commit_wait_ms_sum " << static_cast<double>(group_wait_us_.load()) / 1000.0 << "\n";
+
   return oss.str();
 }
 
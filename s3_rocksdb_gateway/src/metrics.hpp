@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <string>
 #include <string_view>
+#include <vector>
 
 namespace server {
 
@@ -15,6 +16,9 @@ public:
   void IncInFlight();
   void DecInFlight();
 
+  void SetStorageQueued(std::size_t queued);
+  void IncStorageRejected();
+
   void Observe(std::string_view method,
                unsigned status,
                std::size_t req_bytes,
@@ -26,8 +30,20 @@ public:
                       std::size_t bytes,
                       double latency_ms);
 
+  // One combined write of `requests` PUT/DELETE batches; wait_ms is the total
+  // time those requests spent waiting for the group to close.
+  void ObserveGroupCommit(std::size_t requests, std::size_t bytes, double wait_ms);
+
   std::string RenderPrometheus() const;
 
+  // Adds every counter and gauge of this instance to out.
+  void MergeInto(Metrics& out) const;
+
+  // Renders the sum of parts (per-shard instances first, then any shared
+  // ones such as the storage layer's), followed by request and in-flight
+  // counts for each of the first `shards` parts.
+  static std::string RenderMerged(const std::vector<const Metrics*>& parts, std::size_t shards);
+
 private:
   enum MethodIndex {
     kGet = 0,
@@ -55,6 +71,13 @@ private:
   std::array<std::atomic<std::uint64_t>, kBucketCount> bucket_counts_{};
 
   std::atomic<std::int64_t> inflight_{0};
+  std::atomic<std::uint64_t> storage_queued_{0};
+  std::atomic<std::uint64_t> storage_rejected_{0};
+
+  std::atomic<std::uint64_t> group_writes_{0};
+  std::atomic<std::uint64_t> group_requests_{0};
+  std::atomic<std::uint64_t> group_bytes_{0};
+  std::atomic<std::uint64_t> group_wait_us_{0};
 
   enum RocksOpIndex {
     kRdbGet = 0,
@@ -62,8 +85,9 @@ private:
     kRdbWrite = 2,
     kRdbDelete = 3,
     kRdbIter = 4,
-    kRdbOther = 5,
-    kRdbOpCount = 6,
+    kRdbMultiGet = 5,
+    kRdbOther = 6,
+    kRdbOpCount = 7,
   };
 
   static RocksOpIndex rocks_op_index(std::string_view op);
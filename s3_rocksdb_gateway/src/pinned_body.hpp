@@ -0,0 +1,115 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace s3 {
+
+// Beast body made of segments that are either owned strings (headers, XML) or
+// views into memory kept alive by a held owner, typically RocksDB values
+// pinned in the block cache. The serializer hands all segments to the socket
+// as one scatter-gather write, so pinned object bytes are never copied.
+struct PinnedBody {
+  class value_type {
+  public:
+    void assign(std::string_view s) {
+      clear();
+      append(s);
+    }
+
+    // Copies s into the body.
+    void append(std::string_view s) {
+      if (s.empty()) return;
+      segments_.push_back(Segment{std::string(s), {}, false});
+      size_ += s.size();
+    }
+
+    // References s; it must stay valid while the body lives, e.g. by holding
+    // its owner.
+    void append_view(std::string_view s) {
+      if (s.empty()) return;
+      segments_.push_back(Segment{{}, s, true});
+      size_ += s.size();
+    }
+
+    void hold(std::shared_ptr<const void> owner) { owners_.push_back(std::move(owner)); }
+
+    void clear() {
+      segments_.clear();
+      owners_.clear();
+      size_ = 0;
+    }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    std::string to_string() const {
+      std::string out;
+      out.reserve(size_);
+      for (const auto& s : segments_) {
+        const auto v = s.data();
+        out.append(v.data(), v.size());
+      }
+      return out;
+    }
+
+    std::vector<boost::asio::const_buffer> buffers() const {
+      std::vector<boost::asio::const_buffer> out;
+      out.reserve(segments_.size());
+      for (const auto& s : segments_) {
+        const auto v = s.data();
+        out.emplace_back(v.data(), v.size());
+      }
+      return out;
+    }
+
+  private:
+    struct Segment {
+      std::string owned;
+      std::string_view view;
+      bool is_view = false;
+
+      std::string_view data() const { return is_view ? view : std::string_view(owned); }
+    };
+
+    std::vector<Segment> segments_;
+    std::vector<std::shared_ptr<const void>> owners_;
+    std::size_t size_ = 0;
+  };
+
+  static std::uint64_t size(const value_type& body) { return body.size(); }
+
+  class writer {
+  public:
+    using const_buffers_type = std::vector<boost::asio::const_buffer>;
+
+    template <bool isRequest, class Fields>
+    writer(const boost::beast::http::header<isRequest, Fields>&, const value_type& body)
+      : body_(body) {}
+
+    void init(boost::beast::error_code& ec) { ec = {}; }
+
+    boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec) {
+      ec = {};
+      if (done_ || body_.empty()) return boost::none;
+      done_ = true;
+      return std::make_pair(body_.buffers(), false);
+    }
+
+  private:
+    const value_type& body_;
+    bool done_ = false;
+  };
+};
+
+} // namespace s3
@@ -8,6 +8,8 @@
 #include <cctype>
 #include <chrono>
 #include <iomanip>
+#include <limits>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -136,7 +138,7 @@ static Response make_xml_response(http::status st, std::string body_xml, bool ke
   res.set(http::field::server, "s3_rocksdb_gateway");
   res.set(http::field::content_type, "application/xml");
   res.keep_alive(keep_alive);
-  res.body().assign(body_xml.begin(), body_xml.end());
+  res.body().assign(body_xml);
   res.content_length(res.body().size());
   return res;
 }
@@ -171,6 +173,7 @@ static std::pair<http::status, std::string> map_storage_error(std::string_view e
   if (err == "NoSuchBucket") return {http::status::not_found, "NoSuchBucket"};
   if (err == "NoSuchKey") return {http::status::not_found, "NoSuchKey"};
   if (err == "BucketNotEmpty") return {http::status::conflict, "BucketNotEmpty"};
+  if (err == "ResponseTooLarge") return {http::status::payload_too_large, "ResponseTooLarge"};
   if (err.rfind("Invalid", 0) == 0) return {http::status::bad_request, "InvalidRequest"};
   if (err.find("Invalid continuation-token") != std::string_view::npos) return {http::status::bad_request, "InvalidRequest"};
   return {http::status::internal_server_error, "InternalError"};
@@ -181,15 +184,14 @@ struct ByteRange {
   std::int64_t end = 0; // inclusive
 };
 
-static std::optional<ByteRange> parse_single_range(std::string_view header_value, std::int64_t size) {
-  // Only support a single range: bytes=start-end | bytes=start- | bytes=-suffix
-  if (size <= 0) return std::nullopt;
-  std::string normalized = util::trim_and_collapse_ws(header_value);
-  std::string_view v = normalized;
-  if (v.rfind("bytes=", 0) != 0) return std::nullopt;
-  v.remove_prefix(6);
-  if (v.find(',') != std::string_view::npos) return std::nullopt;
+// One syntactically valid spec, not yet resolved against the object size:
+// start-end, start- (end < 0) or -suffix (start < 0, end = suffix length).
+struct RangeSpec {
+  std::int64_t start = -1;
+  std::int64_t end = -1;
+};
 
+static std::optional<RangeSpec> parse_range_spec(std::string_view v) {
   auto dash = v.find('-');
   if (dash == std::string_view::npos) return std::nullopt;
 
@@ -200,42 +202,138 @@ static std::optional<ByteRange> parse_single_range(std::string_view header_value
     if (s.empty()) return false;
     std::int64_t val = 0;
     auto res = std::from_chars(s.data(), s.data() + s.size(), val);
-    if (res.ec != std::errc{}) return false;
+    if (res.ec != std::errc{} || res.ptr != s.data() + s.size() || val < 0) return false;
     *out = val;
     return true;
   };
 
-  ByteRange br{};
+  RangeSpec spec;
   if (left.empty()) {
     // bytes=-suffix
-    std::int64_t suffix = 0;
-    if (!parse_i64(right, &suffix)) return std::nullopt;
-    if (suffix <= 0) return std::nullopt;
-    if (suffix >= size) {
-      br.start = 0;
-      br.end = size > 0 ? size - 1 : 0;
-      return br;
-    }
-    br.start = size - suffix;
+    if (!parse_i64(right, &spec.end) || spec.end == 0) return std::nullopt;
+    return spec;
+  }
+  if (!parse_i64(left, &spec.start)) return std::nullopt;
+  if (!right.empty()) {
+    if (!parse_i64(right, &spec.end) || spec.end < spec.start) return std::nullopt;
+  }
+  return spec;
+}
+
+// Parses bytes=spec[,spec...]. An empty result means the header is to be
+// ignored (more than max_ranges specs); nullopt means it is malformed.
+static std::optional<std::vector<RangeSpec>> parse_range_header(std::string_view header_value, std::size_t max_ranges) {
+  std::string normalized = util::trim_and_collapse_ws(header_value);
+  std::string_view v = normalized;
+  if (v.rfind("bytes=", 0) != 0) return std::nullopt;
+  v.remove_prefix(6);
+
+  std::vector<RangeSpec> specs;
+  while (true) {
+    size_t comma = v.find(',');
+    std::string_view spec = v.substr(0, comma);
+    while (!spec.empty() && spec.front() == ' ') spec.remove_prefix(1);
+    while (!spec.empty() && spec.back() == ' ') spec.remove_suffix(1);
+    auto parsed = parse_range_spec(spec);
+    if (!parsed) return std::nullopt;
+    if (specs.size() == max_ranges) return std::vector<RangeSpec>{};
+    specs.push_back(*parsed);
+    if (comma == std::string_view::npos) break;
+    v.remove_prefix(comma + 1);
+  }
+  return specs;
+}
+
+static std::optional<ByteRange> resolve_range(const RangeSpec& spec, std::int64_t size) {
+  ByteRange br{};
+  if (spec.start < 0) {
+    br.start = spec.end >= size ? 0 : size - spec.end;
     br.end = size - 1;
     return br;
   }
+  if (spec.start >= size) return std::nullopt;
+  br.start = spec.start;
+  br.end = spec.end < 0 || spec.end >= size ? size - 1 : spec.end;
+  return br;
+}
 
-  if (!parse_i64(left, &br.start)) return std::nullopt;
-  if (!right.empty()) {
-    if (!parse_i64(right, &br.end)) return std::nullopt;
-  } else {
-    br.end = size > 0 ? size - 1 : 0;
+// Resolves the specs against size, sorted with overlapping and adjacent
+// ranges merged. nullopt (416) only if no spec is satisfiable; if some are
+// not, the result is empty and the whole object is served instead.
+static std::optional<std::vector<ByteRange>> resolve_ranges(const std::vector<RangeSpec>& specs, std::int64_t size) {
+  if (size <= 0) return std::nullopt;
+  std::vector<ByteRange> ranges;
+  ranges.reserve(specs.size());
+  for (const auto& spec : specs) {
+    if (auto br = resolve_range(spec, size)) ranges.push_back(*br);
+  }
+  if (ranges.empty()) return std::nullopt;
+  if (ranges.size() != specs.size()) return std::vector<ByteRange>{};
+
+  std::sort(ranges.begin(), ranges.end(), [](const ByteRange& a, const ByteRange& b) { return a.start < b.start; });
+  std::size_t out = 0;
+  for (std::size_t i = 1; i < ranges.size(); ++i) {
+    if (ranges[i].start <= ranges[out].end + 1) {
+      ranges[out].end = std::max(ranges[out].end, ranges[i].end);
+    } else {
+      ranges[++out] = ranges[i];
+    }
   }
+  ranges.resize(out + 1);
+  return ranges;
+}
 
-  if (br.start < 0 || br.start >= size) return std::nullopt;
-  if (br.end < br.start) return std::nullopt;
-  if (br.end >= size) br.end = size - 1;
-  return br;
+// Batch wire format, all integers little-endian. POST /bucket?batch reads,
+// PUT /bucket?batch writes; both bodies start with a u32 entry count.
+//   read entry:     u16 key_len, key, i64 offset, i64 length (-1: to the end)
+//   write entry:    u16 key_len, key, u16 type_len, content_type, u64 len, data
+//   read response:  u32 count, then per entry u16 status, u64 object size,
+//                   u64 len, data (len is 0 unless status is 200)
+// Writes are applied atomically and answered with an empty 200.
+struct BatchCursor {
+  std::string_view in;
+  bool ok = true;
+
+  std::uint64_t fixed(std::size_t bytes) {
+    if (in.size() < bytes) {
+      ok = false;
+      return 0;
+    }
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+      v |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    in.remove_prefix(bytes);
+    return v;
+  }
+
+  std::string_view bytes(std::uint64_t n) {
+    if (in.size() < n) {
+      ok = false;
+      return {};
+    }
+    auto out = in.substr(0, static_cast<std::size_t>(n));
+    in.remove_prefix(static_cast<std::size_t>(n));
+    return out;
+  }
+};
+
+static void put_le(std::string* out, std::uint64_t v, std::size_t bytes) {
+  for (std::size_t i = 0; i < bytes; ++i) out->push_back(static_cast<char>((v >> (8 * i)) & 0xff));
 }
 
 Api::Api(storage::RocksObjectStore* store, Config cfg) : store_(store), cfg_(std::move(cfg)) {}
 
+Response Api::busy(const Request& req) {
+  return s3_error(http::status::service_unavailable,
+                  "SlowDown",
+                  "Please reduce your request rate.",
+                  std::string_view(req.target().data(), req.target().size()),
+                  new_request_id(),
+                  req.keep_alive(),
+                  req.version());
+}
+
 Response Api::handle(const Request& req) {
   const std::string request_id = new_request_id();
   const bool keep_alive = req.keep_alive();
@@ -302,6 +400,87 @@ Response Api::handle(const Request& req) {
   const bool bucket_only = pt.bucket.size() > 0 && pt.key.empty();
 
   if (bucket_only) {
+    const bool batch = qp_get(pt, "batch").has_value();
+    if (batch && (req.method() == http::verb::post || req.method() == http::verb::put)) {
+      BatchCursor in{std::string_view(req.body().data(), req.body().size())};
+      const std::uint64_t count = in.fixed(4);
+      if (count > cfg_.max_batch_entries) {
+        return s3_error(http::status::bad_request,
+                        "InvalidRequest",
+                        "Too many batch entries",
+                        pt.path,
+                        request_id,
+                        keep_alive,
+                        version);
+      }
+      std::vector<storage::ObjectRead> reads;
+      std::vector<storage::ObjectWrite> writes;
+      for (std::uint64_t i = 0; i < count && in.ok; ++i) {
+        const auto key = in.bytes(in.fixed(2));
+        if (req.method() == http::verb::post) {
+          const auto offset = static_cast<std::int64_t>(in.fixed(8));
+          const auto length = static_cast<std::int64_t>(in.fixed(8));
+          reads.push_back({std::string(key), offset, length});
+        } else {
+          const auto content_type = in.bytes(in.fixed(2));
+          const auto data = in.bytes(in.fixed(8));
+          writes.push_back({key, data, content_type});
+        }
+      }
+      if (!in.ok || !in.in.empty()) {
+        return s3_error(http::status::bad_request,
+                        "InvalidRequest",
+                        "Malformed batch request",
+                        pt.path,
+                        request_id,
+                        keep_alive,
+                        version);
+      }
+
+      std::string err;
+      if (req.method() == http::verb::put) {
+        if (!store_->put_objects(pt.bucket, writes, nullptr, &err)) {
+          auto [st, code] = map_storage_error(err);
+          return s3_error(st, code, err, pt.path, request_id, keep_alive, version);
+        }
+        return make_empty_response(http::status::ok, keep_alive, version);
+      }
+
+      // The body references the pinned chunks, as for a single GET.
+      auto read = std::make_shared<storage::PinnedRead>();
+      std::vector<storage::ObjectReadResult> results;
+      if (!store_->read_objects(pt.bucket, reads, &results, read.get(), &err, cfg_.max_batch_response_bytes)) {
+        auto [st, code] = map_storage_error(err);
+        return s3_error(st, code, err, pt.path, request_id, keep_alive, version);
+      }
+      Response res{http::status::ok, version};
+      res.set(http::field::server, "s3_rocksdb_gateway");
+      res.set(http::field::content_type, "application/octet-stream");
+      res.keep_alive(keep_alive);
+      auto& body = res.body();
+      std::string head;
+      put_le(&head, results.size(), 4);
+      for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        http::status st = http::status::ok;
+        if (r.err == "InvalidRange") {
+          st = http::status::range_not_satisfiable;
+        } else if (!r.err.empty()) {
+          st = map_storage_error(r.err).first;
+        }
+        put_le(&head, static_cast<unsigned>(st), 2);
+        put_le(&head, static_cast<std::uint64_t>(r.meta.size), 8);
+        put_le(&head, r.err.empty() ? static_cast<std::uint64_t>(r.range.length) : 0, 8);
+        body.append(head);
+        head.clear();
+        for (auto piece : read->pieces[i]) body.append_view(piece);
+      }
+      body.append(head);
+      body.hold(read);
+      res.content_length(body.size());
+      return res;
+    }
+
     if (req.method() == http::verb::put) {
       std::string err;
       if (!store_->create_bucket(pt.bucket, &err)) {
@@ -431,19 +610,44 @@ Response Api::handle(const Request& req) {
   }
 
   if (req.method() == http::verb::get) {
-    std::string data;
+    // Metadata and, if a range may start in it, the first chunk in one
+    // lookup; other chunks are read only if the requested ranges reach them.
+    // The response body references the pinned chunks and keeps them alive
+    // until it has been written.
+    const auto range_it = req.find(http::field::range);
+    std::optional<std::vector<RangeSpec>> specs;
+    constexpr std::int64_t kMaxOffset = std::numeric_limits<std::int64_t>::max();
+    std::int64_t first_offset = 0;
+    std::int64_t end_offset = kMaxOffset;
+    if (range_it != req.end()) {
+      specs = parse_range_header(std::string_view(range_it->value().data(), range_it->value().size()), cfg_.max_ranges);
+      if (specs && !specs->empty()) {
+        // A suffix range's start depends on the size, so it counts as 0;
+        // suffix and open-ended ranges may reach the end.
+        first_offset = kMaxOffset;
+        end_offset = 0;
+        for (const auto& spec : *specs) {
+          first_offset = std::min(first_offset, std::max<std::int64_t>(spec.start, 0));
+          const bool to_end = spec.start < 0 || spec.end < 0 || spec.end == kMaxOffset;
+          end_offset = to_end ? kMaxOffset : std::max(end_offset, spec.end + 1);
+        }
+      }
+    }
+
+    storage::ObjectMeta meta;
     std::string err;
-    if (!store_->get_object_data(pt.bucket, pt.key, &data, &err)) {
+    auto read = std::make_shared<storage::PinnedRead>();
+    if (!store_->open_object(pt.bucket, pt.key, &meta, read.get(), &err, first_offset, end_offset)) {
       auto [st, code] = map_storage_error(err);
       std::string msg = (code == "NoSuchKey") ? "The specified key does not exist" : err;
       return s3_error(st, code, msg, resource, request_id, keep_alive, version);
     }
 
-    const std::int64_t size = static_cast<std::int64_t>(data.size());
-    std::optional<ByteRange> range;
-    if (auto it = req.find(http::field::range); it != req.end()) {
-      range = parse_single_range(std::string_view(it->value().data(), it->value().size()), size);
-      if (!range) {
+    const std::int64_t size = meta.size;
+    std::optional<std::vector<ByteRange>> ranges;
+    if (range_it != req.end()) {
+      if (specs) ranges = specs->empty() ? std::vector<ByteRange>{} : resolve_ranges(*specs, size);
+      if (!ranges) {
         Response res = s3_error(http::status::range_not_satisfiable,
                                 "InvalidRange",
                                 "The requested range is not satisfiable",
@@ -454,24 +658,50 @@ Response Api::handle(const Request& req) {
         res.set("Content-Range", "bytes */" + std::to_string(size));
         return res;
       }
+      if (ranges->empty()) ranges.reset();
     }
 
-    Response res{range ? http::status::partial_content : http::status::ok, version};
+    std::vector<storage::ReadRange> reads;
+    if (ranges) {
+      for (const auto& r : *ranges) reads.push_back({r.start, r.end - r.start + 1});
+    } else {
+      reads.push_back({0, size});
+    }
+    if (!store_->read_ranges(pt.bucket, pt.key, meta, reads, read.get(), &err)) {
+      auto [st, code] = map_storage_error(err);
+      std::string msg = (code == "NoSuchKey") ? "The specified key does not exist" : err;
+      return s3_error(st, code, msg, resource, request_id, keep_alive, version);
+    }
+
+    Response res{ranges ? http::status::partial_content : http::status::ok, version};
     res.set(http::field::server, "s3_rocksdb_gateway");
     res.set(http::field::content_type, "application/octet-stream");
     res.set("Accept-Ranges", "bytes");
     res.keep_alive(keep_alive);
 
-    if (range) {
-      const auto& r = *range;
-      const std::size_t start = static_cast<std::size_t>(r.start);
-      const std::size_t end = static_cast<std::size_t>(r.end);
-      res.set("Content-Range",
-              "bytes " + std::to_string(start) + "-" + std::to_string(end) + "/" + std::to_string(size));
-      res.body().assign(data.begin() + start, data.begin() + end + 1);
+    auto content_range = [size](const ByteRange& r) {
+      return "bytes " + std::to_string(r.start) + "-" + std::to_string(r.end) + "/" + std::to_string(size);
+    };
+
+    if (ranges && ranges->size() == 1) {
+      res.set("Content-Range", content_range(ranges->front()));
+      for (auto piece : read->pieces.front()) res.body().append_view(piece);
+    } else if (ranges) {
+      const std::string boundary = "s3gw-" + request_id;
+      res.set(http::field::content_type, "multipart/byteranges; boundary=" + boundary);
+      auto& body = res.body();
+      for (std::size_t i = 0; i < ranges->size(); ++i) {
+        const std::string part_head = "\r\n--" + boundary +
+                                      "\r\nContent-Type: application/octet-stream" +
+                                      "\r\nContent-Range: " + content_range((*ranges)[i]) + "\r\n\r\n";
+        body.append(part_head);
+        for (auto piece : read->pieces[i]) body.append_view(piece);
+      }
+      body.append("\r\n--" + boundary + "--\r\n");
     } else {
-      res.body().assign(data.begin(), data.end());
+      for (auto piece : read->pieces.front()) res.body().append_view(piece);
     }
+    res.body().hold(read);
     res.content_length(res.body().size());
     return res;
   }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "pinned_body.hpp"
 #include "sigv4.hpp"
 #include "storage.hpp"
 
@@ -18,11 +19,14 @@ struct Config {
   auth::Mode auth_mode = auth::Mode::None;
   auth::Credentials creds{};
   std::string virtual_host_suffix; // e.g. "s3.local"
-  std::size_t max_object_bytes = 64u * 1024u * 1024u; // 64 MiB
+  std::size_t max_object_bytes = 64u * 1024u * 1024u; // 64 MiB, also caps ?batch bodies
+  std::size_t max_batch_entries = 1000;
+  std::size_t max_batch_response_bytes = 64u * 1024u * 1024u; // 64 MiB of object data per ?batch read
+  std::size_t max_ranges = 64; // more specs in one Range header: whole object
 };
 
 using Request = http::request<http::vector_body<char>>;
-using Response = http::response<http::vector_body<char>>;
+using Response = http::response<PinnedBody>;
 
 class Api {
 public:
@@ -30,6 +34,10 @@ public:
 
   Response handle(const Request& req);
 
+  // 503 SlowDown for a request that was not handled because the server is
+  // saturated.
+  Response busy(const Request& req);
+
 private:
   storage::RocksObjectStore* store_;
   Config cfg_;
@@ -1,6 +1,7 @@
 #include "storage.hpp"
 #include "metrics.hpp"
 #include "util.hpp"
+#include "write_combiner.hpp"
 
 #include <chrono>
 #include <rocksdb/write_batch.h>
@@ -12,6 +13,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace storage {
@@ -74,21 +76,89 @@ static std::string data_key(std::string_view bucket, std::string_view key) {
   return k;
 }
 
+static std::string chunk_key(std::string_view bucket, std::string_view key, std::uint32_t idx) {
+  // Big-endian index so an object's chunks sort in offset order.
+  std::string k = data_key(bucket, key);
+  k.push_back('\0');
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    k.push_back(static_cast<char>((idx >> shift) & 0xff));
+  }
+  return k;
+}
+
+static std::uint32_t chunk_count(std::int64_t size, std::int64_t chunk_bytes) {
+  return static_cast<std::uint32_t>((size + chunk_bytes - 1) / chunk_bytes);
+}
+
+// Deletes an object's chunks from `from` on as one range over
+// D\0bucket\0key\0<chunk#>. Keys hold no NUL, so the range covers this
+// object only.
+static void delete_chunks(rocksdb::WriteBatch* batch, rocksdb::ColumnFamilyHandle* cf,
+                          std::string_view bucket, std::string_view key,
+                          std::uint32_t from) {
+  std::string end = data_key(bucket, key);
+  end.push_back('\x01');
+  batch->DeleteRange(cf, chunk_key(bucket, key, from), end);
+}
+
+// Deletes whatever data any version of the object may have left: the value
+// an unchunked write put at D\0bucket\0key and every chunk from `from` on.
+static void delete_data(rocksdb::WriteBatch* batch, rocksdb::ColumnFamilyHandle* cf,
+                        std::string_view bucket, std::string_view key,
+                        std::uint32_t from) {
+  batch->Delete(cf, data_key(bucket, key));
+  delete_chunks(batch, cf, bucket, key, from);
+}
+
+// Deletes what the version described by `old` leaves once a write of `n`
+// chunks replaces it: its unchunked value, or its chunks from n on if it
+// had more. A null `old` (unreadable metadata) drops everything past n.
+// New keys and overwrites that do not shrink write no tombstones.
+static void delete_replaced(rocksdb::WriteBatch* batch, rocksdb::ColumnFamilyHandle* cf,
+                            std::string_view bucket, std::string_view key,
+                            const ObjectMeta* old, std::uint32_t n) {
+  if (!old) {
+    delete_data(batch, cf, bucket, key, n);
+  } else if (old->chunk_bytes <= 0) {
+    batch->Delete(cf, data_key(bucket, key));
+  } else if (chunk_count(old->size, old->chunk_bytes) > n) {
+    delete_chunks(batch, cf, bucket, key, n);
+  }
+}
+
+// Binary metadata: a version byte, then size, mtime and chunk_bytes as
+// little-endian int64, the etag length as little-endian uint16, the etag and
+// the content type (rest of the value). Older values are text and start with
+// a digit.
+constexpr char kMetaBinaryV1 = '\x01';
+constexpr std::size_t kMetaHeaderBytes = 1 + 3 * 8 + 2;
+
+static void put_fixed(std::string* out, std::uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; ++i) out->push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+static std::uint64_t get_fixed(const char* p, int bytes) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) v |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return v;
+}
+
 static std::string encode_meta(const ObjectMeta& m) {
-  // size\0mtime\0etag\0content_type
   std::string out;
-  out.reserve(64 + m.etag.size() + m.content_type.size());
-  out += std::to_string(m.size);
-  out.push_back('\0');
-  out += std::to_string(m.mtime);
-  out.push_back('\0');
-  out += m.etag;
-  out.push_back('\0');
+  out.reserve(kMetaHeaderBytes + m.etag.size() + m.content_type.size());
+  out.push_back(kMetaBinaryV1);
+  put_fixed(&out, static_cast<std::uint64_t>(m.size), 8);
+  put_fixed(&out, static_cast<std::uint64_t>(m.mtime), 8);
+  put_fixed(&out, static_cast<std::uint64_t>(m.chunk_bytes), 8);
+  const std::size_t etag_len = std::min<std::size_t>(m.etag.size(), 0xffff);
+  put_fixed(&out, etag_len, 2);
+  out.append(m.etag, 0, etag_len);
   out += m.content_type;
   return out;
 }
 
-static std::optional<ObjectMeta> decode_meta(std::string_view v) {
+static std::optional<ObjectMeta> decode_meta_text(std::string_view v) {
+  // size\0mtime\0etag\0content_type[\0chunk_bytes]
   ObjectMeta m;
   size_t p1 = v.find('\0');
   if (p1 == std::string_view::npos) return std::nullopt;
@@ -109,23 +179,174 @@ static std::optional<ObjectMeta> decode_meta(std::string_view v) {
   if (!parse_i64(v.substr(p1 + 1, p2 - (p1 + 1)), &m.mtime)) return std::nullopt;
 
   m.etag = std::string(v.substr(p2 + 1, p3 - (p2 + 1)));
-  m.content_type = std::string(v.substr(p3 + 1));
+  // chunk_bytes is absent from metadata written before chunking.
+  size_t p4 = v.find('\0', p3 + 1);
+  m.content_type = std::string(v.substr(p3 + 1, p4 == std::string_view::npos ? std::string_view::npos : p4 - (p3 + 1)));
+  if (p4 != std::string_view::npos) {
+    if (!parse_i64(v.substr(p4 + 1), &m.chunk_bytes) || m.chunk_bytes < 0) return std::nullopt;
+  }
+  return m;
+}
+
+static std::optional<ObjectMeta> decode_meta(std::string_view v) {
+  if (v.empty() || v[0] != kMetaBinaryV1) return decode_meta_text(v);
+  if (v.size() < kMetaHeaderBytes) return std::nullopt;
+  ObjectMeta m;
+  m.size = static_cast<std::int64_t>(get_fixed(v.data() + 1, 8));
+  m.mtime = static_cast<std::int64_t>(get_fixed(v.data() + 9, 8));
+  m.chunk_bytes = static_cast<std::int64_t>(get_fixed(v.data() + 17, 8));
+  const std::size_t etag_len = static_cast<std::size_t>(get_fixed(v.data() + 25, 2));
+  if (m.size < 0 || m.chunk_bytes < 0 || v.size() - kMetaHeaderBytes < etag_len) return std::nullopt;
+  m.etag = std::string(v.substr(kMetaHeaderBytes, etag_len));
+  m.content_type = std::string(v.substr(kMetaHeaderBytes + etag_len));
   return m;
 }
 
+// Moves keys from the single-family layout. Each batch copies and deletes
+// together, so an interrupted migration resumes on the next open.
+static rocksdb::Status migrate_default_family(rocksdb::DB* d,
+                                              const ColumnFamilies& cfs,
+                                              std::uint64_t* migrated_keys) {
+  rocksdb::ColumnFamilyHandle* def = d->DefaultColumnFamily();
+  std::uint64_t moved = 0;
+  rocksdb::WriteBatch batch;
+  auto flush = [&]() {
+    if (batch.Count() == 0) return rocksdb::Status::OK();
+    auto ws = d->Write(rocksdb::WriteOptions{}, &batch);
+    batch.Clear();
+    return ws;
+  };
+  std::unique_ptr<rocksdb::Iterator> it(d->NewIterator(rocksdb::ReadOptions{}, def));
+  rocksdb::Status st;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    auto k = it->key();
+    if (k.size() < 2 || k.data()[1] != '\0') continue;
+    rocksdb::ColumnFamilyHandle* target = nullptr;
+    switch (k.data()[0]) {
+      case 'B': target = cfs.buckets; break;
+      case 'M': target = cfs.meta; break;
+      case 'D': target = cfs.data; break;
+      default: continue;
+    }
+    batch.Put(target, k, it->value());
+    batch.Delete(def, k);
+    moved++;
+    if (batch.GetDataSize() >= (8u << 20)) {
+      st = flush();
+      if (!st.ok()) return st;
+    }
+  }
+  st = it->status();
+  if (st.ok()) st = flush();
+  if (!st.ok()) return st;
+  it.reset();
+  if (moved > 0) {
+    // Drop the tombstones the move left in the default column family.
+    st = d->CompactRange(rocksdb::CompactRangeOptions{}, def, nullptr, nullptr);
+    if (!st.ok()) return st;
+  }
+  if (migrated_keys) *migrated_keys = moved;
+  return rocksdb::Status::OK();
+}
+
+rocksdb::Status open_db(const rocksdb::Options& opts,
+                        const ColumnFamilyOptionsSet& cf_opts,
+                        const std::string& path,
+                        rocksdb::DB** db,
+                        std::vector<rocksdb::ColumnFamilyHandle*>* handles,
+                        ColumnFamilies* cfs,
+                        std::uint64_t* migrated_keys) {
+  // Every existing column family must be opened; a missing DB has none yet.
+  std::vector<std::string> existing;
+  if (!rocksdb::DB::ListColumnFamilies(opts, path, &existing).ok()) existing.clear();
+
+  const std::pair<const char*, const rocksdb::ColumnFamilyOptions*> ours[] = {
+    {"buckets", &cf_opts.buckets}, {"meta", &cf_opts.meta}, {"data", &cf_opts.data}};
+  std::vector<rocksdb::ColumnFamilyDescriptor> descs;
+  descs.emplace_back(rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions(opts));
+  for (const auto& [name, cf_opt] : ours) descs.emplace_back(name, *cf_opt);
+  for (const auto& name : existing) {
+    bool known = false;
+    for (const auto& d : descs) known = known || d.name == name;
+    if (!known) descs.emplace_back(name, rocksdb::ColumnFamilyOptions(opts));
+  }
+
+  rocksdb::DBOptions db_opts(opts);
+  db_opts.create_missing_column_families = true;
+  handles->clear();
+  auto st = rocksdb::DB::Open(db_opts, path, descs, handles, db);
+  if (!st.ok()) return st;
+  cfs->buckets = (*handles)[1];
+  cfs->meta = (*handles)[2];
+  cfs->data = (*handles)[3];
+
+  st = migrate_default_family(*db, *cfs, migrated_keys);
+  if (!st.ok()) {
+    // Open succeeded: release the handles before the DB, as a caller would.
+    for (auto* h : *handles) (*db)->DestroyColumnFamilyHandle(h);
+    handles->clear();
+    delete *db;
+    *db = nullptr;
+  }
+  return st;
+}
+
+std::string PinnedRead::copy(std::size_t range) const {
+  std::string out;
+  for (auto piece : pieces[range]) out.append(piece.data(), piece.size());
+  return out;
+}
+
 RocksObjectStore::RocksObjectStore(rocksdb::DB* db,
                                    rocksdb::WriteOptions write_opts,
-                                   server::Metrics* metrics)
-    : db_(db), wo_(write_opts), metrics_(metrics) {}
+                                   server::Metrics* metrics,
+                                   std::int64_t chunk_bytes,
+                                   ColumnFamilies cfs)
+    : db_(db), wo_(write_opts), metrics_(metrics),
+      chunk_bytes_(chunk_bytes > 0 ? chunk_bytes : kDefaultChunkBytes),
+      buckets_cf_(cfs.buckets ? cfs.buckets : db->DefaultColumnFamily()),
+      meta_cf_(cfs.meta ? cfs.meta : db->DefaultColumnFamily()),
+      data_cf_(cfs.data ? cfs.data : db->DefaultColumnFamily()) {
+  load_buckets();
+}
+
+void RocksObjectStore::load_buckets() {
+  auto set = std::make_shared<BucketSet>();
+  auto start = Clock::now();
+  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(rocksdb::ReadOptions{}, buckets_cf_));
+  const std::string prefix = std::string("B\0", 2);
+  for (it->Seek(prefix); it->Valid(); it->Next()) {
+    auto k = it->key();
+    std::string_view ks(k.data(), k.size());
+    if (ks.rfind(prefix, 0) != 0) break;
+    set->emplace(ks.substr(prefix.size()));
+  }
+  auto st = it->status();
+  observe_rocksdb(metrics_, "iter", st, 0, start);
+  if (st.ok()) std::atomic_store(&buckets_, std::shared_ptr<const BucketSet>(std::move(set)));
+}
+
+rocksdb::Status RocksObjectStore::write(const std::function<void(rocksdb::WriteBatch*)>& fill,
+                                       std::size_t bytes) {
+  // The combiner records its own combined-write metrics.
+  if (combiner_) return combiner_->Write(fill);
+  rocksdb::WriteBatch batch;
+  fill(&batch);
+  auto start = Clock::now();
+  auto st = db_->Write(wo_, &batch);
+  observe_rocksdb(metrics_, "write", st, bytes, start);
+  return st;
+}
 
 bool RocksObjectStore::bucket_exists(std::string_view bucket, std::string* err) {
   if (contains_nul(bucket)) {
     if (err) *err = "Invalid bucket";
     return false;
   }
+  if (auto set = std::atomic_load(&buckets_)) return set->find(bucket) != set->end();
   std::string value;
   auto start = Clock::now();
-  auto st = db_->Get(rocksdb::ReadOptions{}, bucket_key(bucket), &value);
+  auto st = db_->Get(rocksdb::ReadOptions{}, buckets_cf_, bucket_key(bucket), &value);
   observe_rocksdb(metrics_, "get", st, value.size(), start);
   if (st.ok()) return true;
   if (st.IsNotFound()) return false;
@@ -139,30 +360,35 @@ bool RocksObjectStore::create_bucket(std::string_view bucket, std::string* err)
     return false;
   }
   // Idempotent
-  std::string value;
-  auto start = Clock::now();
-  auto st = db_->Get(rocksdb::ReadOptions{}, bucket_key(bucket), &value);
-  observe_rocksdb(metrics_, "get", st, value.size(), start);
-  if (st.ok()) return true;
-  if (!st.IsNotFound() && !st.ok()) {
-    if (err) *err = st.ToString();
+  std::lock_guard<std::mutex> lock(bucket_mu_);
+  std::string exists_err;
+  if (bucket_exists(bucket, &exists_err)) return true;
+  if (!exists_err.empty()) {
+    if (err) *err = exists_err;
     return false;
   }
-  start = Clock::now();
-  st = db_->Put(wo_, bucket_key(bucket), "");
+  auto start = Clock::now();
+  auto st = db_->Put(wo_, buckets_cf_, bucket_key(bucket), "");
   observe_rocksdb(metrics_, "put", st, 0, start);
   if (!st.ok()) {
     if (err) *err = st.ToString();
     return false;
   }
+  // Publish a new set; readers holding the old one are unaffected.
+  if (auto cur = std::atomic_load(&buckets_)) {
+    auto next = std::make_shared<BucketSet>(*cur);
+    next->emplace(bucket);
+    std::atomic_store(&buckets_, std::shared_ptr<const BucketSet>(std::move(next)));
+  }
   return true;
 }
 
 std::vector<std::string> RocksObjectStore::list_buckets(std::string* err) {
   std::vector<std::string> out;
+  if (auto set = std::atomic_load(&buckets_)) return std::vector<std::string>(set->begin(), set->end());
   rocksdb::ReadOptions ro;
   auto start = Clock::now();
-  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(ro));
+  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(ro, buckets_cf_));
 
   const std::string prefix = std::string("B\0", 2);
   for (it->Seek(prefix); it->Valid(); it->Next()) {
@@ -184,6 +410,7 @@ bool RocksObjectStore::delete_bucket(std::string_view bucket, std::string* err)
     if (err) *err = "Invalid bucket";
     return false;
   }
+  std::lock_guard<std::mutex> lock(bucket_mu_);
   // ensure exists
   if (!bucket_exists(bucket, err)) {
     if (err && err->empty()) *err = "NoSuchBucket";
@@ -192,7 +419,7 @@ bool RocksObjectStore::delete_bucket(std::string_view bucket, std::string* err)
 
   // check empty: any meta key with this bucket?
   rocksdb::ReadOptions ro;
-  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(ro));
+  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(ro, meta_cf_));
   const std::string mp = meta_prefix(bucket);
   it->Seek(mp);
   if (it->Valid()) {
@@ -209,12 +436,17 @@ bool RocksObjectStore::delete_bucket(std::string_view bucket, std::string* err)
   }
 
   auto start = Clock::now();
-  auto st = db_->Delete(wo_, bucket_key(bucket));
+  auto st = db_->Delete(wo_, buckets_cf_, bucket_key(bucket));
   observe_rocksdb(metrics_, "delete", st, 0, start);
   if (!st.ok()) {
     if (err) *err = st.ToString();
     return false;
   }
+  if (auto cur = std::atomic_load(&buckets_)) {
+    auto next = std::make_shared<BucketSet>(*cur);
+    next->erase(next->find(bucket));
+    std::atomic_store(&buckets_, std::shared_ptr<const BucketSet>(std::move(next)));
+  }
   return true;
 }
 
@@ -239,15 +471,33 @@ bool RocksObjectStore::put_object(std::string_view bucket, std::string_view key,
   // POC perf: skip MD5 computation (saves ~0.1-0.2ms per 65KB)
   m.etag = ""; // util::md5_hex(data);
   m.content_type = content_type.empty() ? "application/octet-stream" : std::string(content_type);
+  m.chunk_bytes = chunk_bytes_;
 
-  rocksdb::WriteBatch batch;
-  batch.Put(data_key(bucket, key), rocksdb::Slice(data.data(), data.size()));
-  const std::string meta_val = encode_meta(m);
-  batch.Put(meta_key(bucket, key), meta_val);
+  // The previous version's chunks past the new end (or its unchunked value)
+  // are deleted in the same batch. A writer racing between this read and
+  // the batch can leave chunks past our end; readers never look beyond the
+  // metadata's size, and DELETE drops every chunk of the key.
+  ObjectMeta old;
+  std::string stat_err;
+  const bool had_old = stat_object(bucket, key, &old, &stat_err);
+  if (!had_old && stat_err != "NoSuchKey" && stat_err != "Corrupt metadata") {
+    if (err) *err = stat_err;
+    return false;
+  }
 
-  auto start = Clock::now();
-  auto st = db_->Write(wo_, &batch);
-  observe_rocksdb(metrics_, "write", st, data.size(), start);
+  const std::uint32_t n = chunk_count(m.size, m.chunk_bytes);
+  const std::string meta_val = encode_meta(m);
+  auto st = write([&](rocksdb::WriteBatch* batch) {
+    for (std::uint32_t i = 0; i < n; ++i) {
+      const std::size_t off = static_cast<std::size_t>(i) * static_cast<std::size_t>(m.chunk_bytes);
+      const std::size_t len = std::min(data.size() - off, static_cast<std::size_t>(m.chunk_bytes));
+      batch->Put(data_cf_, chunk_key(bucket, key, i), rocksdb::Slice(data.data() + off, len));
+    }
+    if (had_old || stat_err == "Corrupt metadata") {
+      delete_replaced(batch, data_cf_, bucket, key, had_old ? &old : nullptr, n);
+    }
+    batch->Put(meta_cf_, meta_key(bucket, key), meta_val);
+  }, data.size());
   if (!st.ok()) {
     if (err) *err = st.ToString();
     return false;
@@ -268,10 +518,20 @@ bool RocksObjectStore::head_object(std::string_view bucket, std::string_view key
     if (err && err->empty()) *err = "NoSuchBucket";
     return false;
   }
+  return stat_object(bucket, key, out_meta, err);
+}
+
+bool RocksObjectStore::stat_object(std::string_view bucket, std::string_view key,
+                                  ObjectMeta* out_meta,
+                                  std::string* err) {
+  if (contains_nul(bucket) || contains_nul(key)) {
+    if (err) *err = "Invalid bucket/key";
+    return false;
+  }
 
   std::string meta_val;
   auto start = Clock::now();
-  auto st = db_->Get(rocksdb::ReadOptions{}, meta_key(bucket, key), &meta_val);
+  auto st = db_->Get(rocksdb::ReadOptions{}, meta_cf_, meta_key(bucket, key), &meta_val);
   observe_rocksdb(metrics_, "get", st, meta_val.size(), start);
   if (st.IsNotFound()) {
     if (err) *err = "NoSuchKey";
@@ -290,27 +550,103 @@ bool RocksObjectStore::head_object(std::string_view bucket, std::string_view key
   return true;
 }
 
+bool RocksObjectStore::open_object(std::string_view bucket, std::string_view key,
+                                  ObjectMeta* out_meta,
+                                  PinnedRead* out,
+                                  std::string* err,
+                                  std::int64_t first_offset,
+                                  std::int64_t end_offset) {
+  if (contains_nul(bucket) || contains_nul(key)) {
+    if (err) *err = "Invalid bucket/key";
+    return false;
+  }
+  if (!bucket_exists(bucket, err)) {
+    if (err && err->empty()) *err = "NoSuchBucket";
+    return false;
+  }
+  return fetch_object(bucket, key, out_meta, out, err, first_offset, end_offset);
+}
+
+bool RocksObjectStore::fetch_object(std::string_view bucket, std::string_view key,
+                                   ObjectMeta* out_meta,
+                                   PinnedRead* out,
+                                   std::string* err,
+                                   std::int64_t first_offset,
+                                   std::int64_t end_offset) {
+  // Objects are written with the current chunk size, so a read starting past
+  // it will not use chunk 0; read_ranges copes if the object's size differs.
+  const std::size_t n = first_offset < chunk_bytes_ ? 2 : 1;
+  const std::string mk = meta_key(bucket, key);
+  const std::string ck = n == 2 ? chunk_key(bucket, key, 0) : std::string();
+  rocksdb::ColumnFamilyHandle* cfs[2] = {meta_cf_, data_cf_};
+  rocksdb::Slice keys[2] = {mk, ck};
+  out->pieces.clear();
+  out->prefetched = false;
+  // One MultiGet reads the metadata and chunk 0 consistently on its own, so
+  // reads that stay in chunk 0 take no snapshot. Those reaching further are
+  // read again under one (taken up front when chunk 0 is skipped), which
+  // read_ranges then fetches the other chunks under.
+  out->snapshot = n == 1 ? snapshot() : nullptr;
+  std::optional<ObjectMeta> m;
+  rocksdb::Status statuses[2];
+  while (true) {
+    out->values.clear();
+    out->values.resize(n);
+    rocksdb::ReadOptions ro;
+    ro.snapshot = out->snapshot.get();
+    auto start = Clock::now();
+    db_->MultiGet(ro, n, cfs, keys, out->values.data(), statuses, false);
+    observe_rocksdb(metrics_, "multiget", statuses[0].ok() && n == 2 ? statuses[1] : statuses[0],
+                    out->values[0].size() + (n == 2 ? out->values[1].size() : 0), start);
+    if (statuses[0].IsNotFound()) {
+      if (err) *err = "NoSuchKey";
+      return false;
+    }
+    if (!statuses[0].ok()) {
+      if (err) *err = statuses[0].ToString();
+      return false;
+    }
+    m = decode_meta(std::string_view(out->values[0].data(), out->values[0].size()));
+    if (!m) {
+      if (err) *err = "Corrupt metadata";
+      return false;
+    }
+    const std::int64_t end = std::min(end_offset, m->size);
+    const bool beyond_chunk0 = m->chunk_bytes > 0 ? end > m->chunk_bytes : end > 0;
+    if (out->snapshot || !beyond_chunk0) break;
+    out->snapshot = snapshot();
+  }
+  // Keep only chunk 0; moving a PinnableSlice keeps its pin. If it is missing
+  // (empty or unchunked object) or unreadable, read_ranges reads normally.
+  if (n == 2 && statuses[1].ok() && m->chunk_bytes > 0) {
+    std::vector<rocksdb::PinnableSlice> chunk(1);
+    chunk[0] = std::move(out->values[1]);
+    out->values = std::move(chunk);
+    out->prefetched = true;
+  } else {
+    out->values.clear();
+  }
+  if (out_meta) *out_meta = std::move(*m);
+  return true;
+}
+
+std::shared_ptr<const rocksdb::Snapshot> RocksObjectStore::snapshot() {
+  rocksdb::DB* db = db_;
+  return std::shared_ptr<const rocksdb::Snapshot>(
+      db->GetSnapshot(), [db](const rocksdb::Snapshot* s) { db->ReleaseSnapshot(s); });
+}
+
 bool RocksObjectStore::get_object(std::string_view bucket, std::string_view key,
                                  std::string* out_data,
                                  ObjectMeta* out_meta,
                                  std::string* err) {
   ObjectMeta m;
-  if (!head_object(bucket, key, &m, err)) return false;
+  PinnedRead read;
+  if (!open_object(bucket, key, &m, &read, err)) return false;
 
-  std::string data_val;
-  auto start = Clock::now();
-  auto st = db_->Get(rocksdb::ReadOptions{}, data_key(bucket, key), &data_val);
-  observe_rocksdb(metrics_, "get", st, data_val.size(), start);
-  if (st.IsNotFound()) {
-    if (err) *err = "NoSuchKey";
-    return false;
-  }
-  if (!st.ok()) {
-    if (err) *err = st.ToString();
-    return false;
-  }
+  if (!read_ranges(bucket, key, m, {ReadRange{0, m.size}}, &read, err)) return false;
 
-  if (out_data) *out_data = std::move(data_val);
+  if (out_data) *out_data = read.copy(0);
   if (out_meta) *out_meta = std::move(m);
   return true;
 }
@@ -322,21 +658,164 @@ bool RocksObjectStore::get_object_data(std::string_view bucket, std::string_view
     if (err) *err = "Invalid bucket/key";
     return false;
   }
+  ObjectMeta m;
+  PinnedRead read;
+  if (!fetch_object(bucket, key, &m, &read, err)) return false;
+  if (!read_ranges(bucket, key, m, {ReadRange{0, m.size}}, &read, err)) return false;
 
-  std::string data_val;
-  auto start = Clock::now();
-  auto st = db_->Get(rocksdb::ReadOptions{}, data_key(bucket, key), &data_val);
-  observe_rocksdb(metrics_, "get", st, data_val.size(), start);
-  if (st.IsNotFound()) {
-    if (err) *err = "NoSuchKey";
+  if (out_data) *out_data = read.copy(0);
+  return true;
+}
+
+bool RocksObjectStore::read_ranges(std::string_view bucket, std::string_view key,
+                                  const ObjectMeta& meta,
+                                  const std::vector<ReadRange>& ranges,
+                                  PinnedRead* out,
+                                  std::string* err) {
+  if (contains_nul(bucket) || contains_nul(key)) {
+    if (err) *err = "Invalid bucket/key";
     return false;
   }
-  if (!st.ok()) {
-    if (err) *err = st.ToString();
-    return false;
+  for (const auto& r : ranges) {
+    if (r.offset < 0 || r.length < 0 || r.offset + r.length > meta.size) {
+      if (err) *err = "InvalidRange";
+      return false;
+    }
+  }
+  // Chunks are read under open_object's snapshot, if it took one, released
+  // on return (the pinned values do not need it).
+  rocksdb::ReadOptions ro;
+  ro.snapshot = out->snapshot.get();
+  const auto held = std::move(out->snapshot);
+
+  // A chunk 0 pinned by open_object serves every range that stays inside it,
+  // and is kept (not fetched again) when some range reaches further.
+  bool have_chunk0 = false;
+  rocksdb::PinnableSlice chunk0;
+  if (out->prefetched && meta.chunk_bytes > 0 && out->values.size() == 1 &&
+      static_cast<std::int64_t>(out->values.front().size()) == std::min(meta.chunk_bytes, meta.size)) {
+    bool covered = true;
+    for (const auto& r : ranges) {
+      if (r.length > 0 && r.offset + r.length > meta.chunk_bytes) covered = false;
+    }
+    if (covered) {
+      out->prefetched = false;
+      const auto& value = out->values.front();
+      out->pieces.assign(ranges.size(), {});
+      for (std::size_t i = 0; i < ranges.size(); ++i) {
+        if (ranges[i].length == 0) continue;
+        out->pieces[i].emplace_back(value.data() + ranges[i].offset, static_cast<std::size_t>(ranges[i].length));
+      }
+      return true;
+    }
+    // Moving a PinnableSlice keeps its pin.
+    chunk0 = std::move(out->values.front());
+    have_chunk0 = true;
+  }
+  out->prefetched = false;
+
+  // values is sized once below and never resized, so the views handed out
+  // stay valid when out is moved.
+  out->values.clear();
+  out->pieces.assign(ranges.size(), {});
+
+  if (meta.chunk_bytes <= 0) {
+    // Unchunked object: the whole value is pinned and sliced.
+    out->values.resize(1);
+    auto& value = out->values.front();
+    auto start = Clock::now();
+    auto st = db_->Get(ro, data_cf_, data_key(bucket, key), &value);
+    observe_rocksdb(metrics_, "get", st, value.size(), start);
+    if (st.IsNotFound()) {
+      if (err) *err = "NoSuchKey";
+      return false;
+    }
+    if (!st.ok()) {
+      if (err) *err = st.ToString();
+      return false;
+    }
+    if (static_cast<std::int64_t>(value.size()) != meta.size) {
+      if (err) *err = "Corrupt object data";
+      return false;
+    }
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      if (ranges[i].length == 0) continue;
+      out->pieces[i].emplace_back(value.data() + ranges[i].offset, static_cast<std::size_t>(ranges[i].length));
+    }
+    return true;
+  }
+
+  const std::int64_t cb = meta.chunk_bytes;
+  std::vector<std::uint32_t> chunks;
+  for (const auto& r : ranges) {
+    if (r.length == 0) continue;
+    for (std::int64_t c = r.offset / cb; c <= (r.offset + r.length - 1) / cb; ++c) {
+      chunks.push_back(static_cast<std::uint32_t>(c));
+    }
+  }
+  std::sort(chunks.begin(), chunks.end());
+  chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+
+  // The kept chunk 0 takes the first slot; the rest come from one MultiGet.
+  // Chunk keys of one object sort like their indices, so the batch is
+  // already in key order.
+  out->values.resize(chunks.size());
+  auto& values = out->values;
+  std::size_t skip = 0;
+  if (have_chunk0 && !chunks.empty() && chunks.front() == 0) {
+    values[0] = std::move(chunk0);
+    skip = 1;
+  }
+  std::vector<std::string> keys;
+  std::vector<rocksdb::Slice> key_slices;
+  keys.reserve(chunks.size() - skip);
+  key_slices.reserve(chunks.size() - skip);
+  for (std::size_t i = skip; i < chunks.size(); ++i) {
+    keys.push_back(chunk_key(bucket, key, chunks[i]));
+    key_slices.emplace_back(keys.back());
+  }
+  std::vector<rocksdb::Status> statuses(chunks.size());
+  if (!keys.empty()) {
+    auto start = Clock::now();
+    db_->MultiGet(ro, data_cf_, keys.size(),
+                  key_slices.data(), values.data() + skip, statuses.data() + skip, true);
+    std::size_t bytes = 0;
+    rocksdb::Status first_err;
+    for (std::size_t i = skip; i < chunks.size(); ++i) {
+      bytes += values[i].size();
+      if (!statuses[i].ok() && first_err.ok()) first_err = statuses[i];
+    }
+    observe_rocksdb(metrics_, "multiget", first_err, bytes, start);
+  }
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    if (statuses[i].IsNotFound()) {
+      if (err) *err = "NoSuchKey";
+      return false;
+    }
+    if (!statuses[i].ok()) {
+      if (err) *err = statuses[i].ToString();
+      return false;
+    }
+    const std::int64_t want = std::min(cb, meta.size - static_cast<std::int64_t>(chunks[i]) * cb);
+    if (static_cast<std::int64_t>(values[i].size()) != want) {
+      if (err) *err = "Corrupt object data";
+      return false;
+    }
   }
 
-  if (out_data) *out_data = std::move(data_val);
+  for (std::size_t r = 0; r < ranges.size(); ++r) {
+    std::int64_t pos = ranges[r].offset;
+    const std::int64_t end = ranges[r].offset + ranges[r].length;
+    while (pos < end) {
+      const auto c = static_cast<std::uint32_t>(pos / cb);
+      const std::size_t i = static_cast<std::size_t>(
+          std::lower_bound(chunks.begin(), chunks.end(), c) - chunks.begin());
+      const std::int64_t in_chunk = pos - static_cast<std::int64_t>(c) * cb;
+      const std::int64_t n = std::min(end - pos, cb - in_chunk);
+      out->pieces[r].emplace_back(values[i].data() + in_chunk, static_cast<std::size_t>(n));
+      pos += n;
+    }
+  }
   return true;
 }
 
@@ -350,16 +829,315 @@ bool RocksObjectStore::delete_object(std::string_view bucket, std::string_view k
     if (err && err->empty()) *err = "NoSuchBucket";
     return false;
   }
-  rocksdb::WriteBatch batch;
-  batch.Delete(meta_key(bucket, key));
-  batch.Delete(data_key(bucket, key));
-  auto start = Clock::now();
-  auto st = db_->Write(wo_, &batch);
-  observe_rocksdb(metrics_, "write", st, 0, start);
+  // Blind delete: a missing key is a no-op, as in S3.
+  auto st = write([&](rocksdb::WriteBatch* batch) {
+    batch->Delete(meta_cf_, meta_key(bucket, key));
+    delete_data(batch, data_cf_, bucket, key, 0);
+  }, 0);
+  if (!st.ok()) {
+    if (err) *err = st.ToString();
+    return false;
+  }
+  return true;
+}
+
+bool RocksObjectStore::read_objects(std::string_view bucket,
+                                   const std::vector<ObjectRead>& reads,
+                                   std::vector<ObjectReadResult>* results,
+                                   PinnedRead* out,
+                                   std::string* err,
+                                   std::uint64_t max_bytes) {
+  if (contains_nul(bucket)) {
+    if (err) *err = "Invalid bucket";
+    return false;
+  }
+  if (!bucket_exists(bucket, err)) {
+    if (err && err->empty()) *err = "NoSuchBucket";
+    return false;
+  }
+  const std::size_t n = reads.size();
+  results->assign(n, ObjectReadResult{});
+  out->values.clear();
+  out->pieces.assign(n, {});
+  out->prefetched = false;
+
+  // Round one: metadata of every entry, across both families with chunk 0
+  // of those whose range starts in it (by the current chunk size).
+  struct Entry {
+    std::size_t read;    // index into reads
+    std::size_t meta;    // index into keys
+    std::size_t chunk0;  // index into keys, or kNone
+  };
+  constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+  std::vector<Entry> entries;
+  std::vector<std::string> keys;
+  std::vector<rocksdb::ColumnFamilyHandle*> cfs;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (reads[i].key.empty() || contains_nul(reads[i].key)) {
+      (*results)[i].err = "Invalid bucket/key";
+      continue;
+    }
+    Entry e{i, keys.size(), kNone};
+    keys.push_back(meta_key(bucket, reads[i].key));
+    cfs.push_back(meta_cf_);
+    if (reads[i].offset >= 0 && reads[i].offset < chunk_bytes_ && reads[i].length != 0) {
+      e.chunk0 = keys.size();
+      keys.push_back(chunk_key(bucket, reads[i].key, 0));
+      cfs.push_back(data_cf_);
+    }
+    entries.push_back(e);
+  }
+  // Round one needs no snapshot: one MultiGet is consistent on its own, so
+  // entries served from it alone match their metadata. If any entry needs
+  // round two, round one is read again under a snapshot and round two uses
+  // the same one, so an entry's metadata and chunks are from one version.
+  std::shared_ptr<const rocksdb::Snapshot> snap;
+  rocksdb::ReadOptions ro;
+  std::vector<rocksdb::Slice> key_slices(keys.begin(), keys.end());
+  std::vector<rocksdb::PinnableSlice> first;
+  std::vector<rocksdb::Status> first_st;
+
+  // Resolve each range and plan where its chunks come from: chunk 0 from
+  // round one, anything else from round two.
+  struct Slot {
+    bool extra;
+    std::size_t index;  // into the chunk 0 moves or the round-two keys
+  };
+  std::vector<std::vector<Slot>> slots;
+  std::vector<std::size_t> reused;  // indices into first
+  std::vector<std::string> extra_keys;
+  while (true) {
+    first.clear();
+    first.resize(keys.size());
+    first_st.assign(keys.size(), rocksdb::Status());
+    if (!keys.empty()) {
+      auto start = Clock::now();
+      db_->MultiGet(ro, keys.size(), cfs.data(), key_slices.data(),
+                    first.data(), first_st.data(), false);
+      std::size_t bytes = 0;
+      rocksdb::Status first_err;
+      for (std::size_t k = 0; k < keys.size(); ++k) {
+        bytes += first[k].size();
+        if (!first_st[k].ok() && !first_st[k].IsNotFound() && first_err.ok()) first_err = first_st[k];
+      }
+      observe_rocksdb(metrics_, "multiget", first_err, bytes, start);
+    }
+
+    slots.assign(n, {});
+    reused.clear();
+    extra_keys.clear();
+    std::uint64_t total_bytes = 0;
+    for (const auto& e : entries) {
+      const std::size_t i = e.read;
+      auto& r = (*results)[i];
+      r = ObjectReadResult{};
+      const auto& meta_st = first_st[e.meta];
+      if (meta_st.IsNotFound()) {
+        r.err = "NoSuchKey";
+        continue;
+      }
+      if (!meta_st.ok()) {
+        r.err = meta_st.ToString();
+        continue;
+      }
+      auto m = decode_meta(std::string_view(first[e.meta].data(), first[e.meta].size()));
+      if (!m) {
+        r.err = "Corrupt metadata";
+        continue;
+      }
+      r.meta = std::move(*m);
+      const std::int64_t off = reads[i].offset;
+      if (off < 0 || off > r.meta.size) {
+        r.err = "InvalidRange";
+        continue;
+      }
+      const std::int64_t len = reads[i].length < 0 ? r.meta.size - off : reads[i].length;
+      if (len > r.meta.size - off) {
+        r.err = "InvalidRange";
+        continue;
+      }
+      r.range = ReadRange{off, len};
+      total_bytes += static_cast<std::uint64_t>(len);
+      if (len == 0) continue;
+
+      if (r.meta.chunk_bytes <= 0) {
+        slots[i].push_back(Slot{true, extra_keys.size()});
+        extra_keys.push_back(data_key(bucket, reads[i].key));
+        continue;
+      }
+      const std::int64_t cb = r.meta.chunk_bytes;
+      for (std::int64_t c = off / cb; c <= (off + len - 1) / cb; ++c) {
+        if (c == 0 && e.chunk0 != kNone && first_st[e.chunk0].ok()) {
+          slots[i].push_back(Slot{false, reused.size()});
+          reused.push_back(e.chunk0);
+        } else {
+          slots[i].push_back(Slot{true, extra_keys.size()});
+          extra_keys.push_back(chunk_key(bucket, reads[i].key, static_cast<std::uint32_t>(c)));
+        }
+      }
+    }
+
+    // Checked before round two, so an oversized batch pins no more chunks.
+    if (total_bytes > max_bytes) {
+      results->clear();
+      out->pieces.clear();
+      if (err) *err = "ResponseTooLarge";
+      return false;
+    }
+
+    if (snap || extra_keys.empty()) break;
+    snap = snapshot();
+    ro.snapshot = snap.get();
+  }
+
+  // values is sized once: reused chunk 0s (moved, which keeps their pins),
+  // then the round-two results.
+  const std::size_t base = reused.size();
+  out->values.resize(base + extra_keys.size());
+  for (std::size_t k = 0; k < base; ++k) out->values[k] = std::move(first[reused[k]]);
+  std::vector<rocksdb::Status> extra_st(extra_keys.size());
+  if (!extra_keys.empty()) {
+    std::vector<rocksdb::Slice> extra_slices(extra_keys.begin(), extra_keys.end());
+    auto start = Clock::now();
+    db_->MultiGet(ro, data_cf_, extra_keys.size(), extra_slices.data(),
+                  out->values.data() + base, extra_st.data(), false);
+    std::size_t bytes = 0;
+    rocksdb::Status first_err;
+    for (std::size_t k = 0; k < extra_keys.size(); ++k) {
+      bytes += out->values[base + k].size();
+      if (!extra_st[k].ok() && first_err.ok()) first_err = extra_st[k];
+    }
+    observe_rocksdb(metrics_, "multiget", first_err, bytes, start);
+  }
+
+  for (std::size_t i = 0; i < n; ++i) {
+    auto& r = (*results)[i];
+    if (slots[i].empty()) continue;
+    const std::int64_t cb = r.meta.chunk_bytes;
+    const std::int64_t first_chunk = cb > 0 ? r.range.offset / cb : 0;
+    for (std::size_t s = 0; s < slots[i].size() && r.err.empty(); ++s) {
+      if (slots[i][s].extra) {
+        const auto& st = extra_st[slots[i][s].index];
+        if (st.IsNotFound()) r.err = "NoSuchKey";
+        else if (!st.ok()) r.err = st.ToString();
+        if (!r.err.empty()) break;
+      }
+      const auto& value = out->values[slots[i][s].extra ? base + slots[i][s].index : slots[i][s].index];
+      const std::int64_t c = first_chunk + static_cast<std::int64_t>(s);
+      const std::int64_t want = cb > 0 ? std::min(cb, r.meta.size - c * cb) : r.meta.size;
+      if (static_cast<std::int64_t>(value.size()) != want) r.err = "Corrupt object data";
+    }
+    if (!r.err.empty()) continue;
+
+    if (cb <= 0) {
+      const auto& value = out->values[base + slots[i].front().index];
+      out->pieces[i].emplace_back(value.data() + r.range.offset, static_cast<std::size_t>(r.range.length));
+      continue;
+    }
+    std::int64_t pos = r.range.offset;
+    const std::int64_t end = r.range.offset + r.range.length;
+    for (const auto& slot : slots[i]) {
+      const auto& value = out->values[slot.extra ? base + slot.index : slot.index];
+      const std::int64_t in_chunk = pos % cb;
+      const std::int64_t take = std::min(end - pos, cb - in_chunk);
+      out->pieces[i].emplace_back(value.data() + in_chunk, static_cast<std::size_t>(take));
+      pos += take;
+    }
+  }
+  return true;
+}
+
+bool RocksObjectStore::put_objects(std::string_view bucket,
+                                  const std::vector<ObjectWrite>& writes,
+                                  std::vector<ObjectMeta>* out_metas,
+                                  std::string* err) {
+  if (contains_nul(bucket)) {
+    if (err) *err = "Invalid bucket/key";
+    return false;
+  }
+  for (const auto& w : writes) {
+    if (w.key.empty() || contains_nul(w.key)) {
+      if (err) *err = "Invalid bucket/key";
+      return false;
+    }
+  }
+  // Like put_object, no bucket check.
+
+  // Current metadata of every key in one MultiGet, for the stale chunks
+  // each write replaces.
+  std::vector<std::string> keys;
+  keys.reserve(writes.size());
+  for (const auto& w : writes) keys.push_back(meta_key(bucket, w.key));
+  std::vector<rocksdb::Slice> key_slices(keys.begin(), keys.end());
+  std::vector<rocksdb::PinnableSlice> values(keys.size());
+  std::vector<rocksdb::Status> statuses(keys.size());
+  if (!keys.empty()) {
+    auto start = Clock::now();
+    db_->MultiGet(rocksdb::ReadOptions{}, meta_cf_, keys.size(), key_slices.data(),
+                  values.data(), statuses.data(), false);
+    std::size_t bytes = 0;
+    rocksdb::Status first_err;
+    for (std::size_t k = 0; k < keys.size(); ++k) {
+      bytes += values[k].size();
+      if (!statuses[k].ok() && !statuses[k].IsNotFound() && first_err.ok()) first_err = statuses[k];
+    }
+    observe_rocksdb(metrics_, "multiget", first_err, bytes, start);
+    if (!first_err.ok()) {
+      if (err) *err = first_err.ToString();
+      return false;
+    }
+  }
+
+  // What each entry replaces: the stored object, or an earlier entry for
+  // the same key. existed[i] with an empty replaced[i] means unreadable
+  // metadata.
+  std::vector<ObjectMeta> metas(writes.size());
+  std::vector<std::optional<ObjectMeta>> replaced(writes.size());
+  std::vector<bool> existed(writes.size());
+  std::unordered_map<std::string_view, std::size_t> latest;
+  const std::int64_t now = util::unix_now_seconds();
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < writes.size(); ++i) {
+    const auto& w = writes[i];
+    auto& m = metas[i];
+    m.size = static_cast<std::int64_t>(w.data.size());
+    m.mtime = now;
+    m.content_type = w.content_type.empty() ? "application/octet-stream" : std::string(w.content_type);
+    m.chunk_bytes = chunk_bytes_;
+    if (auto it = latest.find(w.key); it != latest.end()) {
+      replaced[i] = metas[it->second];
+      existed[i] = true;
+    } else if (statuses[i].ok()) {
+      replaced[i] = decode_meta(std::string_view(values[i].data(), values[i].size()));
+      existed[i] = true;
+    }
+    latest[w.key] = i;
+    bytes += w.data.size();
+  }
+
+  auto st = write([&](rocksdb::WriteBatch* batch) {
+    for (std::size_t i = 0; i < writes.size(); ++i) {
+      const auto& w = writes[i];
+      const auto& m = metas[i];
+      const std::uint32_t n = chunk_count(m.size, m.chunk_bytes);
+      for (std::uint32_t c = 0; c < n; ++c) {
+        const std::size_t off = static_cast<std::size_t>(c) * static_cast<std::size_t>(m.chunk_bytes);
+        const std::size_t len = std::min(w.data.size() - off, static_cast<std::size_t>(m.chunk_bytes));
+        batch->Put(data_cf_, chunk_key(bucket, w.key, c), rocksdb::Slice(w.data.data() + off, len));
+      }
+      // An earlier entry's chunks for the same key are dropped the same
+      // way: the deletes follow them in the batch.
+      if (existed[i]) {
+        delete_replaced(batch, data_cf_, bucket, w.key, replaced[i] ? &*replaced[i] : nullptr, n);
+      }
+      batch->Put(meta_cf_, meta_key(bucket, w.key), encode_meta(m));
+    }
+  }, bytes);
   if (!st.ok()) {
     if (err) *err = st.ToString();
     return false;
   }
+  if (out_metas) *out_metas = std::move(metas);
   return true;
 }
 
@@ -398,7 +1176,7 @@ ListResult RocksObjectStore::list_objects_v2(std::string_view bucket,
 
   rocksdb::ReadOptions ro;
   auto start = Clock::now();
-  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(ro));
+  std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(ro, meta_cf_));
   it->Seek(seek_key);
 
   // If continuation token points at an existing key, start *after* it.
@@ -434,7 +1212,7 @@ ListResult RocksObjectStore::list_objects_v2(std::string_view bucket,
     count++;
     if (count >= max_keys) {
       // see if there is another matching key
-      auto it2 = std::unique_ptr<rocksdb::Iterator>(db_->NewIterator(ro));
+      auto it2 = std::unique_ptr<rocksdb::Iterator>(db_->NewIterator(ro, meta_cf_));
       it2->Seek(last_meta_key);
       if (it2->Valid()) it2->Next();
       if (it2->Valid()) {
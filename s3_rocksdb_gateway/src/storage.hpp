@@ -1,7 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -14,13 +19,89 @@ class Metrics;
 
 namespace storage {
 
+class WriteCombiner;
+
 struct ObjectMeta {
   std::string etag;        // hex md5
   std::int64_t mtime = 0;  // epoch seconds
   std::int64_t size = 0;
   std::string content_type;
+  // Size of the D\0bucket\0key\0<chunk#> values the object is split into;
+  // 0 for objects written before chunking (one value at D\0bucket\0key).
+  std::int64_t chunk_bytes = 0;
+};
+
+// Byte span of an object to read; offset + length must not exceed its size.
+struct ReadRange {
+  std::int64_t offset = 0;
+  std::int64_t length = 0;
+};
+
+// One entry of a batched read: a byte span of an object, to its end when
+// length is negative.
+struct ObjectRead {
+  std::string key;
+  std::int64_t offset = 0;
+  std::int64_t length = -1;
+};
+
+// Outcome of one batched read; err is empty on success and range is the
+// resolved span.
+struct ObjectReadResult {
+  std::string err;
+  ObjectMeta meta;
+  ReadRange range;
+};
+
+struct ObjectWrite {
+  std::string_view key;
+  std::string_view data;
+  std::string_view content_type;
+};
+
+// Result of read_ranges: values pinned in RocksDB memory (block cache or
+// memtable) and, per requested range, the spans of them that make it up.
+// Views stay valid while this object lives; it is not copyable.
+struct PinnedRead {
+  std::vector<rocksdb::PinnableSlice> values;
+  std::vector<std::vector<std::string_view>> pieces;
+  // values[0] is the object's chunk 0, fetched by open_object.
+  bool prefetched = false;
+  // The snapshot open_object read the metadata under, if the object reaches
+  // past chunk 0. read_ranges reads the other chunks under it too, so a
+  // concurrent overwrite cannot mix versions, then releases it.
+  std::shared_ptr<const rocksdb::Snapshot> snapshot;
+
+  std::string copy(std::size_t range) const;
+};
+
+// Column families holding each kind of key. A null handle means the default
+// column family, the single-family layout older databases use.
+struct ColumnFamilies {
+  rocksdb::ColumnFamilyHandle* buckets = nullptr;  // B\0<bucket>
+  rocksdb::ColumnFamilyHandle* meta = nullptr;     // M\0<bucket>\0<key>
+  rocksdb::ColumnFamilyHandle* data = nullptr;     // D\0<bucket>\0<key>\0<chunk#>
 };
 
+struct ColumnFamilyOptionsSet {
+  rocksdb::ColumnFamilyOptions buckets;
+  rocksdb::ColumnFamilyOptions meta;
+  rocksdb::ColumnFamilyOptions data;
+};
+
+// Opens the database at path with the "buckets", "meta" and "data" column
+// families, creating them if needed, and moves keys an older single-family
+// layout left in the default column family into them. handles receives every
+// opened handle; destroy them before deleting the DB. On failure *db is null
+// and handles is empty.
+rocksdb::Status open_db(const rocksdb::Options& opts,
+                        const ColumnFamilyOptionsSet& cf_opts,
+                        const std::string& path,
+                        rocksdb::DB** db,
+                        std::vector<rocksdb::ColumnFamilyHandle*>* handles,
+                        ColumnFamilies* cfs,
+                        std::uint64_t* migrated_keys = nullptr);
+
 struct ListedObject {
   std::string key;
   ObjectMeta meta;
@@ -34,11 +115,22 @@ struct ListResult {
 
 class RocksObjectStore {
 public:
+  static constexpr std::int64_t kDefaultChunkBytes = 1 << 20;
+
   explicit RocksObjectStore(rocksdb::DB* db,
                             rocksdb::WriteOptions write_opts = rocksdb::WriteOptions{},
-                            server::Metrics* metrics = nullptr);
-
-  // Buckets
+                            server::Metrics* metrics = nullptr,
+                            std::int64_t chunk_bytes = kDefaultChunkBytes,
+                            ColumnFamilies cfs = ColumnFamilies{});
+
+  // Routes object PUT/DELETE batches through group commit; set before
+  // serving. nullptr writes each batch on its own.
+  void set_write_combiner(WriteCombiner* combiner) { combiner_ = combiner; }
+
+  // Buckets. Existence checks and listing are answered from an in-memory
+  // copy of the bucket family, loaded at construction and replaced on
+  // create/delete; readers do not touch RocksDB or take bucket_mu_, only
+  // the short lock inside std::atomic_load.
   bool bucket_exists(std::string_view bucket, std::string* err);
   bool create_bucket(std::string_view bucket, std::string* err);
   bool delete_bucket(std::string_view bucket, std::string* err);
@@ -64,9 +156,57 @@ public:
                    ObjectMeta* out_meta,
                    std::string* err);
 
+  // Metadata only, without the bucket check head_object does.
+  bool stat_object(std::string_view bucket, std::string_view key,
+                   ObjectMeta* out_meta,
+                   std::string* err);
+
+  // head_object plus the object's first chunk, both from one MultiGet, so a
+  // GET of an object that fits in a chunk costs one lookup. out keeps the
+  // chunk pinned for the read_ranges call that follows. first_offset is the
+  // lowest offset the caller will read (0 if unknown); when it lies past the
+  // first chunk, only the metadata is fetched. end_offset is one past the
+  // highest (max if unknown); if the read may reach past chunk 0, the lookup
+  // is done under a snapshot that read_ranges keeps using.
+  bool open_object(std::string_view bucket, std::string_view key,
+                   ObjectMeta* out_meta,
+                   PinnedRead* out,
+                   std::string* err,
+                   std::int64_t first_offset = 0,
+                   std::int64_t end_offset = std::numeric_limits<std::int64_t>::max());
+
+  // Pins the chunks that the ranges of a previously stat'ed object overlap,
+  // fetched in one MultiGet, without copying them. Replaces out's contents,
+  // reusing the chunk 0 open_object left there instead of fetching it again.
+  bool read_ranges(std::string_view bucket, std::string_view key,
+                   const ObjectMeta& meta,
+                   const std::vector<ReadRange>& ranges,
+                   PinnedRead* out,
+                   std::string* err);
+
   bool delete_object(std::string_view bucket, std::string_view key,
                      std::string* err);
 
+  // Batched reads from one bucket: every entry's metadata, and chunk 0 for
+  // entries whose range starts in it, come from one MultiGet, and the other
+  // chunks any range reaches from a second one. out->pieces[i] holds entry
+  // i's bytes; entries fail individually (results[i].err), the call only for
+  // an unknown bucket or when the ranges add up to more than max_bytes
+  // ("ResponseTooLarge").
+  bool read_objects(std::string_view bucket,
+                    const std::vector<ObjectRead>& reads,
+                    std::vector<ObjectReadResult>* results,
+                    PinnedRead* out,
+                    std::string* err,
+                    std::uint64_t max_bytes = std::numeric_limits<std::uint64_t>::max());
+
+  // Writes all objects in one batch, atomically; a later entry for the same
+  // key replaces an earlier one.
+  bool put_objects(std::string_view bucket,
+                   const std::vector<ObjectWrite>& writes,
+                   std::vector<ObjectMeta>* out_metas,
+                   std::string* err);
+
   ListResult list_objects_v2(std::string_view bucket,
                             std::string_view prefix,
                             std::int64_t max_keys,
@@ -74,9 +214,29 @@ public:
                             std::string* err);
 
 private:
+  using BucketSet = std::set<std::string, std::less<>>;
+
+  void load_buckets();
+  bool fetch_object(std::string_view bucket, std::string_view key,
+                    ObjectMeta* out_meta, PinnedRead* out, std::string* err,
+                    std::int64_t first_offset = 0,
+                    std::int64_t end_offset = std::numeric_limits<std::int64_t>::max());
+  std::shared_ptr<const rocksdb::Snapshot> snapshot();
+  rocksdb::Status write(const std::function<void(rocksdb::WriteBatch*)>& fill, std::size_t bytes);
+
   rocksdb::DB* db_;
   rocksdb::WriteOptions wo_;
   server::Metrics* metrics_;
+  std::int64_t chunk_bytes_;
+  rocksdb::ColumnFamilyHandle* buckets_cf_;
+  rocksdb::ColumnFamilyHandle* meta_cf_;
+  rocksdb::ColumnFamilyHandle* data_cf_;
+  WriteCombiner* combiner_ = nullptr;
+  // Null if the initial scan failed; bucket calls then read RocksDB. Only
+  // accessed through std::atomic_load/atomic_store (std::atomic<shared_ptr>
+  // needs a newer standard library than the compilers CMake accepts).
+  std::shared_ptr<const BucketSet> buckets_;
+  std::mutex bucket_mu_;  // serializes create/delete_bucket
 };
 
 } // namespace storage
@@ -0,0 +1,61 @@
+#include "storage_executor.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace server {
+
+StorageExecutor::StorageExecutor(std::size_t threads, std::size_t max_queue, Metrics* metrics)
+  : max_queue_(std::max<std::size_t>(1, max_queue)), metrics_(metrics) {
+  threads = std::max<std::size_t>(1, threads);
+  threads_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this] { run(); });
+  }
+}
+
+StorageExecutor::~StorageExecutor() {
+  stop();
+}
+
+bool StorageExecutor::try_post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (stopping_ || queue_.size() >= max_queue_) {
+      if (metrics_) metrics_->IncStorageRejected();
+      return false;
+    }
+    queue_.push_back(std::move(task));
+    if (metrics_) metrics_->SetStorageQueued(queue_.size());
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void StorageExecutor::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (stopping_) return;
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : threads_) t.join();
+}
+
+void StorageExecutor::run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) return;
+      task = std::move(queue_.front());
+      queue_.pop_front();
+      if (metrics_) metrics_->SetStorageQueued(queue_.size());
+    }
+    task();
+  }
+}
+
+} // namespace server
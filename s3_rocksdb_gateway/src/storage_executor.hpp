@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace server {
+
+class Metrics;
+
+// Fixed pool of threads that run blocking storage work (RocksDB reads and
+// writes) off the Asio I/O threads. The queue is bounded: when it is full
+// try_post refuses the task and the caller answers the request with 503
+// SlowDown instead of queueing without limit.
+class StorageExecutor {
+public:
+  StorageExecutor(std::size_t threads, std::size_t max_queue, Metrics* metrics = nullptr);
+  ~StorageExecutor();
+
+  StorageExecutor(const StorageExecutor&) = delete;
+  StorageExecutor& operator=(const StorageExecutor&) = delete;
+
+  bool try_post(std::function<void()> task);
+
+  // Runs the tasks already queued, then joins the threads.
+  void stop();
+
+private:
+  void run();
+
+  std::size_t max_queue_;
+  Metrics* metrics_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+} // namespace server
@@ -0,0 +1,85 @@
+#include "write_combiner.hpp"
+#include "metrics.hpp"
+
+#include <utility>
+
+namespace storage {
+
+namespace {
+
+// A WriteBatch representation is an 8-byte sequence number and a 4-byte
+// little-endian operation count, followed by the operations themselves.
+constexpr std::size_t kBatchHeaderBytes = 12;
+
+void set_batch_count(std::string* rep, std::uint32_t count) {
+  for (int i = 0; i < 4; ++i) (*rep)[8 + i] = static_cast<char>((count >> (8 * i)) & 0xff);
+}
+
+} // namespace
+
+WriteCombiner::WriteCombiner(rocksdb::DB* db, rocksdb::WriteOptions write_opts, Options opts,
+                             server::Metrics* metrics)
+    : db_(db), wo_(write_opts), opts_(opts), metrics_(metrics) {}
+
+bool WriteCombiner::full(const Group& g) const {
+  return g.rep.size() >= opts_.max_bytes || g.requests >= opts_.max_requests;
+}
+
+rocksdb::Status WriteCombiner::Write(const std::function<void(rocksdb::WriteBatch*)>& fill) {
+  // Fill a private batch first: a throwing fill must not leave half its
+  // operations in a group that others will commit.
+  rocksdb::WriteBatch mine;
+  fill(&mine);
+  const std::string& ops = mine.Data();
+
+  std::unique_lock<std::mutex> lock(mu_);
+  const bool leader = !open_;
+  if (leader) {
+    open_ = std::make_shared<Group>();
+    open_->opened = Clock::now();
+    open_->rep.assign(kBatchHeaderBytes, '\0');
+  }
+  std::shared_ptr<Group> g = open_;
+  g->rep.append(ops, kBatchHeaderBytes, std::string::npos);
+  g->count += static_cast<std::uint32_t>(mine.Count());
+  g->requests++;
+  g->joined_sum += Clock::now() - g->opened;
+
+  if (!leader) {
+    if (full(*g)) g->cv.notify_all();
+    g->cv.wait(lock, [&g] { return g->done; });
+    return g->status;
+  }
+
+  // Gather followers for the window (cut short when the group fills up) and
+  // for as long as the previous group is still writing.
+  g->cv.wait_until(lock, g->opened + opts_.window, [this, &g] { return full(*g); });
+  g->cv.wait(lock, [this] { return !writing_; });
+  open_.reset();
+  writing_ = true;
+  lock.unlock();
+
+  set_batch_count(&g->rep, g->count);
+  rocksdb::WriteBatch batch(std::move(g->rep));
+  const auto start = Clock::now();
+  rocksdb::Status st = db_->Write(wo_, &batch);
+  const auto end = Clock::now();
+  if (metrics_) {
+    const double write_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    metrics_->ObserveRocksdb("write", st.ok(), batch.GetDataSize(), write_ms);
+    // Time callers spent waiting for the group to close.
+    const auto waited = static_cast<std::int64_t>(g->requests) * (start - g->opened) - g->joined_sum;
+    metrics_->ObserveGroupCommit(g->requests, batch.GetDataSize(),
+                                 std::chrono::duration<double, std::milli>(waited).count());
+  }
+
+  lock.lock();
+  writing_ = false;
+  g->status = st;
+  g->done = true;
+  g->cv.notify_all();
+  if (open_) open_->cv.notify_all();
+  return st;
+}
+
+} // namespace storage
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
+
+namespace server {
+class Metrics;
+} // namespace server
+
+namespace storage {
+
+// Group commit for object writes. Concurrent callers append their operations
+// to one shared batch; the first caller of a group (the leader) waits until
+// the previous group's write has finished and the window has passed, or the
+// group is full, then issues a single DB::Write for everyone. Under --sync or
+// with the WAL on, N concurrent PUTs then cost one WAL append and fsync.
+class WriteCombiner {
+public:
+  struct Options {
+    std::chrono::microseconds window{100};  // how long a leader waits for followers
+    std::size_t max_bytes = 4u << 20;       // stop waiting once the batch is this large
+    std::size_t max_requests = 128;         // or has this many callers
+  };
+
+  WriteCombiner(rocksdb::DB* db, rocksdb::WriteOptions write_opts, Options opts,
+                server::Metrics* metrics = nullptr);
+
+  WriteCombiner(const WriteCombiner&) = delete;
+  WriteCombiner& operator=(const WriteCombiner&) = delete;
+
+  // Builds the caller's operations with fill, outside the combiner's lock, then
+  // adds them to the open group and blocks until the write that contains them
+  // has committed. If fill throws, nothing was added and the exception
+  // propagates.
+  rocksdb::Status Write(const std::function<void(rocksdb::WriteBatch*)>& fill);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Group {
+    std::string rep;            // WriteBatch representation of every caller's ops
+    std::uint32_t count = 0;    // operations in rep
+    std::size_t requests = 0;
+    Clock::time_point opened;
+    Clock::duration joined_sum{};  // sum of (join time - opened)
+    bool done = false;
+    rocksdb::Status status;
+    std::condition_variable cv;
+  };
+
+  bool full(const Group& g) const;
+
+  rocksdb::DB* db_;
+  rocksdb::WriteOptions wo_;
+  Options opts_;
+  server::Metrics* metrics_;
+
+  std::mutex mu_;
+  std::shared_ptr<Group> open_;  // group accepting callers
+  bool writing_ = false;         // a group's DB::Write is in flight
+};
+
+} // namespace storage
@@ -0,0 +1,235 @@
+#include "metrics.hpp"
+#include "s3_api.hpp"
+#include "storage.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace http = boost::beast::http;
+
+static std::string make_tmp_dir() {
+  std::string tmpl = "/tmp/s3gw_test_XXXXXX";
+  std::vector<char> buf(tmpl.begin(), tmpl.end());
+  buf.push_back('\0');
+  char* dir = mkdtemp(buf.data());
+  if (!dir) return "/tmp/s3gw_test_fallback";
+  return std::string(dir);
+}
+
+static std::uint64_t rocksdb_metric(const server::Metrics& metrics, const std::string& name_prefix,
+                                    const std::string& op) {
+  std::istringstream in(metrics.RenderPrometheus());
+  const std::string name = name_prefix + "{op=\"" + op + "\"} ";
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind(name, 0) == 0) return std::stoull(line.substr(name.size()));
+  }
+  return 0;
+}
+
+static std::uint64_t rocksdb_ops(const server::Metrics& metrics, const std::string& op) {
+  return rocksdb_metric(metrics, "s3gw_rocksdb_ops_total", op);
+}
+
+static void put_le(std::string* out, std::uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; ++i) out->push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+static std::uint64_t get_le(std::string_view* in, int bytes) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) v |= static_cast<std::uint64_t>(static_cast<unsigned char>((*in)[i])) << (8 * i);
+  in->remove_prefix(bytes);
+  return v;
+}
+
+static s3::Request batch_request(http::verb verb, const std::string& body) {
+  s3::Request req{verb, "/pc?batch", 11};
+  req.set(http::field::host, "localhost");
+  req.body().assign(body.begin(), body.end());
+  req.prepare_payload();
+  return req;
+}
+
+struct Entry {
+  unsigned status;
+  std::uint64_t size;
+  std::string data;
+};
+
+static std::vector<Entry> decode(const std::string& body) {
+  std::string_view in = body;
+  std::vector<Entry> out(get_le(&in, 4));
+  for (auto& e : out) {
+    e.status = static_cast<unsigned>(get_le(&in, 2));
+    e.size = get_le(&in, 8);
+    const auto len = get_le(&in, 8);
+    e.data = std::string(in.substr(0, len));
+    in.remove_prefix(len);
+  }
+  assert(in.empty());
+  return out;
+}
+
+static std::string put_batch_body(const std::vector<std::tuple<std::string, std::string, std::string>>& entries) {
+  std::string body;
+  put_le(&body, entries.size(), 4);
+  for (const auto& [key, type, data] : entries) {
+    put_le(&body, key.size(), 2);
+    body += key;
+    put_le(&body, type.size(), 2);
+    body += type;
+    put_le(&body, data.size(), 8);
+    body += data;
+  }
+  return body;
+}
+
+static std::string get_batch_body(const std::vector<std::tuple<std::string, std::int64_t, std::int64_t>>& entries) {
+  std::string body;
+  put_le(&body, entries.size(), 4);
+  for (const auto& [key, offset, length] : entries) {
+    put_le(&body, key.size(), 2);
+    body += key;
+    put_le(&body, static_cast<std::uint64_t>(offset), 8);
+    put_le(&body, static_cast<std::uint64_t>(length), 8);
+  }
+  return body;
+}
+
+int main() {
+  std::string dir = make_tmp_dir();
+  std::filesystem::create_directories(dir);
+  std::string err;
+
+  rocksdb::Options opts;
+  opts.create_if_missing = true;
+  rocksdb::DB* db = nullptr;
+  auto st = rocksdb::DB::Open(opts, dir, &db);
+  assert(st.ok());
+
+  server::Metrics metrics;
+  storage::RocksObjectStore store(db, rocksdb::WriteOptions{}, &metrics, 4);
+  bool ok = store.create_bucket("pc", &err);
+  assert(ok);
+  s3::Config cfg;
+  cfg.max_batch_entries = 8;
+  cfg.max_batch_response_bytes = 32;
+  s3::Api api(&store, cfg);
+
+  // Batched PUT: one write for all objects; a repeated key keeps the last.
+  ok = store.put_object("pc", "b", "0123456789", "", nullptr, &err);
+  assert(ok);
+  const std::string put_body = put_batch_body({{"a", "text/plain", "ab"},
+                                               {"b", "", "xyz"},
+                                               {"c", "", "0123456789abcdef"},
+                                               {"a", "", "abc"}});
+  const auto writes = rocksdb_ops(metrics, "write");
+  auto put_res = api.handle(batch_request(http::verb::put, put_body));
+  assert(put_res.result() == http::status::ok);
+  assert(rocksdb_ops(metrics, "write") == writes + 1);
+  std::string data;
+  storage::ObjectMeta meta;
+  ok = store.get_object("pc", "a", &data, &meta, &err);
+  assert(ok && data == "abc");
+  assert(meta.content_type == "application/octet-stream");
+  ok = store.get_object("pc", "b", &data, &meta, &err);
+  assert(ok && data == "xyz");
+  // The shorter overwrite of b dropped its old chunks.
+  std::string raw;
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0b\0\0\0\0\1", 11), &raw);
+  assert(st.IsNotFound());
+
+  // An empty key fails the whole PUT batch, and writes nothing.
+  auto empty_key_put = api.handle(batch_request(http::verb::put, put_batch_body({{"d", "", "x"}, {"", "", "y"}})));
+  assert(empty_key_put.result() == http::status::bad_request);
+  ok = store.get_object("pc", "d", &data, &meta, &err);
+  assert(!ok && err == "NoSuchKey");
+
+  // Batched GET: whole objects, ranges across chunks, and per-entry errors.
+  const std::string get_body = get_batch_body({{"a", 0, -1},
+                                               {"c", 2, 9},
+                                               {"missing", 0, -1},
+                                               {"b", 2, 5},
+                                               {"c", 16, -1},
+                                               {"b", 1, 1},
+                                               {"", 0, -1}});
+  const auto multigets = rocksdb_ops(metrics, "multiget");
+  const auto gets = rocksdb_ops(metrics, "get");
+  auto get_res = api.handle(batch_request(http::verb::post, get_body));
+  assert(get_res.result() == http::status::ok);
+  // Metadata plus chunk 0 in one MultiGet; c reaches chunks 1-2, so that is
+  // read again under a snapshot, and the chunks come from a third.
+  assert(rocksdb_ops(metrics, "multiget") == multigets + 3);
+  assert(rocksdb_ops(metrics, "get") == gets);
+  auto entries = decode(get_res.body().to_string());
+  assert(entries.size() == 7);
+  assert(entries[0].status == 200 && entries[0].size == 3 && entries[0].data == "abc");
+  assert(entries[1].status == 200 && entries[1].size == 16 && entries[1].data == "23456789a");
+  assert(entries[2].status == 404 && entries[2].data.empty());
+  assert(entries[3].status == 416 && entries[3].size == 3);
+  assert(entries[4].status == 200 && entries[4].data.empty());
+  assert(entries[5].status == 200 && entries[5].data == "y");
+  assert(entries[6].status == 400 && entries[6].data.empty());
+
+  // Entries within chunk 0 need nothing past the first MultiGet.
+  storage::PinnedRead read;
+  std::vector<storage::ObjectReadResult> results;
+  auto before = rocksdb_ops(metrics, "multiget");
+  ok = store.read_objects("pc", {{"a", 1, 2}, {"b", 0, -1}, {"c", 0, 4}}, &results, &read, &err);
+  assert(ok);
+  assert(rocksdb_ops(metrics, "multiget") == before + 1);
+  assert(read.copy(0) == "bc" && read.copy(1) == "xyz" && read.copy(2) == "0123");
+  assert(read.pieces[2].front().data() == read.values[2].data());  // pinned, not copied
+
+  // A range starting past chunk 0 does not fetch it: round one reads only the
+  // metadata (twice, the second time under the snapshot), round two only
+  // chunk 1.
+  st = db->Get(rocksdb::ReadOptions{}, std::string("M\0pc\0c", 6), &raw);
+  assert(st.ok());
+  before = rocksdb_ops(metrics, "multiget");
+  const auto bytes_before = rocksdb_metric(metrics, "s3gw_rocksdb_bytes_total", "multiget");
+  ok = store.read_objects("pc", {{"c", 4, 4}}, &results, &read, &err);
+  assert(ok && read.copy(0) == "4567");
+  assert(rocksdb_ops(metrics, "multiget") == before + 3);
+  assert(rocksdb_metric(metrics, "s3gw_rocksdb_bytes_total", "multiget") == bytes_before + 2 * raw.size() + 4);
+
+  // Ranges adding up to more than the response cap fail the whole batch
+  // before their chunks are read.
+  before = rocksdb_ops(metrics, "multiget");
+  ok = store.read_objects("pc", {{"c", 0, -1}, {"a", 0, -1}}, &results, &read, &err, 18);
+  assert(!ok && err == "ResponseTooLarge");
+  assert(rocksdb_ops(metrics, "multiget") == before + 1);
+  auto too_large = api.handle(batch_request(http::verb::post, get_batch_body({{"c", 0, -1}, {"c", 0, -1}, {"a", 0, -1}})));
+  assert(too_large.result() == http::status::payload_too_large);
+  auto at_cap = api.handle(batch_request(http::verb::post, get_batch_body({{"c", 0, -1}, {"c", 0, -1}})));
+  assert(at_cap.result() == http::status::ok);
+
+  // Whole-request failures.
+  err.clear();
+  ok = store.read_objects("nobucket", {{"a", 0, -1}}, &results, &read, &err);
+  assert(!ok && err == "NoSuchBucket");
+  auto bad = api.handle(batch_request(http::verb::post, get_body.substr(0, get_body.size() - 1)));
+  assert(bad.result() == http::status::bad_request);
+  std::string many;
+  put_le(&many, 9, 4);
+  auto many_res = api.handle(batch_request(http::verb::post, many));
+  assert(many_res.result() == http::status::bad_request);
+  std::string none;
+  put_le(&none, 0, 4);
+  auto empty_res = api.handle(batch_request(http::verb::post, none));
+  assert(empty_res.result() == http::status::ok && decode(empty_res.body().to_string()).empty());
+
+  delete db;
+  std::filesystem::remove_all(dir);
+
+  std::cout << "test_batch passed\n";
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include "metrics.hpp"
+#include "storage.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string make_tmp_dir() {
+  std::string tmpl = "/tmp/s3gw_test_XXXXXX";
+  std::vector<char> buf(tmpl.begin(), tmpl.end());
+  buf.push_back('\0');
+  char* dir = mkdtemp(buf.data());
+  if (!dir) return "/tmp/s3gw_test_fallback";
+  return std::string(dir);
+}
+
+static std::uint64_t rocksdb_ops(const server::Metrics& metrics, const std::string& op) {
+  std::istringstream in(metrics.RenderPrometheus());
+  const std::string name = "s3gw_rocksdb_ops_total{op=\"" + op + "\"} ";
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind(name, 0) == 0) return std::stoull(line.substr(name.size()));
+  }
+  return 0;
+}
+
+int main() {
+  std::string dir = make_tmp_dir();
+  std::filesystem::create_directories(dir);
+  std::string err;
+  bool ok = false;
+
+  rocksdb::Options opts;
+  opts.create_if_missing = true;
+  rocksdb::DB* db = nullptr;
+  auto st = rocksdb::DB::Open(opts, dir, &db);
+  assert(st.ok());
+  st = db->Put(rocksdb::WriteOptions{}, std::string("B\0old", 5), "");
+  assert(st.ok());
+
+  server::Metrics metrics;
+  {
+    storage::RocksObjectStore store(db, rocksdb::WriteOptions{}, &metrics, 4);
+    // Buckets already on disk are loaded at construction.
+    ok = store.bucket_exists("old", &err);
+    assert(ok);
+    ok = store.create_bucket("new", &err);
+    assert(ok);
+    ok = store.create_bucket("new", &err);
+    assert(ok);
+    auto names = store.list_buckets(&err);
+    assert(names == (std::vector<std::string>{"new", "old"}));
+
+    // Existence checks, HEAD and list never read the bucket key.
+    const auto gets = rocksdb_ops(metrics, "get");
+    const auto iters = rocksdb_ops(metrics, "iter");
+    ok = store.bucket_exists("new", &err);
+    assert(ok);
+    ok = store.bucket_exists("missing", &err);
+    assert(!ok && err.empty());
+    ok = store.put_object("new", "k", "value", "", nullptr, &err);
+    assert(ok);
+    storage::ObjectMeta meta;
+    ok = store.head_object("new", "k", &meta, &err);
+    assert(ok && meta.size == 5);
+    ok = store.head_object("missing", "k", &meta, &err);
+    assert(!ok && err == "NoSuchBucket");
+    names = store.list_buckets(&err);
+    assert(names.size() == 2);
+    assert(rocksdb_ops(metrics, "iter") == iters);
+    // put_object's stale-chunk check and head_object's metadata read only.
+    assert(rocksdb_ops(metrics, "get") == gets + 2);
+
+    ok = store.delete_bucket("new", &err);
+    assert(!ok && err == "BucketNotEmpty");
+    ok = store.delete_object("new", "k", &err);
+    assert(ok);
+    ok = store.delete_bucket("new", &err);
+    assert(ok);
+    ok = store.bucket_exists("new", &err);
+    assert(!ok);
+    err.clear();
+    ok = store.delete_bucket("new", &err);
+    assert(!ok && err == "NoSuchBucket");
+
+    // Readers race create/delete; a bucket that is never touched stays visible.
+    std::atomic<bool> stop{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+      readers.emplace_back([&] {
+        std::string e;
+        while (!stop.load()) {
+          if (!store.bucket_exists("old", &e)) bad++;
+          store.bucket_exists("churn", &e);
+        }
+      });
+    }
+    for (int i = 0; i < 200; ++i) {
+      std::string e;
+      ok = store.create_bucket("churn", &e);
+      assert(ok);
+      ok = store.delete_bucket("churn", &e);
+      assert(ok);
+    }
+    stop = true;
+    for (auto& t : readers) t.join();
+    assert(bad == 0);
+    ok = store.create_bucket("kept", &err);
+    assert(ok);
+  }
+
+  // A fresh store sees what the last one persisted.
+  storage::RocksObjectStore reopened(db, rocksdb::WriteOptions{}, nullptr, 4);
+  const auto kept = reopened.list_buckets(&err);
+  assert(kept == (std::vector<std::string>{"kept", "old"}));
+
+  delete db;
+  std::filesystem::remove_all(dir);
+
+  std::cout << "test_bucket_registry passed\n";
+  return 0;
+}
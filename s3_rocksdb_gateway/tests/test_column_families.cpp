@@ -0,0 +1,115 @@
+#include "storage.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static std::string make_tmp_dir() {
+  std::string tmpl = "/tmp/s3gw_test_XXXXXX";
+  std::vector<char> buf(tmpl.begin(), tmpl.end());
+  buf.push_back('\0');
+  char* dir = mkdtemp(buf.data());
+  if (!dir) return "/tmp/s3gw_test_fallback";
+  return std::string(dir);
+}
+
+static void close_db(rocksdb::DB* db, const std::vector<rocksdb::ColumnFamilyHandle*>& handles) {
+  for (auto* h : handles) db->DestroyColumnFamilyHandle(h);
+  delete db;
+}
+
+int main() {
+  std::string dir = make_tmp_dir();
+  std::filesystem::create_directories(dir);
+  std::string err;
+  bool ok = false;
+
+  // A database written with everything in the default column family.
+  {
+    rocksdb::Options opts;
+    opts.create_if_missing = true;
+    rocksdb::DB* db = nullptr;
+    auto st = rocksdb::DB::Open(opts, dir, &db);
+    assert(st.ok());
+    storage::RocksObjectStore store(db, rocksdb::WriteOptions{}, nullptr, 4);
+    ok = store.create_bucket("pc", &err);
+    assert(ok);
+    ok = store.put_object("pc", "a", "0123456789", "", nullptr, &err);
+    assert(ok);
+    ok = store.put_object("pc", "b", "xy", "text/plain", nullptr, &err);
+    assert(ok);
+    st = db->Put(rocksdb::WriteOptions{}, "other", "kept");
+    assert(st.ok());
+    delete db;
+  }
+
+  rocksdb::Options opts;
+  opts.create_if_missing = true;
+  storage::ColumnFamilyOptionsSet cf_opts;
+  rocksdb::DB* db = nullptr;
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  storage::ColumnFamilies cfs;
+  std::uint64_t migrated = 0;
+  auto st = storage::open_db(opts, cf_opts, dir, &db, &handles, &cfs, &migrated);
+  assert(st.ok());
+  assert(handles.size() == 4);
+  assert(migrated == 1 + 2 + 3 + 1);  // bucket, two metas, chunks of a and b
+
+  // Each kind of key now lives in its own family; unrelated keys stay put.
+  std::string value;
+  st = db->Get(rocksdb::ReadOptions{}, std::string("B\0pc", 4), &value);
+  assert(st.IsNotFound());
+  st = db->Get(rocksdb::ReadOptions{}, cfs.buckets, std::string("B\0pc", 4), &value);
+  assert(st.ok());
+  st = db->Get(rocksdb::ReadOptions{}, cfs.meta, std::string("M\0pc\0a", 6), &value);
+  assert(st.ok());
+  st = db->Get(rocksdb::ReadOptions{}, cfs.data, std::string("M\0pc\0a", 6), &value);
+  assert(st.IsNotFound());
+  st = db->Get(rocksdb::ReadOptions{}, "other", &value);
+  assert(st.ok() && value == "kept");
+
+  storage::RocksObjectStore store(db, rocksdb::WriteOptions{}, nullptr, 4, cfs);
+  ok = store.bucket_exists("pc", &err);
+  assert(ok);
+  const auto names = store.list_buckets(&err);
+  assert(names == std::vector<std::string>{"pc"});
+  std::string data;
+  storage::ObjectMeta meta;
+  ok = store.get_object("pc", "a", &data, &meta, &err);
+  assert(ok && data == "0123456789");
+  ok = store.head_object("pc", "b", &meta, &err);
+  assert(ok && meta.content_type == "text/plain");
+  auto listed = store.list_objects_v2("pc", "", 10, "", &err);
+  assert(listed.objects.size() == 2);
+
+  ok = store.put_object("pc", "c", "new", "", nullptr, &err);
+  assert(ok);
+  std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(rocksdb::ReadOptions{}));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) assert(it->key().ToString() == "other");
+  it.reset();
+  ok = store.delete_object("pc", "a", &err);
+  assert(ok);
+  ok = store.delete_bucket("pc", &err);
+  assert(!ok && err == "BucketNotEmpty");
+  close_db(db, handles);
+
+  // Reopening finds nothing left to move.
+  st = storage::open_db(opts, cf_opts, dir, &db, &handles, &cfs, &migrated);
+  assert(st.ok() && migrated == 0);
+  storage::RocksObjectStore reopened(db, rocksdb::WriteOptions{}, nullptr, 4, cfs);
+  ok = reopened.get_object_data("pc", "c", &data, &err);
+  assert(ok && data == "new");
+  ok = reopened.get_object_data("pc", "a", &data, &err);
+  assert(!ok && err == "NoSuchKey");
+  close_db(db, handles);
+
+  std::filesystem::remove_all(dir);
+
+  std::cout << "test_column_families passed\n";
+  return 0;
+}
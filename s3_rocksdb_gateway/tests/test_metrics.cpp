@@ -0,0 +1,44 @@
+#include "metrics.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main() {
+  // Two shards record HTTP requests; the shared instance records storage.
+  server::Metrics shard0;
+  server::Metrics shard1;
+  server::Metrics shared;
+  shard0.Observe("GET", 200, 0, 100, 0.5);
+  shard0.Observe("PUT", 200, 64, 0, 3.0);
+  shard1.Observe("GET", 404, 0, 10, 20.0);
+  shard1.IncInFlight();
+  shared.ObserveRocksdb("get", true, 100, 0.2);
+  shared.ObserveRocksdb("multiget", false, 0, 7.0);
+  shared.IncStorageRejected();
+
+  const std::string text = server::Metrics::RenderMerged({&shard0, &shard1, &shared}, 2);
+  auto has = [&text](const std::string& line) { return text.find(line + "\n") != std::string::npos; };
+  assert(has("s3gw_requests_total{method=\"GET\"} 2"));
+  assert(has("s3gw_requests_total{method=\"PUT\"} 1"));
+  assert(has("s3gw_request_errors_total{method=\"GET\"} 1"));
+  assert(has("s3gw_response_bytes_total{method=\"GET\"} 110"));
+  assert(has("s3gw_request_latency_ms_bucket{le=\"1\"} 1"));
+  assert(has("s3gw_request_latency_ms_bucket{le=\"5\"} 2"));
+  assert(has("s3gw_request_latency_ms_count 3"));
+  assert(has("s3gw_inflight_requests 1"));
+  assert(has("s3gw_rocksdb_ops_total{op=\"get\"} 1"));
+  assert(has("s3gw_rocksdb_errors_total{op=\"multiget\"} 1"));
+  assert(has("s3gw_storage_rejected_total 1"));
+  assert(has("s3gw_shard_requests_total{shard=\"0\"} 2"));
+  assert(has("s3gw_shard_requests_total{shard=\"1\"} 1"));
+  assert(has("s3gw_shard_inflight_requests{shard=\"1\"} 1"));
+  assert(text.find("shard=\"2\"") == std::string::npos);
+
+  // Merging does not change the parts.
+  assert(shard0.RenderPrometheus().find("s3gw_requests_total{method=\"GET\"} 1\n") != std::string::npos);
+
+  std::cout << "test_metrics passed\n";
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include "metrics.hpp"
+#include "storage.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string make_tmp_dir() {
+  std::string tmpl = "/tmp/s3gw_test_XXXXXX";
+  std::vector<char> buf(tmpl.begin(), tmpl.end());
+  buf.push_back('\0');
+  char* dir = mkdtemp(buf.data());
+  if (!dir) return "/tmp/s3gw_test_fallback";
+  return std::string(dir);
+}
+
+static std::uint64_t rocksdb_ops(const server::Metrics& metrics, const std::string& op) {
+  std::istringstream in(metrics.RenderPrometheus());
+  const std::string name = "s3gw_rocksdb_ops_total{op=\"" + op + "\"} ";
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind(name, 0) == 0) return std::stoull(line.substr(name.size()));
+  }
+  return 0;
+}
+
+static std::uint64_t multiget_bytes(const server::Metrics& metrics) {
+  std::istringstream in(metrics.RenderPrometheus());
+  const std::string name = "s3gw_rocksdb_bytes_total{op=\"multiget\"} ";
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind(name, 0) == 0) return std::stoull(line.substr(name.size()));
+  }
+  return 0;
+}
+
+static std::uint64_t lookups(const server::Metrics& metrics) {
+  return rocksdb_ops(metrics, "get") + rocksdb_ops(metrics, "multiget");
+}
+
+int main() {
+  std::string dir = make_tmp_dir();
+  std::filesystem::create_directories(dir);
+  std::string err;
+  bool ok = false;
+
+  rocksdb::Options opts;
+  opts.create_if_missing = true;
+  rocksdb::DB* db = nullptr;
+  auto st = rocksdb::DB::Open(opts, dir, &db);
+  assert(st.ok());
+
+  server::Metrics metrics;
+  storage::RocksObjectStore store(db, rocksdb::WriteOptions{}, &metrics, 8);
+  ok = store.create_bucket("ol", &err);
+  assert(ok);
+
+  // Metadata is a fixed binary header followed by the etag and content type.
+  storage::ObjectMeta meta;
+  ok = store.put_object("ol", "small", "tiny", "text/plain", &meta, &err);
+  assert(ok);
+  std::string raw;
+  st = db->Get(rocksdb::ReadOptions{}, std::string("M\0ol\0small", 10), &raw);
+  assert(st.ok());
+  assert(raw.size() == 27 + meta.etag.size() + 10);
+  assert(raw[0] == '\x01' && raw[1] == 4 && raw[17] == 8);
+  assert(raw.compare(raw.size() - 10, 10, "text/plain") == 0);
+
+  // An object that fits in a chunk: one MultiGet for metadata and data.
+  std::uint64_t before = lookups(metrics);
+  std::string data;
+  ok = store.get_object("ol", "small", &data, &meta, &err);
+  assert(ok && data == "tiny");
+  assert(meta.size == 4 && meta.chunk_bytes == 8 && meta.content_type == "text/plain");
+  assert(lookups(metrics) == before + 1);
+
+  storage::PinnedRead read;
+  before = lookups(metrics);
+  ok = store.open_object("ol", "small", &meta, &read, &err);
+  assert(ok && read.prefetched);
+  ok = store.read_ranges("ol", "small", meta, {{1, 2}, {0, 0}}, &read, &err);
+  assert(ok);
+  assert(read.copy(0) == "in" && read.copy(1).empty() && !read.prefetched);
+  assert(lookups(metrics) == before + 1);
+
+  // Larger objects: ranges inside chunk 0 still need nothing more (and no
+  // snapshot), others fetch the chunks they cover.
+  const std::string big = "0123456789abcdefghij";
+  ok = store.put_object("ol", "big", big, "", nullptr, &err);
+  assert(ok);
+  before = lookups(metrics);
+  ok = store.open_object("ol", "big", &meta, &read, &err, 2, 7);
+  assert(ok && !read.snapshot);
+  ok = store.read_ranges("ol", "big", meta, {{2, 5}}, &read, &err);
+  assert(ok && read.copy(0) == "23456");
+  assert(lookups(metrics) == before + 1);
+  // A read that may reach past chunk 0 looks the object up again under a
+  // snapshot, for the chunks read_ranges adds.
+  ok = store.open_object("ol", "big", &meta, &read, &err);
+  assert(ok && read.snapshot && read.prefetched);
+  assert(lookups(metrics) == before + 3);
+  // A range past chunk 0 keeps the prefetched chunk and reads only chunk 1.
+  const std::uint64_t bytes_before = multiget_bytes(metrics);
+  ok = store.read_ranges("ol", "big", meta, {{6, 10}}, &read, &err);
+  assert(ok && read.copy(0) == "6789abcdef");
+  assert(lookups(metrics) == before + 4);
+  assert(multiget_bytes(metrics) == bytes_before + 8);
+  ok = store.get_object_data("ol", "big", &data, &err);
+  assert(ok && data == big);
+
+  // A read that starts past chunk 0 does not fetch it with the metadata.
+  before = lookups(metrics);
+  const bool opened = store.open_object("ol", "big", &meta, &read, &err, 8);
+  assert(opened && !read.prefetched && read.values.empty());
+  const bool ranged = store.read_ranges("ol", "big", meta, {{9, 3}}, &read, &err);
+  assert(ranged && read.copy(0) == "9ab");
+  assert(lookups(metrics) == before + 2);
+
+  // Empty objects have no chunk to prefetch.
+  ok = store.put_object("ol", "empty", "", "", nullptr, &err);
+  assert(ok);
+  ok = store.get_object("ol", "empty", &data, &meta, &err);
+  assert(ok && data.empty() && meta.size == 0);
+
+  ok = store.open_object("ol", "missing", &meta, &read, &err);
+  assert(!ok && err == "NoSuchKey");
+  err.clear();
+  ok = store.open_object("nobucket", "small", &meta, &read, &err);
+  assert(!ok && err == "NoSuchBucket");
+  ok = store.get_object_data("ol", "missing", &data, &err);
+  assert(!ok && err == "NoSuchKey");
+
+  // Text metadata from older versions is still read, and rewritten as binary.
+  st = db->Put(rocksdb::WriteOptions{}, std::string("M\0ol\0text", 9),
+               std::string("5\0" "7\0etag\0text/csv\0" "8", 19));
+  assert(st.ok());
+  st = db->Put(rocksdb::WriteOptions{}, std::string("D\0ol\0text\0\0\0\0\0", 14), "a,b,c");
+  assert(st.ok());
+  ok = store.get_object("ol", "text", &data, &meta, &err);
+  assert(ok && data == "a,b,c");
+  assert(meta.mtime == 7 && meta.etag == "etag" && meta.content_type == "text/csv");
+  ok = store.put_object("ol", "text", "x,y", "text/csv", nullptr, &err);
+  assert(ok);
+  st = db->Get(rocksdb::ReadOptions{}, std::string("M\0ol\0text", 9), &raw);
+  assert(st.ok() && raw[0] == '\x01');
+
+  // Truncated binary metadata is reported, not misread.
+  st = db->Put(rocksdb::WriteOptions{}, std::string("M\0ol\0bad", 8), std::string("\x01\x04", 2));
+  assert(st.ok());
+  ok = store.head_object("ol", "bad", &meta, &err);
+  assert(!ok && err == "Corrupt metadata");
+
+  delete db;
+  std::filesystem::remove_all(dir);
+
+  std::cout << "test_object_lookup passed\n";
+  return 0;
+}
@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -32,11 +33,14 @@ int main() {
 
   storage::RocksObjectStore store(db);
   std::string err;
-  assert(store.create_bucket("pc", &err));
+  bool ok = false;
+  ok = store.create_bucket("pc", &err);
+  assert(ok);
 
   storage::ObjectMeta meta;
   std::string payload = "ABCDEFGH";
-  assert(store.put_object("pc", "obj", payload, "application/octet-stream", &meta, &err));
+  ok = store.put_object("pc", "obj", payload, "application/octet-stream", &meta, &err);
+  assert(ok);
 
   s3::Config cfg;
   cfg.auth_mode = auth::Mode::None;
@@ -49,7 +53,7 @@ int main() {
   auto res = api.handle(req);
   assert(res.result() == http::status::partial_content);
   assert(res.body().size() == 4);
-  assert(std::string(res.body().begin(), res.body().end()) == "ABCD");
+  assert(res.body().to_string() == "ABCD");
   assert(res.find("Content-Range") != res.end());
 
   http::request<http::vector_body<char>> bad_req{http::verb::get, "/pc/obj", 11};
@@ -58,6 +62,137 @@ int main() {
   auto bad_res = api.handle(bad_req);
   assert(bad_res.result() == http::status::range_not_satisfiable);
 
+  http::request<http::vector_body<char>> multi_req{http::verb::get, "/pc/obj", 11};
+  multi_req.set(http::field::host, "localhost");
+  multi_req.set(http::field::range, "bytes=0-1,4-5");
+  auto multi_res = api.handle(multi_req);
+  assert(multi_res.result() == http::status::partial_content);
+  std::string multi_ct(multi_res[http::field::content_type]);
+  assert(multi_ct.rfind("multipart/byteranges; boundary=", 0) == 0);
+  std::string multi_body = multi_res.body().to_string();
+  assert(multi_body.find("Content-Range: bytes 0-1/8\r\n\r\nAB") != std::string::npos);
+  assert(multi_body.find("Content-Range: bytes 4-5/8\r\n\r\nEF") != std::string::npos);
+
+  auto get_with_range = [&](s3::Api& a, const std::string& range) {
+    http::request<http::vector_body<char>> r{http::verb::get, "/pc/obj", 11};
+    r.set(http::field::host, "localhost");
+    r.set(http::field::range, range);
+    return a.handle(r);
+  };
+
+  // Overlapping and adjacent specs are merged into one range.
+  auto merged = get_with_range(api, "bytes=4-6,0-2,1-3,-2");
+  assert(merged.result() == http::status::partial_content);
+  assert(merged.body().to_string() == "ABCDEFGH");
+  assert(std::string(merged["Content-Range"]) == "bytes 0-7/8");
+
+  // Some specs unsatisfiable: the whole object, not 416.
+  auto partial = get_with_range(api, "bytes=0-1,100-200");
+  assert(partial.result() == http::status::ok);
+  assert(partial.body().to_string() == "ABCDEFGH");
+
+  // More specs than max_ranges: the header is ignored.
+  s3::Config capped_cfg = cfg;
+  capped_cfg.max_ranges = 2;
+  s3::Api capped(&store, capped_cfg);
+  auto many = get_with_range(capped, "bytes=0-0,2-2,4-4");
+  assert(many.result() == http::status::ok);
+  assert(many.body().size() == 8);
+  assert(get_with_range(capped, "bytes=0-0,2-2").result() == http::status::partial_content);
+
+  // Small chunks: ranges span chunk boundaries and read only what they cover.
+  storage::RocksObjectStore chunked(db, rocksdb::WriteOptions{}, nullptr, 3);
+  std::string alpha = "abcdefghijklmnopqrstuvwxyz";
+  ok = chunked.put_object("pc", "alpha", alpha, "", &meta, &err);
+  assert(ok);
+  assert(meta.chunk_bytes == 3 && meta.size == 26);
+  storage::PinnedRead read;
+  ok = chunked.read_ranges("pc", "alpha", meta, {{2, 5}, {25, 1}, {0, 0}, {9, 3}}, &read, &err);
+  assert(ok);
+  assert(read.pieces.size() == 4);
+  assert(read.values.size() == 5);  // chunks 0-3 and 8
+  assert(read.pieces[0].size() == 3);  // "c" "def" "g"
+  assert(read.copy(0) == "cdefg" && read.copy(1) == "z" && read.copy(2).empty() && read.copy(3) == "jkl");
+  assert(read.pieces[3].front().data() == read.values[3].data());  // a view, not a copy
+  ok = chunked.read_ranges("pc", "alpha", meta, {{20, 7}}, &read, &err);
+  assert(!ok);
+  std::string whole;
+  ok = chunked.get_object_data("pc", "alpha", &whole, &err);
+  assert(ok && whole == alpha);
+
+  s3::Api chunked_api(&chunked, cfg);
+  http::request<http::vector_body<char>> span_req{http::verb::get, "/pc/alpha", 11};
+  span_req.set(http::field::host, "localhost");
+  span_req.set(http::field::range, "bytes=4-10");
+  auto span_res = chunked_api.handle(span_req);
+  assert(span_res.result() == http::status::partial_content);
+  assert(span_res.body().to_string() == "efghijk");
+  assert(span_res.body().buffers().size() == 3);  // pinned chunks 1, 2 and 3
+
+  // The serializer writes the body's segments as they are.
+  span_res.prepare_payload();
+  std::ostringstream wire;
+  wire << span_res;
+  assert(wire.str().find("\r\n\r\nefghijk") != std::string::npos);
+
+  // A shorter overwrite drops the chunks past its end.
+  ok = chunked.put_object("pc", "alpha", "xyzw", "", &meta, &err);
+  assert(ok);
+  std::string value;
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0alpha\0\0\0\0\1", 15), &value);
+  assert(st.ok());
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0alpha\0\0\0\0\2", 15), &value);
+  assert(st.IsNotFound());
+  ok = chunked.get_object_data("pc", "alpha", &whole, &err);
+  assert(ok && whole == "xyzw");
+
+  ok = chunked.delete_object("pc", "alpha", &err);
+  assert(ok);
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0alpha\0\0\0\0\0", 15), &value);
+  assert(st.IsNotFound());
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0alpha\0\0\0\0\1", 15), &value);
+  assert(st.IsNotFound());
+  ok = chunked.stat_object("pc", "alpha", &meta, &err);
+  assert(!ok && err == "NoSuchKey");
+  ok = chunked.delete_object("pc", "alpha", &err);
+  assert(ok);
+
+  // Stale chunks go even when the metadata that sized them is unreadable,
+  // and a key that extends another is left alone.
+  ok = chunked.put_object("pc", "beta", alpha, "", &meta, &err);
+  assert(ok);
+  ok = chunked.put_object("pc", "betab", "other", "", &meta, &err);
+  assert(ok);
+  st = db->Put(rocksdb::WriteOptions{}, std::string("M\0pc\0beta", 9), "\x7f");
+  assert(st.ok());
+  ok = chunked.put_object("pc", "beta", "x", "", &meta, &err);
+  assert(ok);
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0beta\0\0\0\0\1", 14), &value);
+  assert(st.IsNotFound());
+  ok = chunked.get_object_data("pc", "betab", &whole, &err);
+  assert(ok && whole == "other");
+  ok = chunked.delete_object("pc", "beta", &err);
+  assert(ok);
+  ok = chunked.delete_object("pc", "betab", &err);
+  assert(ok);
+
+  // Objects written before chunking keep reading from their single value.
+  st = db->Put(rocksdb::WriteOptions{}, std::string("M\0pc\0old", 8), std::string("6\0" "0\0\0text/plain", 15));
+  assert(st.ok());
+  st = db->Put(rocksdb::WriteOptions{}, std::string("D\0pc\0old", 8), "legacy");
+  assert(st.ok());
+  ok = chunked.stat_object("pc", "old", &meta, &err);
+  assert(ok);
+  assert(meta.chunk_bytes == 0 && meta.content_type == "text/plain");
+  ok = chunked.read_ranges("pc", "old", meta, {{1, 3}}, &read, &err);
+  assert(ok && read.copy(0) == "ega");
+  ok = chunked.put_object("pc", "old", "renewed", "", &meta, &err);
+  assert(ok);
+  st = db->Get(rocksdb::ReadOptions{}, std::string("D\0pc\0old", 8), &value);
+  assert(st.IsNotFound());
+  ok = chunked.get_object_data("pc", "old", &whole, &err);
+  assert(ok && whole == "renewed");
+
   delete db;
   std::filesystem::remove_all(dir);
 
@@ -0,0 +1,57 @@
+#include "metrics.hpp"
+#include "storage_executor.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+int main() {
+  server::Metrics metrics;
+  server::StorageExecutor pool(1, 2, &metrics);
+
+  // Park the only thread so later tasks wait in the queue.
+  std::mutex mu;
+  std::condition_variable cv;
+  bool release = false;
+  bool started = false;
+  const bool parked = pool.try_post([&] {
+    std::unique_lock<std::mutex> lock(mu);
+    started = true;
+    cv.notify_all();
+    cv.wait(lock, [&] { return release; });
+  });
+  assert(parked);
+  {
+    std::unique_lock<std::mutex> lock(mu);
+    cv.wait(lock, [&] { return started; });
+  }
+
+  std::atomic<int> ran{0};
+  const bool first = pool.try_post([&] { ran++; });
+  const bool second = pool.try_post([&] { ran++; });
+  // The queue is bounded: a third waiting task is refused.
+  const bool third = pool.try_post([&] { ran++; });
+  assert(first && second && !third);
+  const std::string text = metrics.RenderPrometheus();
+  assert(text.find("s3gw_storage_queue_depth 2\n") != std::string::npos);
+  assert(text.find("s3gw_storage_rejected_total 1\n") != std::string::npos);
+
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    release = true;
+  }
+  cv.notify_all();
+
+  // stop() runs what was queued, then refuses new work.
+  pool.stop();
+  assert(ran == 2);
+  const bool after_stop = pool.try_post([&] { ran++; });
+  assert(!after_stop);
+  assert(metrics.RenderPrometheus().find("s3gw_storage_queue_depth 0\n") != std::string::npos);
+
+  std::cout << "test_storage_executor passed\n";
+  return 0;
+}
@@ -0,0 +1,133 @@
+#!/usr/bin/env bash
+# Inline SST values vs integrated BlobDB for KV-sized objects: write
+# amplification under random overwrite and point-read latency, first with
+# db_bench, then end to end through s3gw.
+set -euo pipefail
+
+DB_BENCH=${DB_BENCH:-/n0/rocksdb-6.26.1/db_bench}
+S3GW=${S3GW:-./build/s3gw}
+STRESS=${STRESS:-./tools/stress_test.py}
+DB_ROOT=${DB_ROOT:-/n0/bench_blob}
+LOG_ROOT=${LOG_ROOT:-$DB_ROOT/logs_$(date +%Y%m%d_%H%M%S)}
+mkdir -p "$LOG_ROOT"
+
+# Toggle sections (set to 0 to skip).
+RUN_DB_BENCH=${RUN_DB_BENCH:-1}
+RUN_GATEWAY=${RUN_GATEWAY:-1}
+
+VALUE_SIZE=${VALUE_SIZE:-131072}
+MIN_BLOB_SIZE=${MIN_BLOB_SIZE:-16384}
+NUM=${NUM:-200000}
+READ_SECONDS=${READ_SECONDS:-30}
+THREADS=${THREADS:-8}
+
+# Gateway settings.
+PORT=${PORT:-19000}
+OBJECTS=${OBJECTS:-20000}
+FILL_SECONDS=${FILL_SECONDS:-120}
+
+BLOB_FLAGS=(
+  --enable_blob_files=true
+  --min_blob_size="$MIN_BLOB_SIZE"
+  --blob_file_size=$((256*1024*1024))
+  --blob_compression_type=none
+  --enable_blob_garbage_collection=true
+  --blob_garbage_collection_age_cutoff=0.25
+)
+
+# "Sum" row of the last compaction stats dump for column family $2
+# (default: any); column 12 is W-Amp.
+wamp() {
+  awk -v cf="${2:-}" '
+    /Compaction Stats \[/ { in_cf = (cf == "" || index($0, "[" cf "]") > 0) }
+    in_cf && $1 == "Sum" { w = $12 }
+    END { print w }' "$1"
+}
+
+summarize() {
+  local name=$1 log=$2
+  echo "== $name"
+  echo "write_amp $(wamp "$log")"
+  grep -E '^(readrandom|fillrandom|overwrite) ' "$log" || true
+  grep -E '^Percentiles:' "$log" || true
+}
+
+if [[ "$RUN_DB_BENCH" -eq 1 ]]; then
+  for layout in inline blob; do
+    DB="$DB_ROOT/dbbench_$layout"
+    rm -rf "$DB"
+    extra=()
+    [[ "$layout" == blob ]] && extra=("${BLOB_FLAGS[@]}")
+
+    # Fill, then overwrite every key once so compactions rewrite live data.
+    "$DB_BENCH" \
+      --benchmarks=fillrandom,overwrite,stats \
+      --db="$DB" \
+      --num="$NUM" \
+      --value_size="$VALUE_SIZE" \
+      --compression_type=none \
+      --disable_wal=true \
+      --statistics=true \
+      --write_buffer_size=268435456 \
+      --max_background_jobs=16 \
+      --level0_file_num_compaction_trigger=4 \
+      "${extra[@]}" \
+      > "$LOG_ROOT/dbbench_write_$layout.txt" 2>&1
+
+    "$DB_BENCH" \
+      --benchmarks=readrandom \
+      --db="$DB" \
+      --use_existing_db=true \
+      --num="$NUM" \
+      --duration="$READ_SECONDS" \
+      --threads="$THREADS" \
+      --value_size="$VALUE_SIZE" \
+      --histogram=true \
+      --cache_size=$((1024*1024*1024)) \
+      --cache_index_and_filter_blocks=true \
+      "${extra[@]}" \
+      > "$LOG_ROOT/dbbench_read_$layout.txt" 2>&1
+
+    summarize "db_bench $layout write" "$LOG_ROOT/dbbench_write_$layout.txt"
+    summarize "db_bench $layout read" "$LOG_ROOT/dbbench_read_$layout.txt"
+  done
+fi
+
+if [[ "$RUN_GATEWAY" -eq 1 ]]; then
+  for layout in inline blob; do
+    DB="$DB_ROOT/s3gw_$layout"
+    rm -rf "$DB"
+    extra=()
+    [[ "$layout" == blob ]] && extra=(--blob_files --min_blob_kb=$((MIN_BLOB_SIZE / 1024)))
+
+    # --dump_stats prints each column family's rocksdb.stats on SIGTERM, so
+    # W-Amp does not depend on a periodic dump having reached the LOG.
+    "$S3GW" --listen=127.0.0.1:"$PORT" --db_path="$DB" --threads="$THREADS" --dump_stats "${extra[@]}" \
+      > "$LOG_ROOT/s3gw_$layout.txt" 2>&1 &
+    pid=$!
+    trap 'kill $pid 2>/dev/null || true' EXIT
+    sleep 1
+
+    # Random overwrites of the loaded objects, then a read-only pass over
+    # the same objects.
+    "$STRESS" --endpoint "http://127.0.0.1:$PORT" --create-bucket \
+      --objects "$OBJECTS" --object-bytes "$VALUE_SIZE" --range-bytes "$VALUE_SIZE" \
+      --threads "$THREADS" --duration "$FILL_SECONDS" --write-ratio 1.0 --overwrite --random \
+      > "$LOG_ROOT/stress_write_$layout.txt"
+    "$STRESS" --endpoint "http://127.0.0.1:$PORT" \
+      --objects "$OBJECTS" --object-bytes "$VALUE_SIZE" --range-bytes "$VALUE_SIZE" \
+      --threads "$THREADS" --duration "$READ_SECONDS" \
+      > "$LOG_ROOT/stress_read_$layout.txt"
+
+    kill "$pid"
+    wait "$pid" 2>/dev/null || true
+    trap - EXIT
+
+    echo "== s3gw $layout"
+    echo "write_amp $(wamp "$LOG_ROOT/s3gw_$layout.txt" data)"
+    echo "-- write"; cat "$LOG_ROOT/stress_write_$layout.txt"
+    echo "-- read"; cat "$LOG_ROOT/stress_read_$layout.txt"
+  done
+fi
+
+echo "Logs written to $LOG_ROOT"
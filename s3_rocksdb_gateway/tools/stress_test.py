@@ -3,6 +3,7 @@ import argparse
 import os
 import random
 import ssl
+import struct
 import sys
 import threading
 import time
@@ -14,6 +15,7 @@ from urllib.parse import urlparse
 @dataclass
 class Result:
     count: int = 0
+    objects: int = 0
     errors: int = 0
     bytes_read: int = 0
     latencies_ms: list = None
@@ -58,6 +60,30 @@ def get_range(conn, bucket, key, range_bytes):
     return status, data
 
 
+def get_batch(conn, bucket, keys, range_bytes):
+    # POST /bucket?batch: u32 count, then per key u16 len, key, i64 offset,
+    # i64 length; the reply is u32 count, then per entry u16 status,
+    # u64 size, u64 len, data.
+    length = range_bytes if range_bytes > 0 else -1
+    body = [struct.pack("<I", len(keys))]
+    for key in keys:
+        k = key.encode()
+        body.append(struct.pack("<H", len(k)) + k + struct.pack("<qq", 0, length))
+    status, data = request(conn, "POST", f"/{bucket}?batch", body=b"".join(body))
+    if status != 200:
+        return status, 0, len(keys)
+    (count,) = struct.unpack_from("<I", data, 0)
+    pos, read, failed = 4, 0, 0
+    for _ in range(count):
+        entry_status, _, n = struct.unpack_from("<HQQ", data, pos)
+        pos += 18 + n
+        if entry_status == 200:
+            read += n
+        else:
+            failed += 1
+    return status, read, failed
+
+
 def delete_object(conn, bucket, key):
     status, _ = request(conn, "DELETE", f"/{bucket}/{key}")
     return 200 <= status < 300
@@ -75,24 +101,33 @@ def worker(parsed, args, object_keys, result):
     end_time = time.time() + args.duration
     local_lat = []
     count = 0
+    objects = 0
     errors = 0
     bytes_read = 0
 
     while time.time() < end_time:
         key = random.choice(object_keys)
         start = time.perf_counter()
-        status, data = get_range(conn, args.bucket, key, args.range_bytes)
-        elapsed = (time.perf_counter() - start) * 1000.0
-        if status not in (200, 206):
-            errors += 1
+        if args.batch > 1:
+            keys = [key] + random.sample(object_keys, min(args.batch, len(object_keys)) - 1)
+            _, n, failed = get_batch(conn, args.bucket, keys, args.range_bytes)
+            errors += failed
+            bytes_read += n
+            objects += len(keys)
         else:
-            bytes_read += len(data)
+            status, data = get_range(conn, args.bucket, key, args.range_bytes)
+            if status not in (200, 206):
+                errors += 1
+            else:
+                bytes_read += len(data)
+            objects += 1
+        elapsed = (time.perf_counter() - start) * 1000.0
         local_lat.append(elapsed)
         count += 1
 
         # Optional writes
         if args.write_ratio > 0 and random.random() < args.write_ratio:
-            write_key = f"{key}-w{count}"
+            write_key = key if args.overwrite else f"{key}-w{count}"
             payload = os.urandom(args.object_bytes)
             if not put_object(conn, args.bucket, write_key, payload):
                 errors += 1
@@ -100,6 +135,7 @@ def worker(parsed, args, object_keys, result):
     conn.close()
 
     result.count += count
+    result.objects += objects
     result.errors += errors
     result.bytes_read += bytes_read
     result.latencies_ms.extend(local_lat)
@@ -116,6 +152,8 @@ def main():
     parser.add_argument("--duration", type=int, default=30)
     parser.add_argument("--threads", type=int, default=4)
     parser.add_argument("--write-ratio", type=float, default=0.0)
+    parser.add_argument("--overwrite", action="store_true", help="writes replace existing objects instead of adding keys")
+    parser.add_argument("--batch", type=int, default=1, help="objects per request, via POST /bucket?batch")
     parser.add_argument("--random", action="store_true", help="randomize payloads")
     parser.add_argument("--insecure", action="store_true", help="disable TLS verification")
     args = parser.parse_args()
@@ -172,6 +210,7 @@ def main():
     print("requests", total)
     print("errors", result.errors)
     print("qps", f"{qps:.2f}")
+    print("objects_per_s", f"{result.objects / duration if duration > 0 else 0.0:.2f}")
     print("throughput_mb_s", f"{mbps:.2f}")
     print("p50_ms", f"{p50:.2f}")
     print("p95_ms", f"{p95:.2f}")